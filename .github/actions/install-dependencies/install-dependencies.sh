@@ -18,7 +18,7 @@ fi
 
 ubuntu_packages='gettext libadplug-dev libasound2-dev libavformat-dev
                  libbinio-dev libbs2b-dev libcddb2-dev libcdio-cdda-dev
-                 libcue-dev libcurl4-gnutls-dev libdbus-glib-1-dev
+                 libcurl4-gnutls-dev libdbus-glib-1-dev
                  libfaad-dev libflac-dev libfluidsynth-dev libgl1-mesa-dev
                  libjack-jackd2-dev liblircclient-dev libmms-dev libmodplug-dev
                  libmp3lame-dev libmpg123-dev libneon27-gnutls-dev libnotify-dev
@@ -28,7 +28,7 @@ ubuntu_packages='gettext libadplug-dev libasound2-dev libavformat-dev
                  libvorbis-dev libwavpack-dev libxml2-dev qtbase5-dev
                  qtmultimedia5-dev'
 
-macos_packages='adplug faad2 ffmpeg libbs2b libcue libmms libmodplug libnotify
+macos_packages='adplug faad2 ffmpeg libbs2b libmms libmodplug libnotify
                 libopenmpt libsamplerate libsoxr neon sdl2 wavpack'
 
 case "$os" in
@@ -66,11 +66,12 @@ protected:
 
     static bool audio_init ();
     static void audio_generate (double seconds);
+    static void audio_flush ();
     static void audio_cleanup ();
 
     static void generate_ticks (midifile_t & midifile, int num_ticks);
     static void play_loop (midifile_t & midifile);
-    static int skip_to (midifile_t & midifile, int seektime);
+    static int skip_to (midifile_t & midifile, int seektime, int & event_pos);
 };
 
 EXPORT AMIDIPlug aud_plugin_instance;
@@ -98,6 +99,7 @@ bool AMIDIPlug::init ()
         "fsyn_synth_polyphony", "-1",
         "fsyn_synth_reverb", "-1",
         "fsyn_synth_chorus", "-1",
+        "fsyn_synth_cpu_cores", "1",
         "skip_leading", "FALSE",
         "skip_trailing", "FALSE",
         nullptr
@@ -149,10 +151,9 @@ bool AMIDIPlug::read_tag (const char * filename, VFSFile & file, Tuple & tuple,
         return false;
 
     int channels;
-    int bitdepth;
     int samplerate;
 
-    backend_audio_info (& channels, & bitdepth, & samplerate);
+    backend_audio_info (& channels, & samplerate);
 
     tuple.set_str (Tuple::Codec, "MIDI");
     tuple.set_int (Tuple::Length, mf.length / 1000);
@@ -163,41 +164,49 @@ bool AMIDIPlug::read_tag (const char * filename, VFSFile & file, Tuple & tuple,
 
 
 static int s_samplerate, s_channels;
-static int s_bufsize;
-static int16_t * s_buf;
+static int s_bufsize, s_buffered;  /* in samples */
+static float * s_buf;
 
 bool AMIDIPlug::audio_init ()
 {
-    int bitdepth;
+    backend_audio_info (& s_channels, & s_samplerate);
 
-    backend_audio_info (& s_channels, & bitdepth, & s_samplerate);
+    open_audio (FMT_FLOAT, s_samplerate, s_channels);
 
-    if (bitdepth != 16)
-        return false;
-
-    open_audio (FMT_S16_NE, s_samplerate, s_channels);
-
-    s_bufsize = 2 * s_channels * (s_samplerate / 4);
-    s_buf = new int16_t[s_bufsize / 2];
+    s_bufsize = s_channels * (s_samplerate / 4);
+    s_buffered = 0;
+    s_buf = new float[s_bufsize];
 
     return true;
 }
 
+/* the time between two events is often only a few samples, so the audio
+   is collected in the buffer and only written out once it is full */
 void AMIDIPlug::audio_generate (double seconds)
 {
-    int total = 2 * s_channels * (int) round (seconds * s_samplerate);
+    int total = s_channels * (int) round (seconds * s_samplerate);
 
     while (total)
     {
-        int chunk = (total < s_bufsize) ? total : s_bufsize;
-
-        backend_generate_audio (s_buf, chunk);
-        write_audio (s_buf, chunk);
+        int chunk = aud::min (total, s_bufsize - s_buffered);
 
+        backend_generate_audio (s_buf + s_buffered, chunk / s_channels);
+        s_buffered += chunk;
         total -= chunk;
+
+        if (s_buffered == s_bufsize)
+            audio_flush ();
     }
 }
 
+void AMIDIPlug::audio_flush ()
+{
+    if (s_buffered)
+        write_audio (s_buf, sizeof (float) * s_buffered);
+
+    s_buffered = 0;
+}
+
 void AMIDIPlug::audio_cleanup ()
 {
     delete[] s_buf;
@@ -208,11 +217,11 @@ bool AMIDIPlug::play (const char * filename, VFSFile & file)
     if (__sync_bool_compare_and_swap (& backend_settings_changed, true, false)
      && m_backend_initialized)
     {
-        AUDDBG ("Settings changed, reinitializing backend\n");
-        backend_cleanup ();
+        AUDDBG ("Settings changed, reconfiguring backend\n");
         m_backend_initialized = false;
     }
 
+    /* keeps the synth and soundfonts where possible */
     if (! m_backend_initialized)
     {
         backend_init ();
@@ -232,6 +241,8 @@ bool AMIDIPlug::play (const char * filename, VFSFile & file)
         return false;
     }
 
+    midifile.build_snapshots ();
+
     AUDDBG ("PLAY requested, starting play thread\n");
     play_loop (midifile);
 
@@ -248,40 +259,28 @@ void AMIDIPlug::generate_ticks (midifile_t & midifile, int num_ticks)
 void AMIDIPlug::play_loop (midifile_t & midifile)
 {
     int tick = midifile.start_tick;
+    int event_pos = 0;
     bool stopped = false;
 
-    /* initialize current position in each track */
-    for (midifile_track_t & track : midifile.tracks)
-        track.current_event = track.events.head ();
-
     while (! (stopped = check_stop ()))
     {
         int seektime = check_seek ();
         if (seektime >= 0)
-            tick = skip_to (midifile, seektime);
-
-        midievent_t * event = nullptr;
-        midifile_track_t * event_track = nullptr;
-        int min_tick = midifile.max_tick + 1;
-
-        /* search next event */
-        for (midifile_track_t & track : midifile.tracks)
         {
-            midievent_t * e2 = track.current_event;
-
-            if ((e2) && (e2->tick < min_tick))
-            {
-                min_tick = e2->tick;
-                event = e2;
-                event_track = & track;
-            }
+            s_buffered = 0;  /* drop audio from before the seek */
+            tick = skip_to (midifile, seektime, event_pos);
         }
 
-        if (!event)
+        if (event_pos >= midifile.events.len ())
+            break; /* end of song reached */
+
+        midievent_t * event = midifile.events[event_pos];
+
+        if (event->tick > midifile.max_tick)
             break; /* end of song reached */
 
         /* advance pointer to next event */
-        event_track->current_event = event_track->events.next (event);
+        event_pos ++;
 
         if (event->tick > tick)
         {
@@ -345,16 +344,106 @@ void AMIDIPlug::play_loop (midifile_t & midifile)
     }
 
     if (! stopped)
+    {
         generate_ticks (midifile, midifile.max_tick - tick);
+        audio_flush ();
+    }
 
     backend_reset ();
 }
 
 
-/* amidigplug_skipto: re-do all events that influence the playing of our
-   midi file; re-do them using a time-tick of 0, so they are processed
-   istantaneously and proceed this way until the playing_tick is reached */
-int AMIDIPlug::skip_to (midifile_t & midifile, int seektime)
+static void send_controller (int channel, int c, int value)
+{
+    midievent_t event;
+    event.type = SND_SEQ_EVENT_CONTROLLER;
+    event.d[0] = channel;
+    event.d[1] = c;
+    event.d[2] = value;
+
+    seq_event_controller (& event);
+}
+
+static void send_controller_if_set (int channel, int c, unsigned char value)
+{
+    if (value != MIDI_UNSET)
+        send_controller (channel, c, value);
+}
+
+/* bring the backend (just reset) into the state kept in a snapshot */
+static void restore_channel (int channel, const midichannel_state_t & state)
+{
+    midievent_t event;
+    event.d[0] = channel;
+
+    /* the program, with the bank it was selected from */
+    if (state.program != MIDI_UNSET)
+    {
+        send_controller_if_set (channel, 0, state.program_bank[0]);
+        send_controller_if_set (channel, 32, state.program_bank[1]);
+
+        event.type = SND_SEQ_EVENT_PGMCHANGE;
+        event.d[1] = state.program;
+        seq_event_pgmchange (& event);
+    }
+
+    /* the registered parameters, one after the other */
+    for (int p = 0; p < MIDI_RPN_COUNT; p ++)
+    {
+        if (state.rpn[p][0] == MIDI_UNSET && state.rpn[p][1] == MIDI_UNSET)
+            continue;
+
+        send_controller (channel, 101, 0);
+        send_controller (channel, 100, p);
+        send_controller_if_set (channel, 6, state.rpn[p][0]);
+        send_controller_if_set (channel, 38, state.rpn[p][1]);
+    }
+
+    /* plain controllers, then the parameter selection last in effect */
+    for (int c = 0; c < 120; c ++)
+    {
+        if (c == 6 || c == 38 || (c >= 98 && c <= 101))
+            continue;
+
+        send_controller_if_set (channel, c, state.cc[c]);
+    }
+
+    if (state.nrpn)
+    {
+        send_controller_if_set (channel, 99, state.cc[99]);
+        send_controller_if_set (channel, 98, state.cc[98]);
+        send_controller_if_set (channel, 6, state.cc[6]);
+        send_controller_if_set (channel, 38, state.cc[38]);
+    }
+    else
+    {
+        send_controller_if_set (channel, 101, state.cc[101]);
+        send_controller_if_set (channel, 100, state.cc[100]);
+    }
+
+    if (state.pressure != MIDI_UNSET)
+    {
+        event.type = SND_SEQ_EVENT_CHANPRESS;
+        event.d[1] = state.pressure;
+        seq_event_chanpress (& event);
+    }
+
+    if (state.pitchbend[0] != MIDI_UNSET)
+    {
+        event.type = SND_SEQ_EVENT_PITCHBEND;
+        event.d[1] = state.pitchbend[0];
+        event.d[2] = state.pitchbend[1];
+        seq_event_pitchbend (& event);
+    }
+}
+
+
+/* amidigplug_skipto: restore the state from the nearest snapshot before
+   the requested tick, then re-do the events that influence the playing of
+   our midi file from there; re-do them using a time-tick of 0, so they are
+   processed istantaneously and proceed this way until the playing_tick is
+   reached */
+int AMIDIPlug::skip_to (midifile_t & midifile, int seektime, int & event_pos)
 {
     backend_reset ();
 
@@ -362,45 +451,25 @@ int AMIDIPlug::skip_to (midifile_t & midifile, int seektime)
     if (midifile.avg_microsec_per_tick > 0)
         tick += (int64_t) seektime * 1000 / midifile.avg_microsec_per_tick;
 
-    /* initialize current position in each track */
-    for (midifile_track_t & track : midifile.tracks)
-        track.current_event = track.events.head ();
+    int target_pos = midifile.find_event (tick);
+    const midisnapshot_t * snapshot = midifile.find_snapshot (target_pos);
 
-    for (;;)
+    if (snapshot)
     {
-        midievent_t * event = nullptr;
-        midifile_track_t * event_track = nullptr;
-        int min_tick = midifile.max_tick + 1;
+        AUDDBG ("SKIPTO request, restoring snapshot at event %i\n", snapshot->event_pos);
 
-        /* search next event */
-        for (midifile_track_t & track : midifile.tracks)
-        {
-            midievent_t * e2 = track.current_event;
+        for (int c = 0; c < MIDI_CHANNELS; c ++)
+            restore_channel (c, snapshot->channels[c]);
 
-            if ((e2) && (e2->tick < min_tick))
-            {
-                min_tick = e2->tick;
-                event = e2;
-                event_track = & track;
-            }
-        }
-
-        /* unlikely here... unless very strange MIDI files are played :) */
-        if (!event)
-        {
-            AUDDBG ("SKIPTO request, reached the last event but not the requested tick (!)\n");
-            break; /* end of song reached */
-        }
-
-        /* reached the requested tick, job done */
-        if (event->tick >= tick)
-        {
-            AUDDBG ("SKIPTO request, reached the requested tick, exiting from skipto loop\n");
-            break;
-        }
+        midifile.current_tempo = snapshot->tempo;
+        event_pos = snapshot->event_pos;
+    }
+    else
+        event_pos = 0;
 
-        /* advance pointer to next event */
-        event_track->current_event = event_track->events.next (event);
+    for (; event_pos < target_pos; event_pos ++)
+    {
+        midievent_t * event = midifile.events[event_pos];
 
         switch (event->type)
         {
@@ -37,41 +37,63 @@ typedef struct
     fluid_settings_t * settings;
     fluid_synth_t * synth;
 
+    /* settings that can only be set when creating the synth */
+    int samplerate;
+    int cpu_cores;
+
+    /* FluidSynth's defaults, used when a setting is not overridden */
+    double default_gain;
+    int default_polyphony;
+    int default_reverb;
+    int default_chorus;
+
+    /* soundfonts loaded into the synth, in load order (-1 = failed) */
+    Index<String> soundfont_files;
     Index<int> soundfont_ids;
 }
 sequencer_client_t;
 
 /* sequencer instance */
 static sequencer_client_t sc;
+
+/* FluidSynth 1.x returns true from the settings getters on success,
+   2.x returns FLUID_OK (which is 0) */
+#if FLUIDSYNTH_VERSION_MAJOR >= 2
+#define FSYN_GET_OK(ret) ((ret) == FLUID_OK)
+#else
+#define FSYN_GET_OK(ret) ((ret) != 0)
+#endif
+
+/* fluid_synth_set_reverb_on () and fluid_synth_set_chorus_on () are
+   deprecated since 2.2, which can switch all effect groups at once */
+#if FLUIDSYNTH_VERSION_MAJOR > 2 || (FLUIDSYNTH_VERSION_MAJOR == 2 && FLUIDSYNTH_VERSION_MINOR >= 2)
+#define FSYN_REVERB_ON(synth, on) fluid_synth_reverb_on (synth, -1, on)
+#define FSYN_CHORUS_ON(synth, on) fluid_synth_chorus_on (synth, -1, on)
+#else
+#define FSYN_REVERB_ON(synth, on) fluid_synth_set_reverb_on (synth, on)
+#define FSYN_CHORUS_ON(synth, on) fluid_synth_set_chorus_on (synth, on)
+#endif
 /* options */
 
+static void i_synth_create (int samplerate, int cpu_cores);
+static void i_synth_update ();
 static void i_soundfont_load ();
 
+/* (re)configures the synth from the current settings; the synth and the
+   soundfonts loaded into it are kept as long as the settings allow, so
+   that large soundfonts are not loaded again for every song */
 void backend_init ()
 {
-    sc.settings = new_fluid_settings();
-
-    fluid_settings_setnum (sc.settings, "synth.sample-rate",
-     aud_get_int ("amidiplug", "fsyn_synth_samplerate"));
-
-    int gain = aud_get_int ("amidiplug", "fsyn_synth_gain");
-    int polyphony = aud_get_int ("amidiplug", "fsyn_synth_polyphony");
-    int reverb = aud_get_int ("amidiplug", "fsyn_synth_reverb");
-    int chorus = aud_get_int ("amidiplug", "fsyn_synth_chorus");
+    int samplerate = aud_get_int ("amidiplug", "fsyn_synth_samplerate");
+    int cpu_cores = aud_get_int ("amidiplug", "fsyn_synth_cpu_cores");
 
-    if (gain != -1)
-        fluid_settings_setnum (sc.settings, "synth.gain", gain / 10.0);
-
-    if (polyphony != -1)
-        fluid_settings_setint (sc.settings, "synth.polyphony", polyphony);
-
-    if (reverb != -1)
-        fluid_settings_setint (sc.settings, "synth.reverb.active", reverb);
-
-    if (chorus != -1)
-        fluid_settings_setint (sc.settings, "synth.chorus.active", chorus);
+    if (sc.synth && (samplerate != sc.samplerate || cpu_cores != sc.cpu_cores))
+        backend_cleanup ();
 
-    sc.synth = new_fluid_synth (sc.settings);
+    if (! sc.synth)
+        i_synth_create (samplerate, cpu_cores);
+    else
+        i_synth_update ();
 
     /* load soundfonts */
     i_soundfont_load();
@@ -80,13 +102,23 @@ void backend_init ()
 
 void backend_cleanup ()
 {
+    if (! sc.synth)
+        return;
+
     /* unload soundfonts */
     for (int id : sc.soundfont_ids)
-        fluid_synth_sfunload (sc.synth, id, 0);
+    {
+        if (id != -1)
+            fluid_synth_sfunload (sc.synth, id, 0);
+    }
 
+    sc.soundfont_files.clear ();
     sc.soundfont_ids.clear ();
     delete_fluid_synth (sc.synth);
     delete_fluid_settings (sc.settings);
+
+    sc.synth = nullptr;
+    sc.settings = nullptr;
 }
 
 
@@ -182,16 +214,15 @@ void seq_event_allnoteoff (int unused)
 }
 
 
-void backend_generate_audio (void * buf, int bufsize)
+void backend_generate_audio (float * buf, int frames)
 {
-    fluid_synth_write_s16 (sc.synth, bufsize / 4, buf, 0, 2, buf, 1, 2);
+    fluid_synth_write_float (sc.synth, frames, buf, 0, 2, buf, 1, 2);
 }
 
 
-void backend_audio_info (int * channels, int * bitdepth, int * samplerate)
+void backend_audio_info (int * channels, int * samplerate)
 {
-    *channels = 2;
-    *bitdepth = 16; /* always 16 bit, we use fluid_synth_write_s16() */
+    *channels = 2; /* always interleaved stereo float, see backend_generate_audio() */
     *samplerate = aud_get_int ("amidiplug", "fsyn_synth_samplerate");
 }
 
@@ -200,30 +231,111 @@ void backend_audio_info (int * channels, int * bitdepth, int * samplerate)
    *** INTERNALS ****************************************************
    ****************************************************************** */
 
+static void i_synth_create (int samplerate, int cpu_cores)
+{
+    sc.settings = new_fluid_settings();
+
+    /* remember the defaults before overriding anything */
+    if (! FSYN_GET_OK (fluid_settings_getnum (sc.settings, "synth.gain", & sc.default_gain)))
+        sc.default_gain = 0.2;
+    if (! FSYN_GET_OK (fluid_settings_getint (sc.settings, "synth.polyphony", & sc.default_polyphony)))
+        sc.default_polyphony = 256;
+    if (! FSYN_GET_OK (fluid_settings_getint (sc.settings, "synth.reverb.active", & sc.default_reverb)))
+        sc.default_reverb = 1;
+    if (! FSYN_GET_OK (fluid_settings_getint (sc.settings, "synth.chorus.active", & sc.default_chorus)))
+        sc.default_chorus = 1;
+
+    fluid_settings_setnum (sc.settings, "synth.sample-rate", samplerate);
+
+    if (cpu_cores > 1)
+        fluid_settings_setint (sc.settings, "synth.cpu-cores", cpu_cores);
+
+    int gain = aud_get_int ("amidiplug", "fsyn_synth_gain");
+    int polyphony = aud_get_int ("amidiplug", "fsyn_synth_polyphony");
+    int reverb = aud_get_int ("amidiplug", "fsyn_synth_reverb");
+    int chorus = aud_get_int ("amidiplug", "fsyn_synth_chorus");
+
+    if (gain != -1)
+        fluid_settings_setnum (sc.settings, "synth.gain", gain / 10.0);
+
+    if (polyphony != -1)
+        fluid_settings_setint (sc.settings, "synth.polyphony", polyphony);
+
+    if (reverb != -1)
+        fluid_settings_setint (sc.settings, "synth.reverb.active", reverb);
+
+    if (chorus != -1)
+        fluid_settings_setint (sc.settings, "synth.chorus.active", chorus);
+
+    sc.synth = new_fluid_synth (sc.settings);
+    sc.samplerate = samplerate;
+    sc.cpu_cores = cpu_cores;
+}
+
+
+/* apply the settings that can be changed on a running synth */
+static void i_synth_update ()
+{
+    int gain = aud_get_int ("amidiplug", "fsyn_synth_gain");
+    int polyphony = aud_get_int ("amidiplug", "fsyn_synth_polyphony");
+    int reverb = aud_get_int ("amidiplug", "fsyn_synth_reverb");
+    int chorus = aud_get_int ("amidiplug", "fsyn_synth_chorus");
+
+    fluid_synth_set_gain (sc.synth, (gain != -1) ? gain / 10.0 : sc.default_gain);
+    fluid_synth_set_polyphony (sc.synth, (polyphony != -1) ? polyphony : sc.default_polyphony);
+    FSYN_REVERB_ON (sc.synth, (reverb != -1) ? reverb : sc.default_reverb);
+    FSYN_CHORUS_ON (sc.synth, (chorus != -1) ? chorus : sc.default_chorus);
+}
+
+
+/* brings the loaded soundfonts in line with the configured list; only
+   the ones after the first difference are unloaded and loaded again,
+   since the load order decides which soundfont a preset is taken from */
 static void i_soundfont_load ()
 {
     String soundfont_file = aud_get_str ("amidiplug", "fsyn_soundfont_file");
+    Index<String> sffiles;
 
     if (soundfont_file[0])
-    {
-        Index<String> sffiles = str_list_to_index (soundfont_file, ";");
+        sffiles = str_list_to_index (soundfont_file, ";");
+    else
+        AUDWARN ("FluidSynth backend was selected, but no SoundFont has been specified\n");
+
+    int keep = 0;
+    while (keep < sffiles.len () && keep < sc.soundfont_files.len () &&
+     ! strcmp (sffiles[keep], sc.soundfont_files[keep]))
+        keep ++;
 
-        for (const char * sffile : sffiles)
+    if (keep == sffiles.len () && keep == sc.soundfont_files.len ())
+        return; /* nothing changed */
+
+    for (int i = sc.soundfont_ids.len () - 1; i >= keep; i --)
+    {
+        if (sc.soundfont_ids[i] != -1)
         {
-            AUDDBG ("loading soundfont %s\n", sffile);
-            int sf_id = fluid_synth_sfload (sc.synth, sffile, 0);
-
-            if (sf_id == -1)
-                AUDWARN ("unable to load SoundFont file %s\n", sffile);
-            else
-            {
-                AUDDBG ("soundfont %s successfully loaded\n", sffile);
-                sc.soundfont_ids.append (sf_id);
-            }
+            AUDDBG ("unloading soundfont %s\n", (const char *) sc.soundfont_files[i]);
+            fluid_synth_sfunload (sc.synth, sc.soundfont_ids[i], 0);
         }
+    }
+
+    sc.soundfont_files.remove (keep, -1);
+    sc.soundfont_ids.remove (keep, -1);
+
+    for (int i = keep; i < sffiles.len (); i ++)
+    {
+        const char * sffile = sffiles[i];
+
+        AUDDBG ("loading soundfont %s\n", sffile);
+        int sf_id = fluid_synth_sfload (sc.synth, sffile, 0);
 
-        fluid_synth_system_reset (sc.synth);
+        if (sf_id == -1)
+            AUDWARN ("unable to load SoundFont file %s\n", sffile);
+        else
+            AUDDBG ("soundfont %s successfully loaded\n", sffile);
+
+        sc.soundfont_files.append (sffiles[i]);
+        sc.soundfont_ids.append (sf_id);
     }
-    else
-        AUDWARN ("FluidSynth backend was selected, but no SoundFont has been specified\n");
+
+    fluid_synth_system_reset (sc.synth);
 }
@@ -27,8 +27,8 @@ void backend_init ();
 void backend_cleanup ();
 void backend_reset ();
 
-void backend_audio_info (int *, int *, int *);
-void backend_generate_audio (void * buf, int bufsize);
+void backend_audio_info (int *, int *);
+void backend_generate_audio (float * buf, int frames);
 
 void seq_event_noteon (midievent_t *);
 void seq_event_noteoff (midievent_t *);
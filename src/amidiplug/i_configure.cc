@@ -152,7 +152,10 @@ static const PreferencesWidget amidiplug_widgets[] = {
     WidgetBox ({{chorus_widgets}, true}),
     WidgetSpin (N_("Sample rate:"),
         WidgetInt ("amidiplug", "fsyn_synth_samplerate", backend_change),
-        {22050, 96000, 1, N_("Hz")})
+        {22050, 96000, 1, N_("Hz")}),
+    WidgetSpin (N_("CPU cores:"),
+        WidgetInt ("amidiplug", "fsyn_synth_cpu_cores", backend_change),
+        {1, 16, 1})
 };
 
 const PluginPreferences amidiplug_prefs = {
@@ -26,6 +26,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include <libaudcore/audstrings.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/vfs.h>
@@ -489,11 +491,64 @@ bool midifile_t::parse_smf (int port_count)
     if (start_tick < 0)
         start_tick = 0;
 
+    merge_tracks ();
+
     /* ok, success */
     return true;
 }
 
 
+struct MergeCursor
+{
+    midievent_t * event;
+    int track;
+
+    MergeCursor (midievent_t * event, int track) :
+        event (event), track (track) {}
+};
+
+/* heap order: the cursor whose event is played last is on top */
+static bool merge_later (const MergeCursor & a, const MergeCursor & b)
+{
+    if (a.event->tick != b.event->tick)
+        return a.event->tick > b.event->tick;
+
+    return a.track > b.track;
+}
+
+/* merge the events of all tracks into a single list sorted by tick;
+   events on the same tick are taken from the first track first */
+void midifile_t::merge_tracks ()
+{
+    Index<MergeCursor> heap;
+
+    for (int t = 0; t < tracks.len (); t ++)
+    {
+        midievent_t * event = tracks[t].events.head ();
+        if (event)
+            heap.append (event, t);
+    }
+
+    std::make_heap (heap.begin (), heap.end (), merge_later);
+    events.clear ();
+
+    while (heap.len ())
+    {
+        std::pop_heap (heap.begin (), heap.end (), merge_later);
+
+        MergeCursor & cursor = heap[heap.len () - 1];
+        events.append (cursor.event);
+
+        cursor.event = tracks[cursor.track].events.next (cursor.event);
+
+        if (cursor.event)
+            std::push_heap (heap.begin (), heap.end (), merge_later);
+        else
+            heap.remove (heap.len () - 1, 1);
+    }
+}
+
+
 /* read a MIDI file enclosed in RIFF format */
 /* return values: 0 = error, 1 = ok */
 bool midifile_t::parse_riff ()
@@ -587,8 +642,7 @@ bool midifile_t::setget_tempo ()
 }
 
 
-/* this will set the midi length in microseconds
-   COMMENT: this will also reset current position in each track! */
+/* this will set the midi length in microseconds */
 void midifile_t::setget_length ()
 {
     int64_t length_microsec = 0;
@@ -596,43 +650,15 @@ void midifile_t::setget_length ()
     /* get the first microsec_per_tick ratio */
     int microsec_per_tick = (int) (current_tempo / ppq);
 
-    /* initialize current position in each track */
-    for (midifile_track_t & track : tracks)
-        track.current_event = track.events.head ();
-
-    /* search for tempo events in each track; in fact, since the program
-       currently supports type 0 and type 1 MIDI files, we should find
-       tempo events only in one track */
+    /* search for tempo events; in fact, since the program currently
+       supports type 0 and type 1 MIDI files, we should find tempo events
+       only in one track */
     AUDDBG ("LENGTH calc: starting calc loop\n");
 
-    for (;;)
+    for (midievent_t * event : events)
     {
-        midievent_t * event = nullptr;
-        midifile_track_t * event_track = nullptr;
-        int min_tick = max_tick + 1;
-
-        /* search next event */
-        for (midifile_track_t & track : tracks)
-        {
-            midievent_t * e2 = track.current_event;
-
-            if (e2 && e2->tick < min_tick)
-            {
-                min_tick = e2->tick;
-                event = e2;
-                event_track = & track;
-            }
-        }
-
-        if (!event)
-        {
-            /* calculate the remaining length */
-            length_microsec += (microsec_per_tick * (max_tick - last_tick));
+        if (event->tick > max_tick)
             break; /* end of song reached */
-        }
-
-        /* advance pointer to next event */
-        event_track->current_event = event_track->events.next (event);
 
         /* check if this is a tempo event */
         if (event->type == SND_SEQ_EVENT_TEMPO)
@@ -648,6 +674,9 @@ void midifile_t::setget_length ()
         }
     }
 
+    /* calculate the remaining length */
+    length_microsec += (microsec_per_tick * (max_tick - last_tick));
+
     /* IMPORTANT
        this couple of important values is set by midifile_t::set_length */
     length = length_microsec;
@@ -662,8 +691,7 @@ void midifile_t::setget_length ()
 
 
 /* this will get the weighted average bpm of the midi file;
-   if the file has a variable bpm, 'bpm' is set to -1;
-   COMMENT: this will also reset current position in each track! */
+   if the file has a variable bpm, 'bpm' is set to -1 */
 void midifile_t::get_bpm (int * bpm, int * wavg_bpm)
 {
     int last_tick = start_tick;
@@ -671,46 +699,15 @@ void midifile_t::get_bpm (int * bpm, int * wavg_bpm)
     bool is_monotempo = true;
     int last_tempo = current_tempo;
 
-    /* initialize current position in each track */
-    for (midifile_track_t & track : tracks)
-        track.current_event = track.events.head ();
-
-    /* search for tempo events in each track; in fact, since the program
-       currently supports type 0 and type 1 MIDI files, we should find
-       tempo events only in one track */
+    /* search for tempo events; in fact, since the program currently
+       supports type 0 and type 1 MIDI files, we should find tempo events
+       only in one track */
     AUDDBG ("BPM calc: starting calc loop\n");
 
-    for (;;)
+    for (midievent_t * event : events)
     {
-        midievent_t * event = nullptr;
-        midifile_track_t * event_track = nullptr;
-        int min_tick = max_tick + 1;
-
-        /* search next event */
-        for (midifile_track_t & track : tracks)
-        {
-            midievent_t * e2 = track.current_event;
-
-            if (e2 && e2->tick < min_tick)
-            {
-                min_tick = e2->tick;
-                event = e2;
-                event_track = & track;
-            }
-        }
-
-        if (!event)
-        {
-            /* calculate the remaining length */
-            if (max_tick > start_tick)
-                weighted_avg_tempo += (unsigned) (last_tempo *
-                 ((float) (max_tick - last_tick) / (float) (max_tick - start_tick)));
-
+        if (event->tick > max_tick)
             break; /* end of song reached */
-        }
-
-        /* advance pointer to next event */
-        event_track->current_event = event_track->events.next (event);
 
         /* check if this is a tempo event */
         if (event->type == SND_SEQ_EVENT_TEMPO)
@@ -734,6 +731,11 @@ void midifile_t::get_bpm (int * bpm, int * wavg_bpm)
         }
     }
 
+    /* calculate the remaining length */
+    if (max_tick > start_tick)
+        weighted_avg_tempo += (unsigned) (last_tempo *
+         ((float) (max_tick - last_tick) / (float) (max_tick - start_tick)));
+
     AUDDBG ("BPM calc: weighted average tempo: %i\n", weighted_avg_tempo);
 
     if (weighted_avg_tempo > 0)
@@ -800,3 +802,179 @@ bool midifile_t::parse_from_file (const char * filename, VFSFile & file)
 
     return success;
 }
+
+
+void midichannel_state_t::reset ()
+{
+    memset (cc, MIDI_UNSET, sizeof cc);
+    memset (rpn, MIDI_UNSET, sizeof rpn);
+    program = MIDI_UNSET;
+    memset (program_bank, MIDI_UNSET, sizeof program_bank);
+    pressure = MIDI_UNSET;
+    memset (pitchbend, MIDI_UNSET, sizeof pitchbend);
+    nrpn = false;
+}
+
+
+/* "reset all controllers" leaves bank select, volume, pan and the effect
+   depths alone, and deselects the current (N)RPN */
+void midichannel_state_t::reset_controllers ()
+{
+    for (int c = 0; c < 128; c ++)
+    {
+        switch (c)
+        {
+        case 0: case 32:    /* bank select */
+        case 7: case 39:    /* volume */
+        case 10: case 42:   /* pan */
+        case 91: case 92: case 93: case 94: case 95:
+            break;
+
+        default:
+            cc[c] = MIDI_UNSET;
+            break;
+        }
+    }
+
+    cc[101] = cc[100] = 127;  /* null RPN */
+    nrpn = false;
+
+    pressure = MIDI_UNSET;
+    memset (pitchbend, MIDI_UNSET, sizeof pitchbend);
+}
+
+
+void midichannel_state_t::set_controller (int c, int value)
+{
+    switch (c)
+    {
+    case 6: case 38:  /* data entry MSB/LSB */
+        /* keep the value of each registered parameter separately, since
+           they are all in effect at the same time */
+        if (! nrpn && cc[101] == 0 && cc[100] < MIDI_RPN_COUNT)
+        {
+            rpn[cc[100]][c == 38] = value;
+            return;
+        }
+        break;
+
+    case 96: case 97:  /* data increment/decrement, can't be kept as a value */
+        return;
+
+    case 98: case 99:
+        nrpn = true;
+        break;
+
+    case 100: case 101:
+        nrpn = false;
+        break;
+
+    case 121:
+        reset_controllers ();
+        return;
+
+    default:
+        if (c >= 120)
+            return;  /* other channel mode messages */
+        break;
+    }
+
+    cc[c] = value;
+}
+
+
+void midichannel_state_t::apply (const midievent_t & event)
+{
+    switch (event.type)
+    {
+    case SND_SEQ_EVENT_CONTROLLER:
+        set_controller (event.d[1], event.d[2]);
+        break;
+
+    case SND_SEQ_EVENT_PGMCHANGE:
+        program = event.d[1];
+        program_bank[0] = cc[0];
+        program_bank[1] = cc[32];
+        break;
+
+    case SND_SEQ_EVENT_CHANPRESS:
+        pressure = event.d[1];
+        break;
+
+    case SND_SEQ_EVENT_PITCHBEND:
+        pitchbend[0] = event.d[1];
+        pitchbend[1] = event.d[2];
+        break;
+    }
+}
+
+
+void midisnapshot_t::apply (const midievent_t & event)
+{
+    switch (event.type)
+    {
+    case SND_SEQ_EVENT_CONTROLLER:
+    case SND_SEQ_EVENT_PGMCHANGE:
+    case SND_SEQ_EVENT_CHANPRESS:
+    case SND_SEQ_EVENT_PITCHBEND:
+        if (event.d[0] < MIDI_CHANNELS)
+            channels[event.d[0]].apply (event);
+        break;
+
+    case SND_SEQ_EVENT_TEMPO:
+        tempo = event.tempo;
+        break;
+    }
+}
+
+
+/* take a snapshot of the playback state every MIDI_SNAPSHOT_INTERVAL
+   events; must be called before playback changes current_tempo */
+void midifile_t::build_snapshots ()
+{
+    midisnapshot_t state;
+    state.tempo = current_tempo;
+
+    snapshots.clear ();
+
+    for (int i = 0; i < events.len (); i ++)
+    {
+        if (i % MIDI_SNAPSHOT_INTERVAL == 0)
+        {
+            state.event_pos = i;
+            snapshots.append (state);
+        }
+
+        state.apply (* events[i]);
+    }
+
+    AUDDBG ("SNAPSHOTS: %d events, %d snapshots\n", events.len (), snapshots.len ());
+}
+
+
+/* returns the index of the first event at or after the given tick */
+int midifile_t::find_event (int tick) const
+{
+    int low = 0, high = events.len ();
+
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+
+        if (events[mid]->tick < tick)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+
+/* returns the last snapshot taken at or before the given event, or
+   nullptr if there are none */
+const midisnapshot_t * midifile_t::find_snapshot (int event_pos) const
+{
+    int i = aud::min (event_pos / MIDI_SNAPSHOT_INTERVAL, snapshots.len () - 1);
+    return (i >= 0) ? & snapshots[i] : nullptr;
+}
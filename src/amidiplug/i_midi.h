@@ -232,7 +232,6 @@ struct midifile_track_t
     List<midievent_t> events;           /* list of all events in this track */
     int start_tick;                     /* start of this track */
     int end_tick;			/* length of this track */
-    midievent_t * current_event;	/* used while loading and playing */
 
     midievent_t * add_event ()
     {
@@ -246,9 +245,54 @@ struct midifile_track_t
 };
 
 
+#define MIDI_CHANNELS 16
+#define MIDI_RPN_COUNT 6        /* registered parameters kept in a snapshot */
+#define MIDI_UNSET 0xff         /* value never set in the file */
+
+/* the state of one channel left behind by the controller, program change,
+   channel pressure and pitch bend events played so far */
+struct midichannel_state_t
+{
+    unsigned char cc[128];
+    unsigned char rpn[MIDI_RPN_COUNT][2];   /* data entry MSB/LSB per RPN */
+    unsigned char program;
+    unsigned char program_bank[2];          /* bank MSB/LSB at program change */
+    unsigned char pressure;
+    unsigned char pitchbend[2];
+    bool nrpn;                              /* an NRPN was selected last */
+
+    midichannel_state_t ()
+        { reset (); }
+
+    void reset ();
+    void apply (const midievent_t & event);
+
+private:
+    void set_controller (int c, int value);
+    void reset_controllers ();
+};
+
+
+/* the playback state before a given event; snapshots are taken every
+   MIDI_SNAPSHOT_INTERVAL events so that seeking only has to replay the
+   events since the nearest one */
+#define MIDI_SNAPSHOT_INTERVAL 4096
+
+struct midisnapshot_t
+{
+    int event_pos;
+    int tempo;
+    midichannel_state_t channels[MIDI_CHANNELS];
+
+    void apply (const midievent_t & event);
+};
+
+
 struct midifile_t
 {
     Index<midifile_track_t> tracks;
+    Index<midievent_t *> events;        /* events of all tracks, sorted by tick */
+    Index<midisnapshot_t> snapshots;    /* filled by build_snapshots () */
 
     unsigned short format = 0;
     int start_tick = 0;
@@ -265,6 +309,10 @@ struct midifile_t
     void get_bpm (int *, int *);
     bool parse_from_file (const char *, VFSFile & file);
 
+    void build_snapshots ();
+    int find_event (int tick) const;
+    const midisnapshot_t * find_snapshot (int event_pos) const;
+
 private:
     String file_name;
     Index<char> file_data;
@@ -279,6 +327,7 @@ private:
     int read_var ();
     bool read_track (midifile_track_t &, int, int);
     bool parse_smf (int);
+    void merge_tracks ();
     bool parse_riff ();
     bool setget_tempo ();
     void setget_length ();
@@ -19,9 +19,8 @@
 
 #include <string.h>
 
-#include <libxml/parser.h>
-#include <libxml/tree.h>
-#include <libxml/xmlsave.h>
+#include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
 
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
@@ -59,39 +58,33 @@ static int close_cb (void * file)
     return 0;
 }
 
-static const char * get_content (const xmlNode * node)
+/* returns the value of an attribute of the current element, ignoring case */
+static String get_prop_nocase (xmlTextReader * reader, const char * name)
 {
-    const xmlNode * child = node->xmlChildrenNode;
-    if (child && child->type == XML_TEXT_NODE && child->content)
-        return (const char *) child->content;
+    String value;
 
-    return nullptr;
-}
-
-static const char * get_prop_nocase (const xmlNode * node, const char * name)
-{
-    for (const xmlAttr * prop = node->properties; prop; prop = prop->next)
+    while (xmlTextReaderMoveToNextAttribute (reader) == 1)
     {
-        if (! xmlStrcasecmp (prop->name, (const xmlChar *) name))
+        if (! xmlStrcasecmp (xmlTextReaderConstLocalName (reader), (const xmlChar *) name))
         {
-            const xmlNode * child = prop->children;
-            if (child && child->type == XML_TEXT_NODE && child->content)
-                return (const char *) child->content;
+            value = String ((const char *) xmlTextReaderConstValue (reader));
+            break;
         }
     }
 
-    return nullptr;
+    xmlTextReaderMoveToElement (reader);
+    return value;
 }
 
-static bool check_root (const xmlNode * root)
+static bool check_root (xmlTextReader * reader)
 {
-    if (xmlStrcasecmp (root->name, (const xmlChar *) "asx"))
+    if (xmlStrcasecmp (xmlTextReaderConstLocalName (reader), (const xmlChar *) "asx"))
     {
         AUDERR ("Not an ASX file\n");
         return false;
     }
 
-    const char * version = get_prop_nocase (root, "version");
+    String version = get_prop_nocase (reader, "version");
 
     if (! version)
     {
@@ -101,87 +94,110 @@ static bool check_root (const xmlNode * root)
 
     if (strcmp (version, "3.0"))
     {
-        AUDERR ("Unsupported ASX version (%s)\n", version);
+        AUDERR ("Unsupported ASX version (%s)\n", (const char *) version);
         return false;
     }
 
     return true;
 }
 
-static void parse_entry (const xmlNode * entry, Index<PlaylistAddItem> & items)
-{
-    for (const xmlNode * node = entry->xmlChildrenNode; node; node = node->next)
-    {
-        if (! xmlStrcasecmp (node->name, (const xmlChar *) "ref"))
-        {
-            const char * uri = get_prop_nocase (node, "href");
-            if (uri)
-                items.append (String (uri));
-        }
-    }
-}
-
+/* The playlist is read as a stream of nodes rather than as a document
+ * tree, so that large playlists don't have to be held in memory twice:
+ *
+ *   depth 0: <asx version="3.0">
+ *   depth 1:   <title>, <entry>
+ *   depth 2:     <ref href="...">
+ */
 bool ASX3Loader::load (const char * filename, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
-    xmlDoc * doc = xmlReadIO (read_cb, close_cb, & file, filename, nullptr, XML_PARSE_RECOVER);
-    if (! doc)
+    xmlTextReader * reader = xmlReaderForIO (read_cb, close_cb, & file,
+     filename, nullptr, XML_PARSE_RECOVER);
+    if (! reader)
         return false;
 
-    xmlNode * root = xmlDocGetRootElement (doc);
+    bool valid = false;
+    bool in_entry = false;
 
-    if (! root || ! check_root (root))
+    while (xmlTextReaderRead (reader) == 1)
     {
-        xmlFreeDoc(doc);
-        return false;
-    }
+        if (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT)
+            continue;
 
-    for (xmlNode * node = root->xmlChildrenNode; node; node = node->next)
-    {
-        if (! xmlStrcasecmp (node->name, (const xmlChar *) "entry"))
-            parse_entry (node, items);
-        else if (! xmlStrcasecmp (node->name, (const xmlChar *) "title"))
+        const xmlChar * name = xmlTextReaderConstLocalName (reader);
+        int depth = xmlTextReaderDepth (reader);
+
+        if (depth == 0)
         {
-            if (! title)
-                title = String (get_content (node));
+            if (! (valid = check_root (reader)))
+                break;
+        }
+        else if (depth == 1)
+        {
+            in_entry = ! xmlStrcasecmp (name, (const xmlChar *) "entry");
+
+            if (! title && ! xmlStrcasecmp (name, (const xmlChar *) "title"))
+            {
+                xmlChar * content = xmlTextReaderReadString (reader);
+                title = String ((const char *) content);
+                xmlFree (content);
+            }
+        }
+        else if (in_entry && depth == 2 && ! xmlStrcasecmp (name, (const xmlChar *) "ref"))
+        {
+            String uri = get_prop_nocase (reader, "href");
+            if (uri)
+                items.append (std::move (uri));
         }
     }
 
-    xmlFreeDoc(doc);
-    return true;
+    xmlFreeTextReader (reader);
+    return valid;
 }
 
+/* entries are serialized straight to the file as they are written */
 bool ASX3Loader::save (const char * filename, VFSFile & file,
  const char * title, const Index<PlaylistAddItem> & items)
 {
-    xmlDoc * doc = xmlNewDoc ((const xmlChar *) "1.0");
-    doc->charset = XML_CHAR_ENCODING_UTF8;
-    doc->encoding = xmlStrdup ((const xmlChar *) "UTF-8");
-
-    xmlNode * root = xmlNewNode (nullptr, (const xmlChar *) "asx");
-    xmlSetProp (root, (const xmlChar *) "version", (const xmlChar *) "3.0");
-    xmlDocSetRootElement (doc, root);
-
-    if (title)
-        xmlNewTextChild (root, nullptr, (const xmlChar *) "title", (const xmlChar *) title);
+    xmlOutputBuffer * out = xmlOutputBufferCreateIO (write_cb, close_cb, & file, nullptr);
+    if (! out)
+        return false;
 
-    for (auto & item : items)
+    /* the writer takes ownership of the output buffer */
+    xmlTextWriter * writer = xmlNewTextWriter (out);
+    if (! writer)
     {
-        xmlNode * entry = xmlNewNode (nullptr, (const xmlChar *) "entry");
-        xmlNode * ref = xmlNewNode (nullptr, (const xmlChar *) "ref");
-        xmlSetProp (ref, (const xmlChar *) "href", (const xmlChar *) (const char *) item.filename);
-        xmlAddChild (entry, ref);
-        xmlAddChild (root, entry);
+        xmlOutputBufferClose (out);
+        return false;
     }
 
-    xmlSaveCtxt * save = xmlSaveToIO (write_cb, close_cb, & file, nullptr, XML_SAVE_FORMAT);
+    xmlTextWriterSetIndent (writer, 1);
+    xmlTextWriterSetIndentString (writer, (const xmlChar *) "  ");
+
+    bool ok = xmlTextWriterStartDocument (writer, "1.0", "UTF-8", nullptr) >= 0 &&
+     xmlTextWriterStartElement (writer, (const xmlChar *) "asx") >= 0 &&
+     xmlTextWriterWriteAttribute (writer, (const xmlChar *) "version", (const xmlChar *) "3.0") >= 0;
+
+    if (ok && title)
+        ok = xmlTextWriterWriteElement (writer, (const xmlChar *) "title", (const xmlChar *) title) >= 0;
 
-    if (! save || xmlSaveDoc (save, doc) < 0 || xmlSaveClose (save) < 0)
+    for (auto & item : items)
     {
-        xmlFreeDoc(doc);
-        return false;
+        if (! ok)
+            break;
+
+        ok = xmlTextWriterStartElement (writer, (const xmlChar *) "entry") >= 0 &&
+         xmlTextWriterStartElement (writer, (const xmlChar *) "ref") >= 0 &&
+         xmlTextWriterWriteAttribute (writer, (const xmlChar *) "href",
+         (const xmlChar *) (const char *) item.filename) >= 0 &&
+         xmlTextWriterEndElement (writer) >= 0 &&
+         xmlTextWriterEndElement (writer) >= 0;
     }
 
-    xmlFreeDoc (doc);
-    return true;
+    /* closes the root element and flushes */
+    if (ok)
+        ok = xmlTextWriterEndDocument (writer) >= 0;
+
+    xmlFreeTextWriter (writer);
+    return ok;
 }
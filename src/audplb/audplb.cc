@@ -0,0 +1,390 @@
+/*
+ * Audacious binary playlist format plugin
+ * Copyright 2026 Audacious development team
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libaudcore/audio.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/multihash.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/runtime.h>
+
+/*
+ * File layout (all integers are 32-bit little-endian):
+ *
+ *   header        magic "AUDPLBIN", version, n_strings, strings_size,
+ *                 n_columns, n_entries, title
+ *   offsets       n_strings offsets into the string data
+ *   string data   strings_size bytes of null-terminated UTF-8 strings,
+ *                 each stored only once
+ *   columns       n_columns x {name, type}: the tuple fields present in
+ *                 the playlist, by name so that the file does not depend
+ *                 on the order of Tuple::Field
+ *   entries       n_entries x {uri, state, present[mask_words],
+ *                 value[n_columns]}, where mask_words = (n_columns + 31) / 32
+ *
+ * Strings are referred to by their number, values of string columns being
+ * string numbers too.  NO_STRING marks a missing string.  Since every entry
+ * has the same size, the whole file can be used in place once read.
+ */
+
+#define AUDPLB_MAGIC "AUDPLBIN"
+#define AUDPLB_VERSION 1
+#define NO_STRING 0xffffffff
+
+enum {
+    STATE_INITIAL,
+    STATE_VALID,
+    STATE_FAILED
+};
+
+struct AudplbHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_strings;
+    uint32_t strings_size;
+    uint32_t n_columns;
+    uint32_t n_entries;
+    uint32_t title;
+};
+
+static const char * const audplb_exts[] = {"audplb"};
+
+class AudBinaryPlaylistLoader : public PlaylistPlugin
+{
+public:
+    static constexpr PluginInfo info = {N_("Audacious Binary Playlists (audplb)"), PACKAGE};
+
+    constexpr AudBinaryPlaylistLoader () : PlaylistPlugin (info, audplb_exts, true) {}
+
+    bool load (const char * filename, VFSFile & file, String & title,
+     Index<PlaylistAddItem> & items);
+    bool save (const char * filename, VFSFile & file, const char * title,
+     const Index<PlaylistAddItem> & items);
+};
+
+EXPORT AudBinaryPlaylistLoader aud_plugin_instance;
+
+static bool skip_field (Tuple::Field field)
+{
+    /* these are derived from the filename */
+    return field == Tuple::Path || field == Tuple::Basename ||
+     field == Tuple::Suffix || field == Tuple::FormattedTitle;
+}
+
+static uint32_t get32 (const char * data, int64_t pos)
+{
+    uint32_t value;
+    memcpy (& value, data + pos, 4);
+    return FROM_LE32 (value);
+}
+
+bool AudBinaryPlaylistLoader::load (const char * path, VFSFile & file,
+ String & title, Index<PlaylistAddItem> & items)
+{
+    Index<char> data = file.read_all ();
+    const char * base = data.begin ();
+    int64_t size = data.len ();
+
+    if (size < (int64_t) sizeof (AudplbHeader) || memcmp (base, AUDPLB_MAGIC, 8))
+        return false;
+
+    uint32_t version = get32 (base, offsetof (AudplbHeader, version));
+    if (version != AUDPLB_VERSION)
+    {
+        AUDERR ("%s: unsupported version %u\n", path, (unsigned) version);
+        return false;
+    }
+
+    uint32_t n_strings = get32 (base, offsetof (AudplbHeader, n_strings));
+    uint32_t strings_size = get32 (base, offsetof (AudplbHeader, strings_size));
+    uint32_t n_columns = get32 (base, offsetof (AudplbHeader, n_columns));
+    uint32_t n_entries = get32 (base, offsetof (AudplbHeader, n_entries));
+    uint32_t title_id = get32 (base, offsetof (AudplbHeader, title));
+
+    int64_t offsets_pos = sizeof (AudplbHeader);
+    int64_t strings_pos = offsets_pos + 4 * (int64_t) n_strings;
+    int64_t columns_pos = strings_pos + strings_size;
+    int64_t entries_pos = columns_pos + 8 * (int64_t) n_columns;
+
+    /* the header counts are untrusted, so bound each one by the file size
+     * before it is used in a multiplication */
+    if (entries_pos > size)
+    {
+        AUDERR ("%s: invalid file\n", path);
+        return false;
+    }
+
+    int mask_words = ((int64_t) n_columns + 31) / 32;
+    int64_t entry_size = 4 * ((int64_t) 2 + mask_words + n_columns);
+
+    if (n_entries > (size - entries_pos) / entry_size ||
+     entries_pos + entry_size * n_entries != size ||
+     (strings_size && base[strings_pos + strings_size - 1]))
+    {
+        AUDERR ("%s: invalid file\n", path);
+        return false;
+    }
+
+    /* each string is pooled only once, entries then share the reference */
+    Index<String> strings;
+    strings.insert (0, n_strings);
+
+    for (uint32_t i = 0; i < n_strings; i ++)
+    {
+        uint32_t offset = get32 (base, offsets_pos + 4 * i);
+        if (offset >= strings_size)
+        {
+            AUDERR ("%s: invalid string offset\n", path);
+            return false;
+        }
+
+        strings[i] = String (base + strings_pos + offset);
+    }
+
+    auto get_string = [&] (uint32_t id)
+        { return (id < n_strings) ? strings[id] : String (); };
+
+    Index<Tuple::Field> fields;
+    Index<Tuple::ValueType> types;
+
+    for (uint32_t c = 0; c < n_columns; c ++)
+    {
+        String name = get_string (get32 (base, columns_pos + 8 * c));
+        uint32_t type = get32 (base, columns_pos + 8 * c + 4);
+        auto field = name ? Tuple::field_by_name (name) : Tuple::Invalid;
+
+        /* a field whose type has changed since the file was written cannot
+         * be read; such columns are skipped like unknown ones */
+        if (field != Tuple::Invalid && type != (uint32_t) Tuple::field_get_type (field))
+            field = Tuple::Invalid;
+
+        fields.append (field);
+        types.append ((field != Tuple::Invalid) ? Tuple::field_get_type (field) : Tuple::Empty);
+    }
+
+    if (title_id != NO_STRING && ! title)
+        title = get_string (title_id);
+
+    items.insert (-1, n_entries);
+    PlaylistAddItem * item = & items[items.len () - n_entries];
+
+    for (uint32_t e = 0; e < n_entries; e ++, item ++)
+    {
+        int64_t pos = entries_pos + entry_size * e;
+        int64_t mask_pos = pos + 8;
+        int64_t values_pos = mask_pos + 4 * mask_words;
+
+        item->filename = get_string (get32 (base, pos));
+
+        switch (get32 (base, pos + 4))
+        {
+        case STATE_VALID:
+        {
+            Tuple & tuple = item->tuple;
+
+            for (uint32_t c = 0; c < n_columns; c ++)
+            {
+                if (! (get32 (base, mask_pos + 4 * (c / 32)) & (1u << (c % 32))))
+                    continue;
+
+                uint32_t value = get32 (base, values_pos + 4 * c);
+
+                if (types[c] == Tuple::String)
+                {
+                    String str = get_string (value);
+                    if (str)
+                        tuple.set_str (fields[c], str);
+                }
+                else if (types[c] == Tuple::Int)
+                    tuple.set_int (fields[c], (int32_t) value);
+            }
+
+            tuple.set_state (Tuple::Valid);
+
+            if (item->filename)
+                tuple.set_filename (item->filename);
+
+            break;
+        }
+
+        case STATE_FAILED:
+            item->tuple.set_state (Tuple::Failed);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    /* drop entries without a filename */
+    for (int i = items.len () - n_entries; i < items.len (); )
+    {
+        if (items[i].filename)
+            i ++;
+        else
+            items.remove (i, 1);
+    }
+
+    return true;
+}
+
+class StringTable
+{
+public:
+    uint32_t add (const String & str)
+    {
+        if (! str)
+            return NO_STRING;
+
+        uint32_t * id = m_ids.lookup (str);
+        if (id)
+            return * id;
+
+        uint32_t new_id = m_offsets.len ();
+        m_offsets.append (TO_LE32 ((uint32_t) m_data.len ()));
+        m_data.insert (str, -1, strlen (str) + 1);
+        m_ids.add (str, std::move (new_id));
+
+        return new_id;
+    }
+
+    const Index<uint32_t> & offsets () const
+        { return m_offsets; }
+    const Index<char> & data () const
+        { return m_data; }
+
+private:
+    SimpleHash<String, uint32_t> m_ids;
+    Index<uint32_t> m_offsets;
+    Index<char> m_data;
+};
+
+template<class T>
+static bool write_all (VFSFile & file, const Index<T> & data)
+{
+    int64_t size = sizeof (T) * (int64_t) data.len ();
+    return file.fwrite (data.begin (), 1, size) == size;
+}
+
+bool AudBinaryPlaylistLoader::save (const char * path, VFSFile & file,
+ const char * title, const Index<PlaylistAddItem> & items)
+{
+    /* only the fields used by some entry get a column */
+    Index<Tuple::Field> fields;
+    bool used[Tuple::n_fields] = {};
+
+    for (auto & item : items)
+    {
+        if (item.tuple.state () != Tuple::Valid)
+            continue;
+
+        for (auto f : Tuple::all_fields ())
+        {
+            if (! used[f] && ! skip_field (f) &&
+             item.tuple.get_value_type (f) != Tuple::Empty)
+                used[f] = true;
+        }
+    }
+
+    for (auto f : Tuple::all_fields ())
+    {
+        if (used[f])
+            fields.append (f);
+    }
+
+    StringTable strings;
+    uint32_t title_id = strings.add (String (title));
+
+    Index<uint32_t> columns;
+    for (auto f : fields)
+    {
+        columns.append (TO_LE32 (strings.add (String (Tuple::field_get_name (f)))));
+        columns.append (TO_LE32 ((uint32_t) Tuple::field_get_type (f)));
+    }
+
+    int n_columns = fields.len ();
+    int mask_words = (n_columns + 31) / 32;
+    int entry_words = 2 + mask_words + n_columns;
+
+    Index<uint32_t> entries;
+    entries.insert (0, entry_words * items.len ());
+    uint32_t * entry = entries.begin ();
+
+    for (auto & item : items)
+    {
+        const Tuple & tuple = item.tuple;
+        uint32_t * mask = entry + 2;
+        uint32_t * values = mask + mask_words;
+
+        memset (entry, 0, 4 * entry_words);
+        entry[0] = TO_LE32 (strings.add (item.filename));
+
+        switch (tuple.state ())
+        {
+        case Tuple::Valid:
+            entry[1] = TO_LE32 ((uint32_t) STATE_VALID);
+
+            for (int c = 0; c < n_columns; c ++)
+            {
+                Tuple::Field f = fields[c];
+                Tuple::ValueType type = tuple.get_value_type (f);
+
+                if (type == Tuple::String)
+                    values[c] = TO_LE32 (strings.add (tuple.get_str (f)));
+                else if (type == Tuple::Int)
+                    values[c] = TO_LE32 ((uint32_t) tuple.get_int (f));
+                else
+                    continue;
+
+                mask[c / 32] |= 1u << (c % 32);
+            }
+
+            for (int w = 0; w < mask_words; w ++)
+                mask[w] = TO_LE32 (mask[w]);
+
+            break;
+
+        case Tuple::Failed:
+            entry[1] = TO_LE32 ((uint32_t) STATE_FAILED);
+            break;
+
+        default:
+            entry[1] = TO_LE32 ((uint32_t) STATE_INITIAL);
+            break;
+        }
+
+        entry += entry_words;
+    }
+
+    AudplbHeader header;
+    memcpy (header.magic, AUDPLB_MAGIC, 8);
+    header.version = TO_LE32 ((uint32_t) AUDPLB_VERSION);
+    header.n_strings = TO_LE32 ((uint32_t) strings.offsets ().len ());
+    header.strings_size = TO_LE32 ((uint32_t) strings.data ().len ());
+    header.n_columns = TO_LE32 ((uint32_t) n_columns);
+    header.n_entries = TO_LE32 ((uint32_t) items.len ());
+    header.title = TO_LE32 (title_id);
+
+    return file.fwrite (& header, 1, sizeof header) == sizeof header &&
+     write_all (file, strings.offsets ()) && write_all (file, strings.data ()) &&
+     write_all (file, columns) && write_all (file, entries);
+}
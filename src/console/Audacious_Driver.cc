@@ -253,6 +253,9 @@ bool ConsolePlugin::play(const char *filename, VFSFile &file)
         set_stream_bitrate(fh.m_emu->voice_count() * 1000);
     }
 
+    // seeking resumes from the nearest saved state (SPC, NSF and VGM)
+    fh.m_emu->set_checkpoint_interval(audcfg.seek_checkpoints * 1000);
+
     // start track
     if (log_err(fh.m_emu->start_track(fh.m_track)))
         return false;
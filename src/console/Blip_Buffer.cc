@@ -120,6 +120,11 @@ Blip_Buffer::blargg_err_t Blip_Buffer::set_sample_rate( long new_rate, int msec
 	return 0; // success
 }
 
+long Blip_Buffer::sample_data_size() const
+{
+	return buffer_ ? (buffer_size_ + blip_buffer_extra_) * (long) sizeof (buf_t_) : 0;
+}
+
 blip_resampled_time_t Blip_Buffer::clock_rate_factor( long rate ) const
 {
 	double ratio = (double) sample_rate_ / rate;
@@ -83,6 +83,10 @@ public:
 	// Mix 'count' samples from 'buf' into buffer.
 	void mix_samples( blip_sample_t const* buf, long count );
 
+	// Sample memory, for saving and restoring buffer state verbatim
+	void* sample_data()             { return buffer_; }
+	long sample_data_size() const;
+
 	// not documented yet
 	void set_modified() { modified_ = 1; }
 	int clear_modified() { int b = modified_; modified_ = 0; return b; }
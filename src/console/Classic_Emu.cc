@@ -88,6 +88,11 @@ blargg_err_t Classic_Emu::setup_buffer( long rate )
 	return 0;
 }
 
+bool Classic_Emu::buffer_checkpoint_blocks( checkpoint_list_t& out )
+{
+	return buf && buf->state_blocks( out );
+}
+
 blargg_err_t Classic_Emu::start_track_( int track )
 {
 	RETURN_ERR( Music_Emu::start_track_( track ) );
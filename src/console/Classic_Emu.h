@@ -21,6 +21,9 @@ protected:
 	long clock_rate() const { return clock_rate_; }
 	void change_clock_rate( long ); // experimental
 
+	// Add sound buffer's state to checkpoint blocks. False if buffer doesn't support it.
+	bool buffer_checkpoint_blocks( checkpoint_list_t& out );
+
 	// Overridable
 	virtual void set_voice( int index, Blip_Buffer* center,
 			Blip_Buffer* left, Blip_Buffer* right ) = 0;
@@ -47,6 +47,14 @@ void Dual_Resampler::resize( int pairs )
 	}
 }
 
+void Dual_Resampler::state_blocks( blargg_state_list_t& out )
+{
+	blargg_add_state( out, sample_buf.begin(), sample_buf.size() * (long) sizeof (dsample_t) );
+	blargg_add_state( out, &buf_pos, sizeof buf_pos );
+	blargg_add_state( out, &resampler, sizeof resampler );
+	blargg_add_state( out, resampler.input_buffer(), resampler.input_buffer_size() );
+}
+
 void Dual_Resampler::play_frame_( Blip_Buffer& blip_buf, dsample_t* out )
 {
 	long pair_count = sample_buf_size >> 1;
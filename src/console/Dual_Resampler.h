@@ -21,6 +21,9 @@ public:
 
 	void dual_play( long count, dsample_t* out, Blip_Buffer& );
 
+	// Add blocks holding resampler state to 'out'
+	void state_blocks( blargg_state_list_t& out );
+
 protected:
 	virtual int play_frame( blip_time_t, int pcm_count, dsample_t* pcm_out ) = 0;
 private:
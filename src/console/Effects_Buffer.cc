@@ -241,6 +241,23 @@ void Effects_Buffer::end_frame( blip_time_t clock_count )
 	effects_enabled = config_.effects_enabled;
 }
 
+bool Effects_Buffer::state_blocks( blargg_state_list_t& out )
+{
+	// configuration is left alone, since the user might have changed it since
+	for ( int i = 0; i < buf_count; i++ )
+	{
+		blargg_add_state( out, &bufs [i], sizeof bufs [i] );
+		blargg_add_state( out, bufs [i].sample_data(), bufs [i].sample_data_size() );
+	}
+	blargg_add_state( out, &stereo_remain, sizeof stereo_remain );
+	blargg_add_state( out, &effect_remain, sizeof effect_remain );
+	blargg_add_state( out, reverb_buf.begin(), reverb_buf.size() * (long) sizeof (blip_sample_t) );
+	blargg_add_state( out, echo_buf.begin(), echo_buf.size() * (long) sizeof (blip_sample_t) );
+	blargg_add_state( out, &reverb_pos, sizeof reverb_pos );
+	blargg_add_state( out, &echo_pos, sizeof echo_pos );
+	return true;
+}
+
 long Effects_Buffer::samples_avail() const
 {
 	return bufs [0].samples_avail() * 2;
@@ -45,6 +45,10 @@ public:
 	// Skip 'count' input samples. Returns number of samples actually skipped.
 	int skip_input( long count );
 
+	// Input buffer memory, for saving and restoring resampler state
+	void* input_buffer()             { return buf.begin(); }
+	long input_buffer_size() const   { return buf.size() * sizeof (sample_t); }
+
 // Output
 
 	// Number of extra input samples needed until 'count' output samples are available
@@ -55,6 +55,13 @@ blargg_err_t Mono_Buffer::set_sample_rate( long rate, int msec )
 	return Multi_Buffer::set_sample_rate( buf.sample_rate(), buf.length() );
 }
 
+bool Mono_Buffer::state_blocks( blargg_state_list_t& out )
+{
+	blargg_add_state( out, &buf, sizeof buf );
+	blargg_add_state( out, buf.sample_data(), buf.sample_data_size() );
+	return true;
+}
+
 // Stereo_Buffer
 
 Stereo_Buffer::Stereo_Buffer() : Multi_Buffer( 2 )
@@ -103,6 +110,18 @@ void Stereo_Buffer::end_frame( blip_time_t clock_count )
 	}
 }
 
+bool Stereo_Buffer::state_blocks( blargg_state_list_t& out )
+{
+	for ( int i = 0; i < buf_count; i++ )
+	{
+		blargg_add_state( out, &bufs [i], sizeof bufs [i] );
+		blargg_add_state( out, bufs [i].sample_data(), bufs [i].sample_data_size() );
+	}
+	blargg_add_state( out, &stereo_added, sizeof stereo_added );
+	blargg_add_state( out, &was_stereo, sizeof was_stereo );
+	return true;
+}
+
 long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
 {
 	require( !(count & 1) ); // count must be even
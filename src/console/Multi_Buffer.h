@@ -51,6 +51,10 @@ public:
 	virtual long read_samples( blip_sample_t*, long ) = 0;
 	virtual long samples_avail() const = 0;
 
+	// Add blocks holding samples and other state that changes during playback to
+	// 'out'. False if not supported.
+	virtual bool state_blocks( blargg_state_list_t& out ) { return false; }
+
 protected:
 	void channels_changed() { channels_changed_count_++; }
 private:
@@ -83,6 +87,7 @@ public:
 	long read_samples( blip_sample_t* p, long s ) { return buf.read_samples( p, s ); }
 	channel_t channel( int, int ) { return chan; }
 	void end_frame( blip_time_t t ) { buf.end_frame( t ); }
+	bool state_blocks( blargg_state_list_t& );
 };
 
 // Uses three buffers (one for center) and outputs stereo sample pairs.
@@ -103,6 +108,7 @@ public:
 	void clear();
 	channel_t channel( int, int ) { return chan; }
 	void end_frame( blip_time_t );
+	bool state_blocks( blargg_state_list_t& );
 
 	long samples_avail() const { return bufs [0].samples_avail() * 2; }
 	long read_samples( blip_sample_t*, long );
@@ -38,6 +38,7 @@ void Music_Emu::clear_track_vars()
 	silence_time     = 0;
 	silence_count    = 0;
 	buf_remain       = 0;
+	clear_checkpoints();
 	warning(); // clear warning
 }
 
@@ -51,6 +52,8 @@ void Music_Emu::unload()
 Music_Emu::Music_Emu()
 {
 	effects_buffer = 0;
+	checkpoints    = 0;
+	checkpoint_msec = 0;
 
 	sample_rate_ = 0;
 	mute_mask_   = 0;
@@ -72,7 +75,11 @@ Music_Emu::Music_Emu()
 	Music_Emu::unload(); // non-virtual
 }
 
-Music_Emu::~Music_Emu() { delete effects_buffer; }
+Music_Emu::~Music_Emu()
+{
+	clear_checkpoints();
+	delete effects_buffer;
+}
 
 blargg_err_t Music_Emu::set_sample_rate( long rate )
 {
@@ -156,6 +163,13 @@ blargg_err_t Music_Emu::start_track( int track )
 		silence_time  = 0;
 		silence_count = 0;
 	}
+
+	// first checkpoint at beginning, so every seek can start from one
+	if ( checkpoint_msec > 0 && !track_ended_ )
+	{
+		checkpoint_period = msec_to_samples( checkpoint_msec );
+		save_checkpoint();
+	}
 	return track_ended() ? warning() : 0;
 }
 
@@ -187,7 +201,7 @@ long Music_Emu::tell() const
 blargg_err_t Music_Emu::seek( long msec )
 {
 	blargg_long time = msec_to_samples( msec );
-	if ( time < out_time )
+	if ( !load_checkpoint( time ) && time < out_time )
 		RETURN_ERR( start_track( current_track_ ) );
 	return skip( time - out_time );
 }
@@ -195,6 +209,23 @@ blargg_err_t Music_Emu::seek( long msec )
 blargg_err_t Music_Emu::skip( long count )
 {
 	require( current_track() >= 0 ); // start_track() must have been called already
+
+	// save checkpoints passed along the way
+	while ( checkpoint_period && count > next_checkpoint - out_time && !track_ended_ )
+	{
+		long n = next_checkpoint - out_time;
+		count -= n;
+		skip_samples( n );
+		if ( !track_ended_ )
+			save_checkpoint();
+	}
+
+	skip_samples( count );
+	return 0;
+}
+
+void Music_Emu::skip_samples( long count )
+{
 	out_time += count;
 
 	// remove from silence and buf first
@@ -216,8 +247,6 @@ blargg_err_t Music_Emu::skip( long count )
 
 	if ( !(silence_count | buf_remain) ) // caught up to emulator, so update track ended
 		track_ended_ |= emu_track_ended_;
-
-	return 0;
 }
 
 blargg_err_t Music_Emu::skip_( long count )
@@ -249,6 +278,145 @@ blargg_err_t Music_Emu::skip_( long count )
 	return 0;
 }
 
+// Checkpoints
+
+struct Music_Emu::checkpoint_t
+{
+	checkpoint_t* next;
+	blargg_long time; // out_time when saved
+	long size;        // total size of blocks, which depends on settings when saved
+	// contents of checkpoint blocks follow
+};
+
+int const track_checkpoint_blocks = 8;
+
+// False if emulator doesn't support checkpoints, or has more blocks than fit
+bool Music_Emu::get_checkpoint_blocks( checkpoint_list_t& out )
+{
+	if ( !checkpoint_blocks_( out ) )
+		return false;
+
+	// track position and silence detection state
+	blargg_add_state( out, &out_time, sizeof out_time );
+	blargg_add_state( out, &emu_time, sizeof emu_time );
+	blargg_add_state( out, &emu_track_ended_, sizeof emu_track_ended_ );
+	blargg_add_state( out, (void*) &track_ended_, sizeof track_ended_ );
+	blargg_add_state( out, &silence_time, sizeof silence_time );
+	blargg_add_state( out, &silence_count, sizeof silence_count );
+	blargg_add_state( out, &buf_remain, sizeof buf_remain );
+	blargg_add_state( out, buf.begin(), (long) (buf_size * sizeof (sample_t)) );
+
+	assert( !out.overflow ); // raise max_checkpoint_blocks
+	return !out.overflow;
+}
+
+void Music_Emu::save_checkpoint()
+{
+	checkpoint_block_t blocks [max_checkpoint_blocks + track_checkpoint_blocks];
+	checkpoint_list_t list( blocks, max_checkpoint_blocks + track_checkpoint_blocks );
+	bool supported = get_checkpoint_blocks( list );
+	int count = list.count;
+
+	long size = 0;
+	for ( int i = 0; i < count; i++ )
+		size += blocks [i].size;
+
+	checkpoint_t* cp = 0;
+	if ( supported )
+		cp = (checkpoint_t*) malloc( sizeof (checkpoint_t) + size );
+	if ( !cp )
+	{
+		// not supported by emulator, or out of memory
+		checkpoint_period = 0;
+		return;
+	}
+
+	byte* out = (byte*) (cp + 1);
+	for ( int i = 0; i < count; i++ )
+	{
+		memcpy( out, blocks [i].begin, blocks [i].size );
+		out += blocks [i].size;
+	}
+
+	cp->next = 0;
+	cp->time = out_time;
+	cp->size = size;
+	if ( last_checkpoint )
+		last_checkpoint->next = cp;
+	else
+		checkpoints = cp;
+	last_checkpoint = cp;
+
+	if ( ++checkpoint_count >= max_checkpoints )
+	{
+		// drop every other checkpoint and space future ones twice as far apart
+		for ( checkpoint_t* c = checkpoints; c; c = c->next )
+		{
+			last_checkpoint = c;
+			checkpoint_t* dropped = c->next;
+			if ( !dropped )
+				break;
+			c->next = dropped->next;
+			free( dropped );
+			checkpoint_count--;
+		}
+		checkpoint_period *= 2;
+	}
+
+	next_checkpoint = last_checkpoint->time + checkpoint_period;
+}
+
+bool Music_Emu::load_checkpoint( blargg_long time )
+{
+	// latest checkpoint at or before time
+	checkpoint_t* cp = 0;
+	for ( checkpoint_t* c = checkpoints; c && c->time <= time; c = c->next )
+		cp = c;
+
+	// not worth it if seeking forward past it
+	if ( !cp || (time >= out_time && cp->time <= out_time) )
+		return false;
+
+	checkpoint_block_t blocks [max_checkpoint_blocks + track_checkpoint_blocks];
+	checkpoint_list_t list( blocks, max_checkpoint_blocks + track_checkpoint_blocks );
+	if ( !get_checkpoint_blocks( list ) )
+		return false;
+	int count = list.count;
+
+	// sample rate or buffer configuration changed since then
+	long size = 0;
+	for ( int i = 0; i < count; i++ )
+		size += blocks [i].size;
+	if ( size != cp->size )
+		return false;
+
+	byte const* in = (byte const*) (cp + 1);
+	for ( int i = 0; i < count; i++ )
+	{
+		memcpy( blocks [i].begin, in, blocks [i].size );
+		in += blocks [i].size;
+	}
+
+	// settings might have changed since checkpoint was saved
+	set_tempo_( tempo_ );
+	remute_voices();
+	return true;
+}
+
+void Music_Emu::clear_checkpoints()
+{
+	while ( checkpoints )
+	{
+		checkpoint_t* next = checkpoints->next;
+		free( checkpoints );
+		checkpoints = next;
+	}
+	last_checkpoint   = 0;
+	checkpoint_count  = 0;
+	checkpoint_period = 0;
+	next_checkpoint   = 0;
+}
+
 // Fading
 
 void Music_Emu::set_fade( long start_msec, long length_msec )
@@ -395,6 +563,9 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 			handle_fade( out_count, out );
 	}
 	out_time += out_count;
+
+	if ( checkpoint_period && out_time >= next_checkpoint && !track_ended_ )
+		save_checkpoint();
 	return 0;
 }
 
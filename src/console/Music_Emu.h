@@ -57,6 +57,12 @@ public:
 	// Disable automatic end-of-track detection and skipping of silence at beginning
 	void ignore_silence( bool disable = true );
 
+	// Save emulator state every 'msec' milliseconds of the track, so that seek() can
+	// continue from the nearest earlier checkpoint rather than from the beginning.
+	// 0 disables checkpoints. Takes effect at next start_track(). Only supported by
+	// some emulators; on others this has no effect.
+	void set_checkpoint_interval( long msec );
+
 	// Info for current track
 	using Gme_File::track_info;
 	blargg_err_t track_info( track_info_t* out ) const;
@@ -122,6 +128,15 @@ protected:
 	virtual blargg_err_t start_track_( int ) = 0; // tempo is set before this
 	virtual blargg_err_t play_( long count, sample_t* out ) = 0;
 	virtual blargg_err_t skip_( long count );
+
+	// An emulator whose entire state is held in a fixed set of memory blocks can
+	// support checkpoints by adding those blocks to 'out' (at most
+	// max_checkpoint_blocks) and returning true. Blocks are saved and restored
+	// verbatim, so they must stay at the same address while a track is playing.
+	typedef blargg_state_block_t checkpoint_block_t;
+	typedef blargg_state_list_t checkpoint_list_t;
+	enum { max_checkpoint_blocks = 32 };
+	virtual bool checkpoint_blocks_( checkpoint_list_t& out ) { return false; }
 protected:
 	virtual void unload();
 	virtual void pre_load();
@@ -163,6 +178,21 @@ private:
 	blargg_vector<sample_t> buf;
 	void fill_buf();
 	void emu_play( long count, sample_t* out );
+	void skip_samples( long count );
+
+	// checkpoints
+	enum { max_checkpoints = 32 };
+	struct checkpoint_t;
+	checkpoint_t* checkpoints;     // sorted by time, earliest first
+	checkpoint_t* last_checkpoint;
+	int checkpoint_count;
+	long checkpoint_msec;
+	blargg_long checkpoint_period; // samples between checkpoints, 0 if disabled
+	blargg_long next_checkpoint;   // out_time when next checkpoint is due
+	bool get_checkpoint_blocks( checkpoint_list_t& out );
+	void save_checkpoint();
+	bool load_checkpoint( blargg_long time );
+	void clear_checkpoints();
 
 	Multi_Buffer* effects_buffer;
 	friend Music_Emu* gme_new_emu( gme_type_t, int );
@@ -199,6 +229,7 @@ inline void Music_Emu::enable_accuracy( bool b )    { enable_accuracy_( b ); }
 inline void Music_Emu::set_tempo_( double t )       { tempo_ = t; }
 inline void Music_Emu::remute_voices()              { mute_voices( mute_mask_ ); }
 inline void Music_Emu::ignore_silence( bool b )     { ignore_silence_ = b; }
+inline void Music_Emu::set_checkpoint_interval( long msec ) { checkpoint_msec = msec; }
 inline blargg_err_t Music_Emu::start_track_( int )  { return 0; }
 
 inline void Music_Emu::set_voice_names( const char* const* names )
@@ -557,3 +557,24 @@ blargg_err_t Nsf_Emu::run_clocks( blip_time_t& duration, int )
 
 	return 0;
 }
+
+bool Nsf_Emu::checkpoint_blocks_( checkpoint_list_t& out )
+{
+	// ROM and header don't change during playback, and CPU's code map only
+	// points into ROM
+	if ( !buffer_checkpoint_blocks( out ) )
+		return false;
+	blargg_add_state( out, (cpu*) this, sizeof (cpu) );
+	blargg_add_state( out, &saved_state, sizeof saved_state );
+	blargg_add_state( out, &next_play, sizeof next_play );
+	blargg_add_state( out, &play_extra, sizeof play_extra );
+	blargg_add_state( out, &play_ready, sizeof play_ready );
+	blargg_add_state( out, &apu, sizeof apu );
+	blargg_add_state( out, sram, sizeof sram );
+	#if !NSF_EMU_APU_ONLY
+		if ( namco ) blargg_add_state( out, namco, sizeof *namco );
+		if ( vrc6  ) blargg_add_state( out, vrc6,  sizeof *vrc6 );
+		if ( fme7  ) blargg_add_state( out, fme7,  sizeof *fme7 );
+	#endif
+	return true;
+}
@@ -331,6 +331,17 @@ blargg_err_t Spc_Emu::skip_( long count )
 	return play_( resampler_latency, buf );
 }
 
+bool Spc_Emu::checkpoint_blocks_( checkpoint_list_t& out )
+{
+	// emulator state is entirely inside these, except for resampler input,
+	// which doesn't move once sample rate is set
+	blargg_add_state( out, &apu, sizeof apu );
+	blargg_add_state( out, &filter, sizeof filter );
+	blargg_add_state( out, &resampler, sizeof resampler );
+	blargg_add_state( out, resampler.input_buffer(), resampler.input_buffer_size() );
+	return true;
+}
+
 blargg_err_t Spc_Emu::play_( long count, sample_t* out )
 {
 	if ( sample_rate() == native_sample_rate )
@@ -67,6 +67,7 @@ protected:
 	void mute_voices_( int );
 	void set_tempo_( double );
 	void enable_accuracy_( bool );
+	bool checkpoint_blocks_( checkpoint_list_t& );
 private:
 	byte const* file_data;
 	long        file_size;
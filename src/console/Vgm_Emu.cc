@@ -414,3 +414,30 @@ blargg_err_t Vgm_Emu::play_( long count, sample_t* out )
 	Dual_Resampler::dual_play( count, out, blip_buf );
 	return 0;
 }
+
+bool Vgm_Emu::checkpoint_blocks_( checkpoint_list_t& out )
+{
+	// FM chips are mixed through blip_buf instead of the sound buffer
+	if ( !uses_fm && !buffer_checkpoint_blocks( out ) )
+		return false;
+	blargg_add_state( out, &vgm_time, sizeof vgm_time );
+	blargg_add_state( out, &pos, sizeof pos );
+	blargg_add_state( out, &pcm_data, sizeof pcm_data );
+	blargg_add_state( out, &pcm_pos, sizeof pcm_pos );
+	blargg_add_state( out, &dac_amp, sizeof dac_amp );
+	blargg_add_state( out, &dac_disabled, sizeof dac_disabled );
+	blargg_add_state( out, &psg, sizeof psg );
+	if ( uses_fm )
+	{
+		blargg_add_state( out, &fm_time_offset, sizeof fm_time_offset );
+		Dual_Resampler::state_blocks( out );
+		blargg_add_state( out, &blip_buf, sizeof blip_buf );
+		blargg_add_state( out, blip_buf.sample_data(), blip_buf.sample_data_size() );
+		blargg_add_state( out, &dac_synth, sizeof dac_synth );
+		blargg_add_state( out, &ym2612, sizeof ym2612 );
+		ym2612.state_blocks( out );
+		blargg_add_state( out, &ym2413, sizeof ym2413 );
+		ym2413.state_blocks( out );
+	}
+	return true;
+}
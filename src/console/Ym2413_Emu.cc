@@ -2203,6 +2203,12 @@ void Ym2413_Emu::mute_voices( int mask )
 	OPLL_setMask( opll, mask );
 }
 
+void Ym2413_Emu::state_blocks( blargg_state_list_t& out )
+{
+	if ( opll )
+		blargg_add_state( out, opll, sizeof *opll );
+}
+
 void Ym2413_Emu::run( int pair_count, sample_t* out )
 {
 	while ( pair_count-- )
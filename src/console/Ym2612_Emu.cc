@@ -961,6 +961,17 @@ void Ym2612_Emu::write1( int addr, int data )
 
 void Ym2612_Emu::mute_voices( int mask ) { impl->mute_mask = mask; }
 
+void Ym2612_Emu::state_blocks( blargg_state_list_t& out )
+{
+	// other tables only change in set_rate()
+	if ( impl )
+	{
+		blargg_add_state( out, &impl->YM2612, sizeof impl->YM2612 );
+		blargg_add_state( out, &impl->g.LFOcnt, sizeof impl->g.LFOcnt );
+		blargg_add_state( out, &impl->g.LFOinc, sizeof impl->g.LFOinc );
+	}
+}
+
 static void update_envelope_( slot_t* sl )
 {
 	switch ( sl->Ecurp )
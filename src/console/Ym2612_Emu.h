@@ -4,6 +4,8 @@
 #ifndef YM2612_EMU_H
 #define YM2612_EMU_H
 
+#include "blargg_common.h"
+
 struct Ym2612_Impl;
 
 class Ym2612_Emu  {
@@ -33,6 +35,9 @@ public:
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+
+	// Add blocks holding chip state to 'out'
+	void state_blocks( blargg_state_list_t& out );
 };
 
 #endif
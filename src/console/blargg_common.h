@@ -55,6 +55,37 @@ public:
 	}
 };
 
+// blargg_state_block_t - memory holding part of an emulator's state, which can be
+// saved and later restored verbatim into the same object
+struct blargg_state_block_t {
+	void* begin;
+	long size;
+};
+
+// blargg_state_list_t - fixed-capacity list of state blocks. Adding to a full list
+// sets 'overflow' rather than writing past the end, and such a list must not be used.
+struct blargg_state_list_t {
+	blargg_state_block_t* blocks;
+	int capacity;
+	int count;
+	bool overflow;
+	
+	blargg_state_list_t( blargg_state_block_t* b, int n ) :
+			blocks( b ), capacity( n ), count( 0 ), overflow( false ) { }
+};
+
+inline void blargg_add_state( blargg_state_list_t& out, void* begin, long size )
+{
+	if ( out.count >= out.capacity )
+	{
+		out.overflow = true;
+		return;
+	}
+	out.blocks [out.count].begin = begin;
+	out.blocks [out.count].size  = size;
+	out.count++;
+}
+
 // BLARGG_4CHAR('a','b','c','d') = 'abcd' (four character integer constant)
 #define BLARGG_4CHAR( a, b, c, d ) \
 	((a&0xFF)*0x1000000L + (b&0xFF)*0x10000L + (c&0xFF)*0x100L + (d&0xFF))
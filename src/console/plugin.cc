@@ -50,7 +50,10 @@ const PreferencesWidget ConsolePlugin::widgets[] = {
     WidgetCheck (N_("Ignore length from SPC tags"),
         WidgetBool (audcfg.ignore_spc_length)),
     WidgetCheck (N_("Increase reverb"),
-        WidgetBool (audcfg.inc_spc_reverb))
+        WidgetBool (audcfg.inc_spc_reverb)),
+    WidgetSpin (N_("Save seek checkpoints every:"),
+        WidgetInt (audcfg.seek_checkpoints),
+        {0, 600, 1, N_("seconds")})
 };
 
 const PluginPreferences ConsolePlugin::prefs = {{widgets}};
@@ -18,22 +18,18 @@
  */
 
 #include <string.h>
+#include <time.h>
 #include <pthread.h>
 
-#ifdef HAVE_LIBCUE2
-#include <libcue.h>
-#else
-extern "C" {
-#include <libcue/libcue.h>
-}
-#endif
-
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
+#include <libaudcore/multihash.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/probe.h>
 #include <libaudcore/runtime.h>
 
+#include "cuesheet.h"
+
 static const char * const cue_exts[] = {"cue"};
 
 class CueLoader : public PlaylistPlugin
@@ -42,12 +38,94 @@ public:
     static constexpr PluginInfo info = {N_("Cue Sheet Plugin"), PACKAGE};
     constexpr CueLoader () : PlaylistPlugin (info, cue_exts, false) {}
 
+    void cleanup ();
+
     bool load (const char * filename, VFSFile & file, String & title,
      Index<PlaylistAddItem> & items);
 };
 
 EXPORT CueLoader aud_plugin_instance;
 
+/* The decoder and tags of the audio files referenced by cue sheets, so
+ * that a file shared by several cue sheets is probed only once.  Entries
+ * expire after a minute, so that changes to the file are picked up. */
+struct ProbeResult
+{
+    PluginHandle * decoder;
+    Tuple tuple;
+    time_t stamp;
+};
+
+#define PROBE_CACHE_TIME 60
+#define PROBE_CACHE_SIZE 256
+
+static pthread_mutex_t probe_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SimpleHash<String, ProbeResult> probe_cache;
+
+void CueLoader::cleanup ()
+{
+    pthread_mutex_lock (& probe_mutex);
+    probe_cache.clear ();
+    pthread_mutex_unlock (& probe_mutex);
+}
+
+/* assumes probe_mutex locked */
+static void probe_cache_expire (time_t now)
+{
+    Index<String> expired;
+
+    probe_cache.iterate ([&] (const String & filename, ProbeResult & result) {
+        if (now - result.stamp >= PROBE_CACHE_TIME)
+            expired.append (filename);
+    });
+
+    for (const String & filename : expired)
+        probe_cache.remove (filename);
+
+    if (probe_cache.n_items () >= PROBE_CACHE_SIZE)
+        probe_cache.clear ();
+}
+
+/* the probe itself is done without the lock held, so that cue sheets
+ * referencing different files are loaded in parallel */
+static PluginHandle * probe_file (const String & filename, Tuple & tuple)
+{
+    time_t now = time (nullptr);
+
+    pthread_mutex_lock (& probe_mutex);
+
+    ProbeResult * cached = probe_cache.lookup (filename);
+
+    if (cached && now - cached->stamp < PROBE_CACHE_TIME)
+    {
+        PluginHandle * decoder = cached->decoder;
+        tuple = cached->tuple.ref ();
+        pthread_mutex_unlock (& probe_mutex);
+        return decoder;
+    }
+
+    pthread_mutex_unlock (& probe_mutex);
+
+    VFSFile file;
+    PluginHandle * decoder = aud_file_find_decoder (filename, false, file);
+
+    if (! decoder || ! aud_file_read_tag (filename, decoder, file, tuple))
+    {
+        tuple = Tuple ();
+        return decoder;
+    }
+
+    pthread_mutex_lock (& probe_mutex);
+
+    if (probe_cache.n_items () >= PROBE_CACHE_SIZE)
+        probe_cache_expire (now);
+
+    probe_cache.add (filename, {decoder, tuple.ref (), now});
+
+    pthread_mutex_unlock (& probe_mutex);
+    return decoder;
+}
+
 static bool is_year (const char * s)
 {
     auto is_digit = [] (char c)
@@ -60,27 +138,20 @@ static bool is_year (const char * s)
 bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
-    // XXX: cue_parse_string crashes if called concurrently
-    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-
     Index<char> buffer = file.read_all ();
     if (! buffer.len ())
         return false;
 
     buffer.append (0);  /* null-terminate */
 
-    pthread_mutex_lock (& mutex);
-    Cd * cd = cue_parse_string (buffer.begin ());
-    pthread_mutex_unlock (& mutex);
-
-    int tracks = cd ? cd_get_ntrack (cd) : 0;
-    if (tracks < 1)
+    CueSheet cd;
+    if (! cuesheet_parse (buffer.begin (), cd))
         return false;
 
-    Track * cur = cd_get_track (cd, 1);
-    const char * cur_name = cur ? track_get_filename (cur) : nullptr;
+    int tracks = cd.tracks.len ();
+    const CueTrack * cur = & cd.tracks[0];
 
-    if (! cur_name)
+    if (! cur->filename)
         return false;
 
     bool same_file = false;
@@ -92,61 +163,46 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
     {
         if (! same_file)
         {
-            filename = String (uri_construct (cur_name, cue_filename));
+            filename = String (uri_construct (cur->filename, cue_filename));
             decoder = nullptr;
             base_tuple = Tuple ();
 
-            VFSFile file;
-
             if (filename)
-                decoder = aud_file_find_decoder (filename, false, file);
+                decoder = probe_file (filename, base_tuple);
             else
                 AUDWARN ("Unable to construct URI for track '%s' in cuesheet '%s'\n",
-                 cur_name, cue_filename);
+                 (const char *) cur->filename, cue_filename);
 
-            if (decoder && aud_file_read_tag (filename, decoder, file, base_tuple))
+            if (base_tuple.valid ())
             {
-                Cdtext * cdtext = cd_get_cdtext (cd);
-
-                if (cdtext)
+                if (cd.performer)
+                    base_tuple.set_str (Tuple::AlbumArtist, cd.performer);
+                if (cd.title)
+                    base_tuple.set_str (Tuple::Album, cd.title);
+                if (cd.genre)
+                    base_tuple.set_str (Tuple::Genre, cd.genre);
+                if (cd.composer)
+                    base_tuple.set_str (Tuple::Composer, cd.composer);
+
+                if (cd.date)
                 {
-                    const char * s;
-                    if ((s = cdtext_get (PTI_PERFORMER, cdtext)))
-                        base_tuple.set_str (Tuple::AlbumArtist, s);
-                    if ((s = cdtext_get (PTI_TITLE, cdtext)))
-                        base_tuple.set_str (Tuple::Album, s);
-                    if ((s = cdtext_get (PTI_GENRE, cdtext)))
-                        base_tuple.set_str (Tuple::Genre, s);
-                    if ((s = cdtext_get (PTI_COMPOSER, cdtext)))
-                        base_tuple.set_str (Tuple::Composer, s);
+                    if (is_year (cd.date))
+                        base_tuple.set_int (Tuple::Year, str_to_int (cd.date));
+                    else
+                        base_tuple.set_str (Tuple::Date, cd.date);
                 }
 
-                Rem * rem = cd_get_rem (cd);
-
-                if (rem)
-                {
-                    const char * s;
-
-                    if ((s = rem_get (REM_DATE, rem)))
-                    {
-                        if (is_year (s))
-                            base_tuple.set_int (Tuple::Year, str_to_int (s));
-                        else
-                            base_tuple.set_str (Tuple::Date, s);
-                    }
-
-                    if ((s = rem_get (REM_REPLAYGAIN_ALBUM_GAIN, rem)))
-                        base_tuple.set_gain (Tuple::AlbumGain, Tuple::GainDivisor, s);
-                    if ((s = rem_get (REM_REPLAYGAIN_ALBUM_PEAK, rem)))
-                        base_tuple.set_gain (Tuple::AlbumPeak, Tuple::PeakDivisor, s);
-                }
+                if (cd.album_gain)
+                    base_tuple.set_gain (Tuple::AlbumGain, Tuple::GainDivisor, cd.album_gain);
+                if (cd.album_peak)
+                    base_tuple.set_gain (Tuple::AlbumPeak, Tuple::PeakDivisor, cd.album_peak);
             }
         }
 
-        Track * next = (track + 1 <= tracks) ? cd_get_track (cd, track + 1) : nullptr;
-        const char * next_name = next ? track_get_filename (next) : nullptr;
+        const CueTrack * next = (track + 1 <= tracks) ? & cd.tracks[track] : nullptr;
+        const char * next_name = next ? (const char *) next->filename : nullptr;
 
-        same_file = (next_name && ! strcmp (next_name, cur_name));
+        same_file = (next_name && next->filename == cur->filename);
 
         if (base_tuple.valid ())
         {
@@ -156,12 +212,12 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
             tuple.set_int (Tuple::Track, track);
             tuple.set_str (Tuple::AudioFile, filename);
 
-            int begin = (int64_t) track_get_start (cur) * 1000 / 75;
+            int begin = (int64_t) cur->start * 1000 / 75;
             tuple.set_int (Tuple::StartTime, begin);
 
             if (same_file)
             {
-                int end = (int64_t) track_get_start (next) * 1000 / 75;
+                int end = (int64_t) next->start * 1000 / 75;
                 tuple.set_int (Tuple::EndTime, end);
                 tuple.set_int (Tuple::Length, end - begin);
             }
@@ -172,29 +228,17 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
                     tuple.set_int (Tuple::Length, length - begin);
             }
 
-            Cdtext * cdtext = track_get_cdtext (cur);
+            if (cur->performer)
+                tuple.set_str (Tuple::Artist, cur->performer);
+            if (cur->title)
+                tuple.set_str (Tuple::Title, cur->title);
+            if (cur->genre)
+                tuple.set_str (Tuple::Genre, cur->genre);
 
-            if (cdtext)
-            {
-                const char * s;
-                if ((s = cdtext_get (PTI_PERFORMER, cdtext)))
-                    tuple.set_str (Tuple::Artist, s);
-                if ((s = cdtext_get (PTI_TITLE, cdtext)))
-                    tuple.set_str (Tuple::Title, s);
-                if ((s = cdtext_get (PTI_GENRE, cdtext)))
-                    tuple.set_str (Tuple::Genre, s);
-            }
-
-            Rem * rem = track_get_rem (cur);
-
-            if (rem)
-            {
-                const char * s;
-                if ((s = rem_get (REM_REPLAYGAIN_TRACK_GAIN, rem)))
-                    tuple.set_gain (Tuple::TrackGain, Tuple::GainDivisor, s);
-                if ((s = rem_get (REM_REPLAYGAIN_TRACK_PEAK, rem)))
-                    tuple.set_gain (Tuple::TrackPeak, Tuple::PeakDivisor, s);
-            }
+            if (cur->track_gain)
+                tuple.set_gain (Tuple::TrackGain, Tuple::GainDivisor, cur->track_gain);
+            if (cur->track_peak)
+                tuple.set_gain (Tuple::TrackPeak, Tuple::PeakDivisor, cur->track_peak);
 
             items.append (String (tfilename), std::move (tuple), decoder);
         }
@@ -203,7 +247,6 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
             break;
 
         cur = next;
-        cur_name = next_name;
     }
 
     return true;
@@ -0,0 +1,212 @@
+/*
+ * Cue sheet parser for Audacious
+ * Copyright 2026 Audacious development team
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "cuesheet.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libaudcore/audstrings.h>
+
+static void skip_space (const char * & p)
+{
+    while (* p == ' ' || * p == '\t')
+        p ++;
+}
+
+/* reads one word, or a string in double quotes */
+static StringBuf read_word (const char * & p)
+{
+    skip_space (p);
+
+    if (* p == '"')
+    {
+        const char * end = strchr (p + 1, '"');
+        if (! end)
+            end = p + strlen (p);
+
+        StringBuf word = str_copy (p + 1, end - (p + 1));
+        p = * end ? end + 1 : end;
+        return word;
+    }
+
+    const char * start = p;
+    while (* p && * p != ' ' && * p != '\t')
+        p ++;
+
+    return str_copy (start, p - start);
+}
+
+/* reads the rest of the line: a string in double quotes, or the words as
+ * they are (some programs don't quote values containing spaces) */
+static String read_value (const char * p)
+{
+    skip_space (p);
+
+    if (* p == '"')
+        return String (read_word (p));
+
+    int len = strlen (p);
+    while (len > 0 && (p[len - 1] == ' ' || p[len - 1] == '\t'))
+        len --;
+
+    return len ? String (str_copy (p, len)) : String ();
+}
+
+/* FILE "name" TYPE -- an unquoted name may contain spaces, so the type is
+ * taken from the end of the line */
+static String read_filename (const char * p)
+{
+    skip_space (p);
+
+    if (* p == '"')
+        return String (read_word (p));
+
+    const char * end = p + strlen (p);
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+        end --;
+
+    const char * space = end;
+    while (space > p && space[-1] != ' ' && space[-1] != '\t')
+        space --;
+
+    if (space > p)
+    {
+        end = space;
+        while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+            end --;
+    }
+
+    return (end > p) ? String (str_copy (p, end - p)) : String ();
+}
+
+/* mm:ss:ff */
+static int read_time (const char * p)
+{
+    char * end;
+    int min = strtol (p, & end, 10);
+    int sec = (* end == ':') ? strtol (end + 1, & end, 10) : 0;
+    int frames = (* end == ':') ? strtol (end + 1, & end, 10) : 0;
+
+    return (min * 60 + sec) * 75 + frames;
+}
+
+static char * split_line (char * line)
+{
+    char * feed = strpbrk (line, "\r\n");
+    if (! feed)
+        return nullptr;
+
+    char * next = feed + 1;
+    if (feed[0] == '\r' && feed[1] == '\n')
+        next ++;
+
+    feed[0] = 0;
+    return next;
+}
+
+bool cuesheet_parse (char * text, CueSheet & sheet)
+{
+    String filename;
+    CueTrack * track = nullptr;
+    int index0 = -1, index1 = -1;
+
+    auto finish_track = [&] () {
+        if (track)
+            track->start = (index1 >= 0) ? index1 : (index0 >= 0) ? index0 : 0;
+    };
+
+    if (! strncmp (text, "\xef\xbb\xbf", 3)) /* byte order mark */
+        text += 3;
+
+    for (char * line = text; line; )
+    {
+        char * next = split_line (line);
+        const char * p = line;
+
+        StringBuf command = read_word (p);
+
+        if (! strcmp_nocase (command, "REM"))
+        {
+            StringBuf key = read_word (p);
+
+            /* REM GENRE and REM COMPOSER are common stand-ins for the
+             * corresponding CD-Text fields */
+            if (! strcmp_nocase (key, "GENRE"))
+                (track ? track->genre : sheet.genre) = read_value (p);
+            else if (! strcmp_nocase (key, "COMPOSER") && ! track)
+                sheet.composer = read_value (p);
+            else if (! strcmp_nocase (key, "DATE") && ! track)
+                sheet.date = read_value (p);
+            else if (! strcmp_nocase (key, "REPLAYGAIN_ALBUM_GAIN"))
+                sheet.album_gain = read_value (p);
+            else if (! strcmp_nocase (key, "REPLAYGAIN_ALBUM_PEAK"))
+                sheet.album_peak = read_value (p);
+            else if (! strcmp_nocase (key, "REPLAYGAIN_TRACK_GAIN") && track)
+                track->track_gain = read_value (p);
+            else if (! strcmp_nocase (key, "REPLAYGAIN_TRACK_PEAK") && track)
+                track->track_peak = read_value (p);
+        }
+        else if (! strcmp_nocase (command, "FILE"))
+            filename = read_filename (p);
+        else if (! strcmp_nocase (command, "TRACK"))
+        {
+            finish_track ();
+
+            track = & sheet.tracks.append ();
+            track->filename = filename;
+            index0 = index1 = -1;
+        }
+        else if (! strcmp_nocase (command, "INDEX") && track)
+        {
+            int number = atoi (read_word (p));
+            skip_space (p);
+
+            if (number == 0)
+                index0 = read_time (p);
+            else if (number == 1)
+            {
+                /* in gap-appended sheets, a track's pregap sits at the end of
+                 * the previous file and the track itself starts at INDEX 01
+                 * of the next FILE, so that is the file it belongs to */
+                if (filename != track->filename)
+                {
+                    track->filename = filename;
+                    index0 = -1;
+                }
+
+                index1 = read_time (p);
+            }
+        }
+        else if (! strcmp_nocase (command, "PERFORMER"))
+            (track ? track->performer : sheet.performer) = read_value (p);
+        else if (! strcmp_nocase (command, "TITLE"))
+            (track ? track->title : sheet.title) = read_value (p);
+        else if (! strcmp_nocase (command, "GENRE"))
+            (track ? track->genre : sheet.genre) = read_value (p);
+        else if (! strcmp_nocase (command, "COMPOSER") && ! track)
+            sheet.composer = read_value (p);
+
+        line = next;
+    }
+
+    finish_track ();
+
+    return sheet.tracks.len () > 0;
+}
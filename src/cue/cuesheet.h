@@ -0,0 +1,51 @@
+/*
+ * Cue sheet parser for Audacious
+ * Copyright 2026 Audacious development team
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef CUESHEET_H
+#define CUESHEET_H
+
+#include <libaudcore/index.h>
+#include <libaudcore/objects.h>
+
+/* The parts of a cue sheet used by the plugin.  Times are in frames of
+ * 1/75 second. */
+
+struct CueTrack
+{
+    String filename;        /* FILE in effect for this track */
+    int start = 0;          /* INDEX 01, or INDEX 00 if there is none */
+
+    String performer, title, genre;
+    String track_gain, track_peak;
+};
+
+struct CueSheet
+{
+    String performer, title, genre, composer;
+    String date, album_gain, album_peak;
+
+    Index<CueTrack> tracks;
+};
+
+/* Parses the null-terminated text of a cue sheet, which is modified in the
+ * process.  Unlike libcue, this keeps no global state and may be called from
+ * several threads at once.  Returns false if no tracks were found. */
+bool cuesheet_parse (char * text, CueSheet & sheet);
+
+#endif // CUESHEET_H
@@ -22,12 +22,16 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include <utility>
+
 #include <gio/gio.h>
 
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/interface.h>
+#include <libaudcore/multihash.h>
 #include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
 #include <libaudcore/runtime.h>
 
 static const char gio_about[] =
@@ -36,13 +40,70 @@ static const char gio_about[] =
 
 static const char * const gio_schemes[] = {"ftp", "sftp", "smb", "mtp"};
 
+#define GIO_BATCH_SIZE      256     // files per directory enumeration request
+#define GIO_FOLDER_THREADS  4       // folders enumerated in parallel
+#define GIO_MAX_PREFETCH    64      // folders listed ahead of time
+#define GIO_CACHE_TTL       (10 * G_USEC_PER_SEC)
+
+#define GIO_FOLDER_ATTRS \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK "," \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_UNIX_MODE
+
+/* Attributes of the files seen by read_folder(), so that the test_file()
+ * and fsize() calls which usually follow need no round trip of their own */
+struct CachedInfo
+{
+    GFileType type;
+    bool is_symlink;
+    uint32_t mode;
+    int64_t size;
+    uint64_t mtime;
+    int64_t time;   // when the attributes were read
+};
+
+/* Contents of a folder listed ahead of time, in the expectation that the
+ * caller is adding a folder recursively and will ask for it shortly */
+struct FolderListing
+{
+    Index<String> files;
+    Index<String> subdirs;
+    String error;
+    bool done = false;
+    int64_t time = 0;
+};
+
+static GMutex cache_mutex;
+static GCond cache_cond;
+static SimpleHash<String, CachedInfo> info_cache;
+static SimpleHash<String, FolderListing> folder_cache;
+static GThreadPool * folder_pool;
+static bool folder_quit;
+static int64_t last_purge;
+
 class GIOTransport : public TransportPlugin
 {
 public:
-    static constexpr PluginInfo info = {N_("GIO Plugin"), PACKAGE, gio_about};
+    static const char * const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("GIO Plugin"),
+        PACKAGE,
+        gio_about,
+        & prefs
+    };
 
     constexpr GIOTransport () : TransportPlugin (info, gio_schemes) {}
 
+    bool init ();
+    void cleanup ();
+
     VFSImpl * fopen (const char * path, const char * mode, String & error);
     VFSFileTest test_file (const char * filename, VFSFileTest test, String & error);
     Index<String> read_folder (const char * filename, String & error);
@@ -50,6 +111,67 @@ public:
 
 EXPORT GIOTransport aud_plugin_instance;
 
+const char * const GIOTransport::defaults[] = {
+    "block_kb", "64",
+    nullptr
+};
+
+const PreferencesWidget GIOTransport::widgets[] = {
+    WidgetSpin (N_("Read-ahead block size:"),
+        WidgetInt ("gio", "block_kb"),
+        {4, 1024, 4, N_("KiB")})
+};
+
+const PluginPreferences GIOTransport::prefs = {{widgets}};
+
+bool GIOTransport::init ()
+{
+    aud_config_set_defaults ("gio", defaults);
+    return true;
+}
+
+void GIOTransport::cleanup ()
+{
+    if (folder_pool)
+    {
+        /* let the queued jobs run (and free their folder names), but
+         * without listing anything more */
+        g_mutex_lock (& cache_mutex);
+        folder_quit = true;
+        g_mutex_unlock (& cache_mutex);
+
+        g_thread_pool_free (folder_pool, false, true);
+        folder_pool = nullptr;
+        folder_quit = false;
+    }
+
+    info_cache.clear ();
+    folder_cache.clear ();
+}
+
+static bool lookup_cached_info (const char * filename, CachedInfo & info)
+{
+    g_mutex_lock (& cache_mutex);
+
+    CachedInfo * cached = info_cache.lookup (String (filename));
+    bool found = (cached && g_get_monotonic_time () - cached->time < GIO_CACHE_TTL);
+
+    if (found)
+        info = * cached;
+
+    g_mutex_unlock (& cache_mutex);
+    return found;
+}
+
+/* called when a file is opened for writing, which may create it or change
+ * its size */
+static void forget_cached_info (const char * filename)
+{
+    g_mutex_lock (& cache_mutex);
+    info_cache.remove (String (filename));
+    g_mutex_unlock (& cache_mutex);
+}
+
 class GIOFile : public VFSImpl
 {
 public:
@@ -75,6 +197,13 @@ protected:
     int fflush ();
 
 private:
+    /* State of the block being read ahead */
+    enum PrefetchState {
+        Idle,       /* nothing requested */
+        Pending,    /* requested, the worker thread owns the stream */
+        Ready       /* m_next holds the data (empty at end of file) */
+    };
+
     String m_filename;
     GFile * m_file = nullptr;
     GIOStream * m_iostream = nullptr;
@@ -82,6 +211,36 @@ private:
     GOutputStream * m_ostream = nullptr;
     GSeekable * m_seekable = nullptr;
     bool m_eof = false;
+
+    /* Read-only files are read in blocks, the next block being read ahead
+     * by a worker thread while the current one is consumed. */
+    bool m_buffered = false;
+    int m_block_size = 0;
+
+    Index<char> m_buf;          // current block
+    int64_t m_buf_pos = 0;      // file position of the current block
+    int m_buf_off = 0;          // read position within the current block
+
+    Index<char> m_next;         // block being read ahead
+    int64_t m_next_pos = 0;     // file position of the block being read ahead
+    bool m_next_failed = false;
+    PrefetchState m_state = Idle;
+
+    GThread * m_worker = nullptr;
+    GCancellable * m_cancel = nullptr;
+    GMutex m_mutex;
+    GCond m_cond;
+    bool m_quit = false;
+
+    void request_block_locked ();
+    void wait_idle_locked ();
+    bool next_block ();
+    int64_t read_buffered (char * buf, int64_t len);
+    int seek_buffered (int64_t offset, VFSSeekType whence);
+    void worker ();
+
+    static gpointer worker_thread (gpointer data)
+        { ((GIOFile *) data)->worker (); return nullptr; }
 };
 
 #define CHECK_ERROR(op, name) do { \
@@ -109,6 +268,9 @@ GIOFile::GIOFile (const char * filename, const char * mode) :
 
     m_file = g_file_new_for_uri (filename);
 
+    if (mode[0] != 'r' || strchr (mode, '+'))
+        forget_cached_info (filename);
+
     switch (mode[0])
     {
     case 'r':
@@ -125,6 +287,7 @@ GIOFile::GIOFile (const char * filename, const char * mode) :
             m_istream = (GInputStream *) g_file_read (m_file, 0, & error);
             CHECK_AND_SAVE_ERROR ("open", filename);
             m_seekable = (GSeekable *) m_istream;
+            m_buffered = true;
         }
         break;
     case 'w':
@@ -166,6 +329,14 @@ GIOFile::GIOFile (const char * filename, const char * mode) :
         goto FAILED;
     }
 
+    if (m_buffered)
+    {
+        m_block_size = 1024 * aud::clamp (aud_get_int ("gio", "block_kb"), 4, 1024);
+        m_cancel = g_cancellable_new ();
+        g_mutex_init (& m_mutex);
+        g_cond_init (& m_cond);
+    }
+
     return;
 
 FAILED:
@@ -177,6 +348,22 @@ GIOFile::~GIOFile ()
 {
     GError * error = nullptr;
 
+    if (m_buffered)
+    {
+        g_mutex_lock (& m_mutex);
+        m_quit = true;
+        g_cancellable_cancel (m_cancel);
+        g_cond_broadcast (& m_cond);
+        g_mutex_unlock (& m_mutex);
+
+        if (m_worker)
+            g_thread_join (m_worker);
+
+        g_object_unref (m_cancel);
+        g_mutex_clear (& m_mutex);
+        g_cond_clear (& m_cond);
+    }
+
     if (m_iostream)
     {
         g_io_stream_close (m_iostream, 0, & error);
@@ -212,6 +399,133 @@ VFSImpl * GIOTransport::fopen (const char * filename, const char * mode, String
     }
 }
 
+/* Reads the block at the current stream position in the background.
+ * From here on, the stream must not be touched until the block is ready. */
+void GIOFile::request_block_locked ()
+{
+    m_next_pos = m_buf_pos + m_buf.len ();
+    m_state = Pending;
+
+    if (! m_worker)
+        m_worker = g_thread_new ("gio-prefetch", worker_thread, this);
+
+    g_cond_broadcast (& m_cond);
+}
+
+void GIOFile::wait_idle_locked ()
+{
+    while (m_state == Pending)
+        g_cond_wait (& m_cond, & m_mutex);
+
+    m_next.clear ();
+    m_state = Idle;
+}
+
+void GIOFile::worker ()
+{
+    g_mutex_lock (& m_mutex);
+
+    while (! m_quit)
+    {
+        if (m_state != Pending)
+        {
+            g_cond_wait (& m_cond, & m_mutex);
+            continue;
+        }
+
+        g_mutex_unlock (& m_mutex);
+
+        /* Fill the whole block; each read may be a network round trip. */
+        GError * error = nullptr;
+        int64_t total = 0;
+
+        m_next.resize (m_block_size);
+
+        while (total < m_block_size)
+        {
+            int64_t part = g_input_stream_read (m_istream, m_next.begin () + total,
+             m_block_size - total, m_cancel, & error);
+
+            if (part <= 0)
+                break;
+
+            total += part;
+        }
+
+        m_next.resize (total);
+
+        g_mutex_lock (& m_mutex);
+
+        m_next_failed = (error != nullptr);
+
+        if (error)
+        {
+            if (! g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                AUDERR ("Cannot read from %s: %s.\n", (const char *) m_filename, error->message);
+
+            g_error_free (error);
+        }
+
+        m_state = Ready;
+        g_cond_broadcast (& m_cond);
+    }
+
+    g_mutex_unlock (& m_mutex);
+}
+
+/* Moves on to the block read ahead (waiting for it if need be) and starts
+ * reading the following one.  Returns false at end of file or on error. */
+bool GIOFile::next_block ()
+{
+    g_mutex_lock (& m_mutex);
+
+    if (m_state == Idle)
+        request_block_locked ();
+
+    while (m_state == Pending)
+        g_cond_wait (& m_cond, & m_mutex);
+
+    std::swap (m_buf, m_next);
+    m_buf_pos = m_next_pos;
+    m_buf_off = 0;
+    m_next.clear ();
+    m_state = Idle;
+
+    bool success = (m_buf.len () && ! m_next_failed);
+    m_eof = (! m_buf.len () && ! m_next_failed);
+
+    if (success)
+        request_block_locked ();
+
+    g_mutex_unlock (& m_mutex);
+    return success;
+}
+
+int64_t GIOFile::read_buffered (char * buf, int64_t len)
+{
+    int64_t total = 0;
+
+    while (total < len)
+    {
+        int avail = m_buf.len () - m_buf_off;
+
+        if (avail <= 0)
+        {
+            if (! next_block ())
+                break;
+
+            continue;
+        }
+
+        int part = aud::min ((int64_t) avail, len - total);
+        memcpy (buf + total, m_buf.begin () + m_buf_off, part);
+        m_buf_off += part;
+        total += part;
+    }
+
+    return total;
+}
+
 int64_t GIOFile::fread (void * buf, int64_t size, int64_t nitems)
 {
     GError * error = nullptr;
@@ -222,6 +536,9 @@ int64_t GIOFile::fread (void * buf, int64_t size, int64_t nitems)
         return 0;
     }
 
+    if (m_buffered)
+        return (size > 0) ? read_buffered ((char *) buf, size * nitems) / size : 0;
+
     int64_t total = 0;
     int64_t remain = size * nitems;
 
@@ -274,11 +591,89 @@ FAILED:
     return (size > 0) ? total / size : 0;
 }
 
+int GIOFile::seek_buffered (int64_t offset, VFSSeekType whence)
+{
+    int64_t target = -1;
+
+    if (whence == VFS_SEEK_SET)
+        target = offset;
+    else if (whence == VFS_SEEK_CUR)
+        target = m_buf_pos + m_buf_off + offset;
+
+    g_mutex_lock (& m_mutex);
+
+    /* Within the current block, or the one being read ahead?
+     * Then there is no need to touch the stream at all. */
+    if (target >= m_buf_pos && target <= m_buf_pos + m_buf.len ())
+    {
+        m_buf_off = target - m_buf_pos;
+        m_eof = false;
+        g_mutex_unlock (& m_mutex);
+        return 0;
+    }
+
+    if (m_state != Idle && target >= m_next_pos && target < m_next_pos + m_block_size)
+    {
+        while (m_state == Pending)
+            g_cond_wait (& m_cond, & m_mutex);
+
+        if (! m_next_failed && target <= m_next_pos + m_next.len ())
+        {
+            g_mutex_unlock (& m_mutex);
+
+            next_block ();
+            m_buf_off = target - m_buf_pos;
+            m_eof = false;
+            return 0;
+        }
+    }
+
+    /* Otherwise, drop both blocks and really seek. */
+    g_cancellable_cancel (m_cancel);
+    wait_idle_locked ();
+    g_cancellable_reset (m_cancel);
+
+    g_mutex_unlock (& m_mutex);
+
+    GError * error = nullptr;
+
+    if (target >= 0)
+        g_seekable_seek (m_seekable, target, G_SEEK_SET, nullptr, & error);
+    else
+        g_seekable_seek (m_seekable, offset, G_SEEK_END, nullptr, & error);
+
+    m_buf.clear ();
+    m_buf_pos = g_seekable_tell (m_seekable);
+    m_buf_off = 0;
+
+    if (error)
+    {
+        AUDERR ("Cannot seek within %s: %s.\n", (const char *) m_filename, error->message);
+        g_error_free (error);
+        return -1;
+    }
+
+    m_eof = (whence == VFS_SEEK_END && offset == 0);
+
+    return 0;
+}
+
 int GIOFile::fseek (int64_t offset, VFSSeekType whence)
 {
     GError * error = nullptr;
     GSeekType gwhence;
 
+    if (m_buffered)
+    {
+        if (whence != VFS_SEEK_SET && whence != VFS_SEEK_CUR && whence != VFS_SEEK_END)
+        {
+            AUDERR ("Cannot seek within %s: invalid whence.\n", (const char *) m_filename);
+            return -1;
+        }
+
+        return seek_buffered (offset, whence);
+    }
+
     switch (whence)
     {
     case VFS_SEEK_SET:
@@ -308,6 +703,9 @@ FAILED:
 
 int64_t GIOFile::ftell ()
 {
+    if (m_buffered)
+        return m_buf_pos + m_buf_off;
+
     return g_seekable_tell (m_seekable);
 }
 
@@ -336,6 +734,19 @@ int64_t GIOFile::fsize ()
     if (! g_seekable_can_seek (m_seekable))
         return -1;
 
+    CachedInfo cached;
+    if (m_buffered && lookup_cached_info (m_filename, cached))
+        return cached.size;
+
+    /* the stream must be left alone while a block is being read ahead */
+    if (m_buffered)
+    {
+        g_mutex_lock (& m_mutex);
+        while (m_state == Pending)
+            g_cond_wait (& m_cond, & m_mutex);
+        g_mutex_unlock (& m_mutex);
+    }
+
     GError * error = nullptr;
     int64_t saved_pos = g_seekable_tell (m_seekable);
     int64_t size = -1;
@@ -348,7 +759,8 @@ int64_t GIOFile::fsize ()
     g_seekable_seek (m_seekable, saved_pos, G_SEEK_SET, nullptr, & error);
     CHECK_ERROR ("seek within", m_filename);
 
-    m_eof = (saved_pos >= size);
+    if (! m_buffered)
+        m_eof = (saved_pos >= size);
 
 FAILED:
     return size;
@@ -370,8 +782,33 @@ FAILED:
     return -1;
 }
 
+static int test_info (GFileType type, bool is_symlink, uint32_t mode)
+{
+    int passed = VFS_EXISTS;
+
+    switch (type)
+    {
+        case G_FILE_TYPE_REGULAR: passed |= VFS_IS_REGULAR; break;
+        case G_FILE_TYPE_DIRECTORY: passed |= VFS_IS_DIR; break;
+        default: break;
+    };
+
+    if (is_symlink)
+        passed |= VFS_IS_SYMLINK;
+    if (mode & S_IXUSR)
+        passed |= VFS_IS_EXECUTABLE;
+
+    return passed;
+}
+
 VFSFileTest GIOTransport::test_file (const char * filename, VFSFileTest test, String & error)
 {
+    /* whether the file (still) exists is not answered from the cache, since
+     * it may have been created or deleted behind our back */
+    CachedInfo cached;
+    if (! (test & VFS_EXISTS) && lookup_cached_info (filename, cached))
+        return VFSFileTest (test & test_info (cached.type, cached.is_symlink, cached.mode));
+
     GFile * file = g_file_new_for_uri (filename);
     Index<String> attrs;
     int passed = 0;
@@ -395,19 +832,9 @@ VFSFileTest GIOTransport::test_file (const char * filename, VFSFileTest test, St
     }
     else
     {
-        passed |= VFS_EXISTS;
-
-        switch (g_file_info_get_file_type (info))
-        {
-            case G_FILE_TYPE_REGULAR: passed |= VFS_IS_REGULAR; break;
-            case G_FILE_TYPE_DIRECTORY: passed |= VFS_IS_DIR; break;
-            default: break;
-        };
-
-        if (g_file_info_get_is_symlink (info))
-            passed |= VFS_IS_SYMLINK;
-        if (g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_MODE) & S_IXUSR)
-            passed |= VFS_IS_EXECUTABLE;
+        passed |= test_info (g_file_info_get_file_type (info),
+         g_file_info_get_is_symlink (info),
+         g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_MODE));
 
         g_object_unref (info);
     }
@@ -416,36 +843,223 @@ VFSFileTest GIOTransport::test_file (const char * filename, VFSFileTest test, St
     return VFSFileTest (test & passed);
 }
 
-Index<String> GIOTransport::read_folder (const char * filename, String & error)
+/* assumes cache_mutex locked */
+static void purge_stale_locked ()
+{
+    int64_t now = g_get_monotonic_time ();
+
+    if (now - last_purge < GIO_CACHE_TTL)
+        return;
+
+    Index<String> stale;
+
+    info_cache.iterate ([&] (const String & key, CachedInfo & info) {
+        if (now - info.time >= GIO_CACHE_TTL)
+            stale.append (key);
+    });
+
+    for (const String & key : stale)
+        info_cache.remove (key);
+
+    stale.clear ();
+
+    folder_cache.iterate ([&] (const String & key, FolderListing & listing) {
+        if (listing.done && now - listing.time >= GIO_CACHE_TTL)
+            stale.append (key);
+    });
+
+    for (const String & key : stale)
+        folder_cache.remove (key);
+
+    last_purge = now;
+}
+
+struct EnumeratorBatch
+{
+    GList * infos = nullptr;
+    GError * error = nullptr;
+    bool done = false;
+};
+
+static void next_files_cb (GObject * source, GAsyncResult * result, void * data)
+{
+    auto batch = (EnumeratorBatch *) data;
+    batch->infos = g_file_enumerator_next_files_finish ((GFileEnumerator *) source,
+     result, & batch->error);
+    batch->done = true;
+}
+
+/* Lists a folder, fetching the attributes of all its files in batches as we
+ * go.  The asynchronous calls are dispatched in a private main context, since
+ * there is generally no main loop running in the calling thread. */
+static void enumerate_folder (const char * filename, FolderListing & listing)
 {
     GFile * file = g_file_new_for_uri (filename);
-    Index<String> files;
+    GMainContext * context = g_main_context_new ();
+    g_main_context_push_thread_default (context);
 
     GError * gerr = nullptr;
-    GFileEnumerator * dir = g_file_enumerate_children (file,
-     G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
+    GFileEnumerator * dir = g_file_enumerate_children (file, GIO_FOLDER_ATTRS,
      G_FILE_QUERY_INFO_NONE, nullptr, & gerr);
 
     if (! dir)
     {
-        error = String (gerr->message);
+        listing.error = String (gerr->message);
         g_error_free (gerr);
     }
     else
     {
-        GFileInfo * info;
-        while ((info = g_file_enumerator_next_file (dir, nullptr, nullptr)))
+        while (true)
         {
-            if (g_file_info_get_is_hidden (info))
-                continue;
-            StringBuf enc = str_encode_percent (g_file_info_get_name (info));
-            files.append (String (str_concat ({filename, "/", enc})));
-            g_object_unref (info);
+            EnumeratorBatch batch;
+            g_file_enumerator_next_files_async (dir, GIO_BATCH_SIZE,
+             G_PRIORITY_DEFAULT, nullptr, next_files_cb, & batch);
+
+            while (! batch.done)
+                g_main_context_iteration (context, true);
+
+            if (batch.error)
+            {
+                AUDERR ("Cannot read %s: %s.\n", filename, batch.error->message);
+                g_error_free (batch.error);
+                break;
+            }
+
+            if (! batch.infos)
+                break;
+
+            int64_t now = g_get_monotonic_time ();
+
+            g_mutex_lock (& cache_mutex);
+
+            for (GList * node = batch.infos; node; node = node->next)
+            {
+                auto info = (GFileInfo *) node->data;
+
+                if (g_file_info_get_is_hidden (info))
+                    continue;
+
+                StringBuf enc = str_encode_percent (g_file_info_get_name (info));
+                String uri (str_concat ({filename, "/", enc}));
+
+                CachedInfo cached = {
+                    g_file_info_get_file_type (info),
+                    (bool) g_file_info_get_is_symlink (info),
+                    g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_MODE),
+                    (int64_t) g_file_info_get_size (info),
+                    g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                    now
+                };
+
+                info_cache.add (uri, CachedInfo (cached));
+
+                if (cached.type == G_FILE_TYPE_DIRECTORY && ! cached.is_symlink)
+                    listing.subdirs.append (uri);
+
+                listing.files.append (std::move (uri));
+            }
+
+            g_mutex_unlock (& cache_mutex);
+
+            g_list_free_full (batch.infos, g_object_unref);
         }
 
         g_object_unref (dir);
     }
 
+    g_main_context_pop_thread_default (context);
+    g_main_context_unref (context);
     g_object_unref (file);
-    return files;
+}
+
+static void folder_job (void * data, void *)
+{
+    auto filename = (char *) data;
+
+    g_mutex_lock (& cache_mutex);
+    bool quit = folder_quit;
+    g_mutex_unlock (& cache_mutex);
+
+    FolderListing listing;
+    if (! quit)
+        enumerate_folder (filename, listing);
+
+    g_mutex_lock (& cache_mutex);
+
+    FolderListing * entry = folder_cache.lookup (String (filename));
+
+    if (entry)
+    {
+        * entry = std::move (listing);
+        entry->done = true;
+        entry->time = g_get_monotonic_time ();
+    }
+
+    g_cond_broadcast (& cache_cond);
+    g_mutex_unlock (& cache_mutex);
+
+    g_free (filename);
+}
+
+/* Starts listing the given folders in the background */
+static void prefetch_folders (const Index<String> & dirs)
+{
+    g_mutex_lock (& cache_mutex);
+
+    purge_stale_locked ();
+
+    if (! folder_pool)
+        folder_pool = g_thread_pool_new (folder_job, nullptr, GIO_FOLDER_THREADS, false, nullptr);
+
+    for (const String & dir : dirs)
+    {
+        if (folder_cache.n_items () >= GIO_MAX_PREFETCH)
+            break;
+
+        if (folder_cache.lookup (dir))
+            continue;
+
+        folder_cache.add (dir, FolderListing ());
+        g_thread_pool_push (folder_pool, g_strdup (dir), nullptr);
+    }
+
+    g_mutex_unlock (& cache_mutex);
+}
+
+Index<String> GIOTransport::read_folder (const char * filename, String & error)
+{
+    String key (filename);
+    FolderListing listing;
+    bool found = false;
+
+    /* Maybe we have listed (or are listing) this folder already */
+    g_mutex_lock (& cache_mutex);
+
+    FolderListing * prefetched;
+    while ((prefetched = folder_cache.lookup (key)) && ! prefetched->done)
+        g_cond_wait (& cache_cond, & cache_mutex);
+
+    if (prefetched)
+    {
+        if (g_get_monotonic_time () - prefetched->time < GIO_CACHE_TTL)
+        {
+            listing = std::move (* prefetched);
+            found = true;
+        }
+
+        folder_cache.remove (key);
+    }
+
+    g_mutex_unlock (& cache_mutex);
+
+    if (! found)
+        enumerate_folder (filename, listing);
+
+    if (listing.error)
+        error = listing.error;
+
+    /* The subfolders are likely to be asked for next */
+    prefetch_folders (listing.subdirs);
+
+    return std::move (listing.files);
 }
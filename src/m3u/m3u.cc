@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <libaudcore/audstrings.h>
@@ -56,6 +57,88 @@ static char * split_line (char * line)
     return feed + 1;
 }
 
+/* extended M3U information for the entries that follow */
+struct ExtInfo
+{
+    bool have_extinf = false;  /* #EXTINF given for the next entry */
+    int length = -1;
+    String artist, title;
+
+    /* these apply until changed */
+    String album, album_artist, genre;
+
+    Tuple make_tuple (const char * filename) const
+    {
+        Tuple tuple;
+        tuple.set_filename (filename);
+
+        if (title)
+            tuple.set_str (Tuple::Title, title);
+        if (artist)
+            tuple.set_str (Tuple::Artist, artist);
+        if (album)
+            tuple.set_str (Tuple::Album, album);
+        if (album_artist)
+            tuple.set_str (Tuple::AlbumArtist, album_artist);
+        if (genre)
+            tuple.set_str (Tuple::Genre, genre);
+        if (length >= 0)
+            tuple.set_int (Tuple::Length, length);
+
+        tuple.set_state (Tuple::Valid);
+        return tuple;
+    }
+};
+
+static String ext_value (const char * value)
+{
+    while (* value == ' ' || * value == '\t')
+        value ++;
+
+    return * value ? String (str_to_utf8 (value, -1)) : String ();
+}
+
+/* #EXTINF:<seconds> [attributes],[<artist> - ]<title> */
+static void parse_extinf (const char * value, ExtInfo & ext)
+{
+    ext.have_extinf = true;
+    ext.length = -1;
+    ext.artist = String ();
+    ext.title = String ();
+
+    double seconds = strtod (value, nullptr);
+    if (seconds >= 0)
+        ext.length = (int) (seconds * 1000 + 0.5);
+
+    const char * comma = strchr (value, ',');
+    if (! comma)
+        return;
+
+    const char * dash = strstr (comma + 1, " - ");
+
+    if (dash)
+    {
+        ext.artist = ext_value (str_copy (comma + 1, dash - (comma + 1)));
+        ext.title = ext_value (dash + 3);
+    }
+    else
+        ext.title = ext_value (comma + 1);
+}
+
+static void parse_directive (const char * line, ExtInfo & ext, String & title)
+{
+    if (! strncmp (line, "#EXTINF:", 8))
+        parse_extinf (line + 8, ext);
+    else if (! strncmp (line, "#EXTALB:", 8))
+        ext.album = ext_value (line + 8);
+    else if (! strncmp (line, "#EXTART:", 8))
+        ext.album_artist = ext_value (line + 8);
+    else if (! strncmp (line, "#EXTGENRE:", 10))
+        ext.genre = ext_value (line + 10);
+    else if (! strncmp (line, "#PLAYLIST:", 10))
+        title = ext_value (line + 10);
+}
+
 bool M3ULoader::load (const char * filename, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
@@ -67,6 +150,7 @@ bool M3ULoader::load (const char * filename, VFSFile & file, String & title,
 
     bool firstline = true;
     bool extm3u = false;
+    ExtInfo ext;
 
     char * parse = text.begin ();
     if (! strncmp (parse, "\xef\xbb\xbf", 3)) /* byte order mark */
@@ -85,12 +169,20 @@ bool M3ULoader::load (const char * filename, VFSFile & file, String & title,
                 extm3u = true;
             else if (extm3u && ! strncmp (parse, "#EXT-X-", 7))
                 goto HLS;
+            else
+                parse_directive (parse, ext, title);
         }
         else if (* parse)
         {
             StringBuf s = uri_construct (parse, filename);
-            if (s)
+
+            /* with #EXTINF, the entry can be shown without scanning it */
+            if (s && ext.have_extinf)
+                items.append (String (s), ext.make_tuple (s));
+            else if (s)
                 items.append (String (s));
+
+            ext.have_extinf = false;
         }
 
         firstline = false;
@@ -109,14 +201,65 @@ HLS:
     return true;
 }
 
+static bool write_line (VFSFile & file, const char * line)
+{
+    StringBuf buf = str_concat ({line, "\n"});
+    return file.fwrite (buf, 1, buf.len ()) == buf.len ();
+}
+
+/* writes a directive that applies to all following entries, if its value
+   differs from the one last written */
+static bool write_sticky (VFSFile & file, const char * directive,
+ String & last, const String & value)
+{
+    if (value == last)
+        return true;
+
+    last = value;
+    return write_line (file, str_concat ({directive, value ? (const char *) value : ""}));
+}
+
+static bool write_extinf (VFSFile & file, const Tuple & tuple, String & album,
+ String & album_artist, String & genre)
+{
+    if (! write_sticky (file, "#EXTALB:", album, tuple.get_str (Tuple::Album)) ||
+     ! write_sticky (file, "#EXTART:", album_artist, tuple.get_str (Tuple::AlbumArtist)) ||
+     ! write_sticky (file, "#EXTGENRE:", genre, tuple.get_str (Tuple::Genre)))
+        return false;
+
+    int length = tuple.get_int (Tuple::Length);
+    int seconds = (length >= 0) ? (length + 500) / 1000 : -1;
+
+    String title = tuple.get_str (Tuple::Title);
+    String artist = tuple.get_str (Tuple::Artist);
+
+    if (artist)
+        return write_line (file, str_printf ("#EXTINF:%d,%s - %s", seconds,
+         (const char *) artist, title ? (const char *) title : ""));
+    else
+        return write_line (file, str_printf ("#EXTINF:%d,%s", seconds,
+         title ? (const char *) title : ""));
+}
+
 bool M3ULoader::save (const char * filename, VFSFile & file, const char * title,
  const Index<PlaylistAddItem> & items)
 {
+    String album, album_artist, genre;
+
+    if (! write_line (file, "#EXTM3U"))
+        return false;
+
+    if (title && ! write_line (file, str_concat ({"#PLAYLIST:", title})))
+        return false;
+
     for (auto & item : items)
     {
+        if (item.tuple.state () == Tuple::Valid &&
+         ! write_extinf (file, item.tuple, album, album_artist, genre))
+            return false;
+
         StringBuf path = uri_deconstruct (item.filename, filename);
-        StringBuf line = str_concat ({path, "\n"});
-        if (file.fwrite (line, 1, line.len ()) != line.len ())
+        if (! write_line (file, path))
             return false;
     }
 
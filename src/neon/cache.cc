@@ -0,0 +1,129 @@
+/*
+ *  Block cache for the neon HTTP input plugin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libaudcore/index.h>
+#include <libaudcore/list.h>
+#include <libaudcore/multihash.h>
+#include <libaudcore/objects.h>
+
+#include "cache.h"
+
+struct CacheKey
+{
+    String url;
+    int64_t size;
+    int64_t block;
+
+    bool operator== (const CacheKey & b) const
+        { return size == b.size && block == b.block && url == b.url; }
+    unsigned hash () const
+        { return url.hash () + (unsigned) size * 31 + (unsigned) block * 2654435761u; }
+};
+
+struct CacheBlock : public ListNode
+{
+    CacheKey key;
+    Index<char> data;
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static SimpleHash<CacheKey, CacheBlock *> blocks;
+static List<CacheBlock> lru;  /* least recently used first */
+static int64_t total_bytes = 0;
+
+/* assumes mutex locked */
+static void evict_oldest ()
+{
+    CacheBlock * oldest = lru.head ();
+    if (! oldest)
+        return;
+
+    total_bytes -= oldest->data.len ();
+    blocks.remove (oldest->key);
+    lru.remove (oldest);
+    delete oldest;
+}
+
+int neon_cache_read (const String & url, int64_t size, int64_t block, int offset,
+ char * buf, int len)
+{
+    pthread_mutex_lock (& mutex);
+
+    int copied = 0;
+    CacheBlock * * cached = blocks.lookup ({url, size, block});
+
+    if (cached && offset < (* cached)->data.len ())
+    {
+        copied = aud::min (len, (* cached)->data.len () - offset);
+        memcpy (buf, (* cached)->data.begin () + offset, copied);
+
+        lru.remove (* cached);
+        lru.append (* cached);
+    }
+
+    pthread_mutex_unlock (& mutex);
+    return copied;
+}
+
+void neon_cache_store (const String & url, int64_t size, int64_t block,
+ const char * data, int len, int64_t budget)
+{
+    if (len > budget)
+        return;
+
+    pthread_mutex_lock (& mutex);
+
+    CacheKey key = {url, size, block};
+    CacheBlock * * found = blocks.lookup (key);
+    CacheBlock * cached;
+
+    if (found)
+    {
+        cached = * found;
+        total_bytes -= cached->data.len ();
+        lru.remove (cached);
+    }
+    else
+    {
+        cached = * blocks.add (key, new CacheBlock);
+        cached->key = key;
+    }
+
+    cached->data.clear ();
+    cached->data.insert (data, 0, len);
+    lru.append (cached);
+    total_bytes += len;
+
+    while (total_bytes > budget)
+        evict_oldest ();
+
+    pthread_mutex_unlock (& mutex);
+}
+
+void neon_cache_clear ()
+{
+    pthread_mutex_lock (& mutex);
+    blocks.clear ();
+    lru.clear ();
+    total_bytes = 0;
+    pthread_mutex_unlock (& mutex);
+}
@@ -0,0 +1,43 @@
+/*
+ *  Block cache for the neon HTTP input plugin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NEON_CACHE_H
+#define NEON_CACHE_H
+
+#include <stdint.h>
+
+#include <libaudcore/objects.h>
+
+#define NEON_CACHE_BLKSIZE  (65536)
+
+/* Process-wide cache of fixed-size blocks of seekable HTTP resources.  Blocks
+ * are keyed by URL, total size and block index; the last block of a resource
+ * may be shorter than NEON_CACHE_BLKSIZE.  Once the total size of all blocks
+ * exceeds the budget, the least recently used ones are dropped. */
+
+/* Copies up to <len> bytes starting at <offset> within the given block.
+ * Returns the number of bytes copied, 0 if the block is not cached. */
+int neon_cache_read (const String & url, int64_t size, int64_t block, int offset,
+ char * buf, int len);
+
+void neon_cache_store (const String & url, int64_t size, int64_t block,
+ const char * data, int len, int64_t budget);
+
+void neon_cache_clear ();
+
+#endif
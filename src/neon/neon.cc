@@ -18,17 +18,19 @@
  */
 
 #define __STDC_FORMAT_MACROS
+#include <errno.h>
 #include <inttypes.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include <glib.h>
 
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
-#include <libaudcore/ringbuf.h>
+#include <libaudcore/preferences.h>
 #include <libaudcore/runtime.h>
 
 #include <ne_auth.h>
@@ -39,12 +41,34 @@
 #include <ne_uri.h>
 #include <ne_utils.h>
 
+#include "cache.h"
 #include "cert_verification.h"
 
 #define NEON_NETBLKSIZE     (4096)
 #define NEON_ICY_BUFSIZE    (4096)
 #define NEON_RETRY_COUNT 6
 
+/* The consumer is woken up when the buffer stops being empty or once this
+ * much data has piled up in it (or when the reader has to stop because of
+ * EOF, an error or a full buffer), not after every single block. */
+#define NEON_LOW_WATERMARK  (16384)
+
+/* After a seek, missing cache blocks are fetched with bounded range requests.
+ * The amount fetched starts at two blocks and doubles with every sequential
+ * miss; after a few of those we go back to a single streaming request. */
+#define NEON_READAHEAD_MIN  (2)
+#define NEON_READAHEAD_MAX  (16)
+#define NEON_SEQ_MISSES     (3)
+#define NEON_MAX_FETCHES    (4)
+
+/* Live streams (those without a content length) are reconnected when the
+ * connection drops, waiting a little longer before each further attempt.
+ * Their buffer depth is measured in time, assuming this bitrate if the
+ * server does not tell us. */
+#define NEON_RECONNECT_TRIES (5)
+#define NEON_DEFAULT_KBPS    (128)
+#define NEON_MAX_LIVE_BUFFER (8 * 1048576)
+
 enum FillBufferResult {
     FILL_BUFFER_SUCCESS,
     FILL_BUFFER_ERROR,
@@ -80,6 +104,16 @@ struct reader_status
     }
 };
 
+/* ICY metadata block, to be applied once playback reaches <pos> */
+struct icy_update
+{
+    int64_t pos;
+    Index<char> data;
+
+    icy_update (int64_t pos, Index<char> && data) :
+        pos (pos), data (std::move (data)) {}
+};
+
 struct icy_metadata
 {
     String stream_name;
@@ -89,12 +123,93 @@ struct icy_metadata
     int stream_bitrate = 0;
 };
 
+/* A byte ring buffer which lets the reader thread receive data from the
+ * network directly into its free space.  The reader fills the area returned
+ * by write_area() without holding the lock and then publishes the data with
+ * commit(); the consumer only ever touches committed data.  Both calls, as
+ * well as all the reading functions, must be made with the lock held. */
+class NeonRing
+{
+public:
+    void alloc (int size)
+    {
+        m_data.resize (size);
+        m_offset = m_len = 0;
+    }
+
+    int size () const { return m_data.len (); }
+    int len () const { return m_len; }
+    int space () const { return m_data.len () - m_len; }
+
+    void discard ()
+        { m_offset = m_len = 0; }
+
+    /* Returns the linear free region following the committed data. */
+    char * write_area (int & avail)
+    {
+        int tail = (m_offset + m_len) % size ();
+        avail = aud::min (space (), size () - tail);
+        return m_data.begin () + tail;
+    }
+
+    void commit (int len)
+        { m_len += len; }
+
+    unsigned char head ()
+        { return m_data[m_offset]; }
+
+    void pop ()
+        { remove (1); }
+
+    void move_out (char * to, int len)
+    {
+        while (len > 0)
+        {
+            int part = aud::min (len, size () - m_offset);
+            memcpy (to, m_data.begin () + m_offset, part);
+            remove (part);
+            to += part;
+            len -= part;
+        }
+    }
+
+    void move_out (Index<char> & to, int len)
+    {
+        int pos = to.len ();
+        to.insert (pos, len);
+        move_out (to.begin () + pos, len);
+    }
+
+private:
+    Index<char> m_data;
+    int m_offset = 0, m_len = 0;
+
+    void remove (int len)
+    {
+        m_offset = (m_offset + len) % size ();
+        m_len -= len;
+
+        /* keep the free space in one piece whenever we get the chance */
+        if (! m_len)
+            m_offset = 0;
+    }
+};
+
 static const char * const neon_schemes[] = {"http", "https"};
 
 class NeonTransport : public TransportPlugin
 {
 public:
-    static constexpr PluginInfo info = {N_("Neon HTTP/HTTPS Plugin"), PACKAGE};
+    static const char * const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("Neon HTTP/HTTPS Plugin"),
+        PACKAGE,
+        nullptr,
+        & prefs
+    };
 
     constexpr NeonTransport () : TransportPlugin (info, neon_schemes) {}
 
@@ -106,8 +221,47 @@ public:
 
 EXPORT NeonTransport aud_plugin_instance;
 
+const char * const NeonTransport::defaults[] = {
+    "block_kb", "64",
+    "cache_mb", "16",
+    "parallel_fetches", "1",
+    "reconnect", "TRUE",
+    "jitter_min", "1",
+    "jitter_target", "2",
+    "jitter_max", "10",
+    nullptr
+};
+
+const PreferencesWidget NeonTransport::widgets[] = {
+    WidgetSpin (N_("Network read size:"),
+        WidgetInt ("neon", "block_kb"),
+        {4, 256, 4, N_("KiB")}),
+    WidgetSpin (N_("Seek cache size:"),
+        WidgetInt ("neon", "cache_mb"),
+        {0, 256, 1, N_("MiB")}),
+    WidgetSpin (N_("Parallel range requests:"),
+        WidgetInt ("neon", "parallel_fetches"),
+        {1, NEON_MAX_FETCHES, 1}),
+    WidgetLabel (N_("<b>Live Streams</b>")),
+    WidgetCheck (N_("Reconnect when the connection drops"),
+        WidgetBool ("neon", "reconnect")),
+    WidgetSpin (N_("Minimum buffer:"),
+        WidgetInt ("neon", "jitter_min"),
+        {0, 60, 1, N_("seconds")}),
+    WidgetSpin (N_("Initial buffer:"),
+        WidgetInt ("neon", "jitter_target"),
+        {0, 60, 1, N_("seconds")}),
+    WidgetSpin (N_("Maximum buffer:"),
+        WidgetInt ("neon", "jitter_max"),
+        {0, 60, 1, N_("seconds")})
+};
+
+const PluginPreferences NeonTransport::prefs = {{widgets}};
+
 bool NeonTransport::init ()
 {
+    aud_config_set_defaults ("neon", defaults);
+
     int ret = ne_sock_init ();
 
     if (ret != 0)
@@ -121,9 +275,22 @@ bool NeonTransport::init ()
 
 void NeonTransport::cleanup ()
 {
+    neon_cache_clear ();
     ne_sock_exit ();
 }
 
+class NeonFile;
+
+struct FetchJob
+{
+    NeonFile * file;
+    int64_t start;
+    char * buf;
+    int64_t len;
+    int64_t received;
+    pthread_t thread;
+};
+
 class NeonFile : public VFSImpl
 {
 public:
@@ -131,6 +298,7 @@ public:
     ~NeonFile ();
 
     int open_handle (int64_t startbyte, String * error = nullptr);
+    void setup_live ();
 
 protected:
     int64_t fread (void * ptr, int64_t size, int64_t nmemb);
@@ -161,11 +329,33 @@ private:
                                            send metadata announcements. 0 if no announcments */
     int64_t m_icy_metaleft = 0;         /* Bytes left until the next metadata block */
     int m_icy_len = 0;                  /* Bytes in current metadata block */
+    Index<icy_update> m_icy_updates;    /* Metadata received but not yet reached */
+
+    bool m_reconnect = false;           /* true if live streams are to be reconnected */
+    int m_reconnect_tries = 0;          /* Reconnects since data was last received */
+    bool m_prebuffering = false;        /* true while refilling the buffer of a live stream */
+    int m_jitter_min = 0;               /* Bounds of the live buffer depth, in ms */
+    int m_jitter_max = 0;
+    int m_jitter_ms = 0;                /* Current target live buffer depth, in ms */
+    int64_t m_stable_pos = 0;           /* Position of the last buffer depth change */
+    int m_wake_mark = NEON_LOW_WATERMARK;  /* Buffer fill level the consumer waits for */
 
     bool m_eof = false;
 
-    RingBuf<char> m_rb;           /* Ringbuffer for our data */
-    Index<char> m_icy_buf;        /* Buffer for ICY metadata */
+    int m_blocksize = NEON_NETBLKSIZE;  /* Maximum size of a single network read */
+
+    int64_t m_cache_budget = 0;         /* Memory budget of the block cache, 0 if disabled */
+    int m_parallel_fetches = 1;         /* Connections used to fill the cache after a seek */
+    bool m_cache_mode = false;          /* true if reads are served from the block cache
+                                           instead of a running request */
+    int m_fetch_blocks = NEON_READAHEAD_MIN;  /* Blocks to fetch on the next cache miss */
+    int64_t m_next_miss = -1;           /* Block a sequential cache miss would hit */
+    int m_seq_misses = 0;               /* Number of sequential cache misses */
+    int64_t m_net_pos = 0;              /* Stream position of the next byte received */
+    Index<char> m_stage;                /* Block being assembled for the cache */
+
+    NeonRing m_rb;                /* Ringbuffer for our data */
+    Index<char> m_icy_buf;        /* Buffer for ICY metadata (reader side) */
     icy_metadata m_icy_metadata;  /* Current ICY metadata */
 
     ne_session * m_session = nullptr;
@@ -177,7 +367,20 @@ private:
     void kill_reader ();
     int server_auth (const char * realm, int attempt, char * username, char * password);
     void handle_headers ();
+    StringBuf request_path ();
+    ne_session * create_session ();
     int open_request (int64_t startbyte, String * error);
+    int reopen (int64_t startbyte);
+    bool can_cache ();
+    void stage_received (const char * data, int len);
+    int strip_icy (char * data, int len);
+    bool reconnect ();
+    bool is_live ()
+        { return m_content_length < 0; }
+    int64_t live_bytes (int ms);
+    int64_t fetch_range (ne_session * session, int64_t start, char * buf, int64_t len);
+    bool fetch_blocks (int64_t block, int count);
+    int64_t read_cached (void * ptr, int64_t size, int64_t nmemb, bool & data_read);
     FillBufferResult fill_buffer ();
     void reader ();
     int64_t try_fread (void * ptr, int64_t size, int64_t nmemb, bool & data_read);
@@ -188,6 +391,8 @@ private:
 
     static void * reader_thread (void * data)
         { ((NeonFile *) data)->reader (); return nullptr; }
+
+    static void * fetch_thread (void * data);
 };
 
 NeonFile::NeonFile (const char * url) :
@@ -195,6 +400,20 @@ NeonFile::NeonFile (const char * url) :
 {
     int buffer_kb = aud_get_int ("net_buffer_kb");
     m_rb.alloc (1024 * aud::clamp (buffer_kb, 16, 1024));
+
+    /* leave room for at least two reads in the buffer */
+    int block_kb = aud_get_int ("neon", "block_kb");
+    m_blocksize = aud::min (1024 * aud::clamp (block_kb, 4, 256), m_rb.size () / 2);
+
+    int cache_mb = aud_get_int ("neon", "cache_mb");
+    m_cache_budget = (int64_t) 1048576 * aud::clamp (cache_mb, 0, 256);
+
+    /* a full read-ahead must fit into the cache */
+    if (m_cache_budget < (int64_t) NEON_READAHEAD_MAX * NEON_CACHE_BLKSIZE)
+        m_cache_budget = 0;
+
+    int fetches = aud_get_int ("neon", "parallel_fetches");
+    m_parallel_fetches = aud::clamp (fetches, 1, NEON_MAX_FETCHES);
 }
 
 NeonFile::~NeonFile ()
@@ -366,6 +585,9 @@ void NeonFile::handle_headers ()
 
     AUDDBG ("Header responses:\n");
 
+    /* may run on the reader thread when reconnecting */
+    pthread_mutex_lock (& m_reader_status.mutex);
+
     while ((cursor = ne_response_header_iterate (m_request, cursor, & name, & value)))
     {
         AUDDBG ("HEADER: %s: %s\n", name, value);
@@ -429,6 +651,8 @@ void NeonFile::handle_headers ()
             m_icy_metadata.stream_bitrate = atoi (value);
         }
     }
+
+    pthread_mutex_unlock (& m_reader_status.mutex);
 }
 
 static int neon_proxy_auth_cb (void * userdata, const char * realm, int attempt,
@@ -443,19 +667,21 @@ static int neon_proxy_auth_cb (void * userdata, const char * realm, int attempt,
     return attempt;
 }
 
+StringBuf NeonFile::request_path ()
+{
+    if (m_purl.query && * (m_purl.query))
+        return str_concat ({m_purl.path, "?", m_purl.query});
+    else
+        return str_copy (m_purl.path);
+}
+
 int NeonFile::open_request (int64_t startbyte, String * error)
 {
     int ret;
     const ne_status * status;
     ne_uri * rediruri;
 
-    if (m_purl.query && * (m_purl.query))
-    {
-        StringBuf tmp = str_concat ({m_purl.path, "?", m_purl.query});
-        m_request = ne_request_create (m_session, "GET", tmp);
-    }
-    else
-        m_request = ne_request_create (m_session, "GET", m_purl.path);
+    m_request = ne_request_create (m_session, "GET", request_path ());
 
     if (startbyte > 0)
         ne_add_request_header (m_request, "Range", str_printf ("bytes=%" PRIu64 "-", startbyte));
@@ -505,7 +731,10 @@ int NeonFile::open_request (int64_t startbyte, String * error)
             /* URL opened OK */
             AUDDBG ("<%p> URL opened OK\n", this);
             m_content_start = startbyte;
-            m_pos = startbyte;
+            m_net_pos = startbyte;
+            m_stage.clear ();
+            m_icy_buf.clear ();
+            m_icy_len = 0;
             handle_headers ();
             return 0;
         }
@@ -549,9 +778,8 @@ int NeonFile::open_request (int64_t startbyte, String * error)
     return -1;
 }
 
-int NeonFile::open_handle (int64_t startbyte, String * error)
+ne_session * NeonFile::create_session ()
 {
-    int ret;
     String proxy_host;
     int proxy_port = 0;
     String proxy_user (""); // ne_session_socks_proxy requires non NULL user and password
@@ -580,6 +808,52 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
         }
     }
 
+    AUDDBG ("<%p> Creating session to %s://%s:%d\n", this,
+     m_purl.scheme, m_purl.host, m_purl.port);
+    ne_session * session = ne_session_create (m_purl.scheme,
+     m_purl.host, m_purl.port);
+    ne_redirect_register (session);
+    ne_add_server_auth (session, NE_AUTH_BASIC, server_auth_callback, this);
+    ne_set_session_flag (session, NE_SESSFLAG_ICYPROTO, 1);
+    ne_set_session_flag (session, NE_SESSFLAG_PERSIST, 0);
+    ne_set_connect_timeout (session, 10);
+    ne_set_read_timeout (session, 10);
+    ne_set_useragent (session, "Audacious/" PACKAGE_VERSION);
+
+    if (use_proxy)
+    {
+        AUDDBG ("<%p> Using proxy: %s:%d\n", this, (const char *) proxy_host, proxy_port);
+        if (socks_proxy)
+        {
+            ne_session_socks_proxy (session, socks_type, proxy_host, proxy_port, proxy_user, proxy_pass);
+        }
+        else
+        {
+            ne_session_proxy (session, proxy_host, proxy_port);
+        }
+
+        if (use_proxy_auth)
+        {
+            AUDDBG ("<%p> Using proxy authentication\n", this);
+            ne_add_proxy_auth (session, NE_AUTH_BASIC,
+             neon_proxy_auth_cb, (void *) this);
+        }
+    }
+
+    if (! strcmp ("https", m_purl.scheme))
+    {
+        ne_ssl_trust_default_ca (session);
+        ne_ssl_set_verify (session,
+         neon_vfs_verify_environment_ssl_certs, session);
+    }
+
+    return session;
+}
+
+int NeonFile::open_handle (int64_t startbyte, String * error)
+{
+    int ret;
+
     m_redircount = 0;
 
     AUDDBG ("<%p> Parsing URL\n", this);
@@ -598,44 +872,7 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
         if (! m_purl.port)
             m_purl.port = ne_uri_defaultport (m_purl.scheme);
 
-        AUDDBG ("<%p> Creating session to %s://%s:%d\n", this,
-         m_purl.scheme, m_purl.host, m_purl.port);
-        m_session = ne_session_create (m_purl.scheme,
-         m_purl.host, m_purl.port);
-        ne_redirect_register (m_session);
-        ne_add_server_auth (m_session, NE_AUTH_BASIC, server_auth_callback, this);
-        ne_set_session_flag (m_session, NE_SESSFLAG_ICYPROTO, 1);
-        ne_set_session_flag (m_session, NE_SESSFLAG_PERSIST, 0);
-        ne_set_connect_timeout (m_session, 10);
-        ne_set_read_timeout (m_session, 10);
-        ne_set_useragent (m_session, "Audacious/" PACKAGE_VERSION);
-
-        if (use_proxy)
-        {
-            AUDDBG ("<%p> Using proxy: %s:%d\n", this, (const char *) proxy_host, proxy_port);
-            if (socks_proxy)
-            {
-                ne_session_socks_proxy (m_session, socks_type, proxy_host, proxy_port, proxy_user, proxy_pass);
-            }
-            else
-            {
-                ne_session_proxy (m_session, proxy_host, proxy_port);
-            }
-
-            if (use_proxy_auth)
-            {
-                AUDDBG ("<%p> Using proxy authentication\n", this);
-                ne_add_proxy_auth (m_session, NE_AUTH_BASIC,
-                 neon_proxy_auth_cb, (void *) this);
-            }
-        }
-
-        if (! strcmp ("https", m_purl.scheme))
-        {
-            ne_ssl_trust_default_ca (m_session);
-            ne_ssl_set_verify (m_session,
-             neon_vfs_verify_environment_ssl_certs, m_session);
-        }
+        m_session = create_session ();
 
         AUDDBG ("<%p> Creating request\n", this);
         ret = open_request (startbyte, error);
@@ -663,15 +900,394 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
     return 1;
 }
 
+/* Restarts streaming at the given position, reusing the current session if
+ * there is one. */
+int NeonFile::reopen (int64_t startbyte)
+{
+    if (m_session && ! open_request (startbyte, nullptr))
+        return 0;
+
+    if (m_session)
+    {
+        ne_session_destroy (m_session);
+        m_session = nullptr;
+    }
+
+    return open_handle (startbyte);
+}
+
+bool NeonFile::can_cache ()
+{
+    return m_cache_budget > 0 && m_can_ranges && m_content_length >= 0 && ! m_icy_metaint;
+}
+
+/* Collects the data received by a streaming request into whole blocks and
+ * hands them to the cache, so that seeking back into it needs no request. */
+void NeonFile::stage_received (const char * data, int len)
+{
+    int64_t size = m_content_start + m_content_length;
+    int64_t pos = m_net_pos;
+
+    while (len > 0)
+    {
+        int offset = pos % NEON_CACHE_BLKSIZE;
+        int part = aud::min (len, NEON_CACHE_BLKSIZE - offset);
+
+        /* blocks we did not receive from the start are not cached */
+        if (m_stage.len () == offset)
+        {
+            m_stage.insert (data, -1, part);
+
+            if (m_stage.len () == NEON_CACHE_BLKSIZE || pos + part == size)
+            {
+                neon_cache_store (m_url, size, pos / NEON_CACHE_BLKSIZE,
+                 m_stage.begin (), m_stage.len (), m_cache_budget);
+                m_stage.clear ();
+            }
+        }
+
+        data += part;
+        len -= part;
+        pos += part;
+    }
+}
+
+/* Removes ICY metadata from freshly received data in place, queueing it up
+ * to be parsed when playback gets there.  Returns the remaining length. */
+int NeonFile::strip_icy (char * data, int len)
+{
+    const char * in = data;
+    const char * end = data + len;
+    char * out = data;
+
+    while (in < end)
+    {
+        if (m_icy_metaleft)
+        {
+            int part = aud::min ((int64_t) (end - in), m_icy_metaleft);
+            memmove (out, in, part);
+            in += part;
+            out += part;
+            m_icy_metaleft -= part;
+        }
+        else if (! m_icy_len)
+        {
+            /* The next byte is the length of a ICY metadata announcement */
+            m_icy_len = 16 * (unsigned char) * in ++;
+            AUDDBG ("<%p> Expecting %d bytes of ICY metadata\n", this, m_icy_len);
+
+            if (! m_icy_len)
+                m_icy_metaleft = m_icy_metaint;
+        }
+        else
+        {
+            int part = aud::min ((int) (end - in), m_icy_len - m_icy_buf.len ());
+            m_icy_buf.insert (in, -1, part);
+            in += part;
+
+            if (m_icy_buf.len () == m_icy_len)
+            {
+                pthread_mutex_lock (& m_reader_status.mutex);
+                m_icy_updates.append (m_net_pos + (out - data), std::move (m_icy_buf));
+                pthread_mutex_unlock (& m_reader_status.mutex);
+
+                /* Reset countdown to next announcement */
+                m_icy_buf.clear ();
+                m_icy_len = 0;
+                m_icy_metaleft = m_icy_metaint;
+            }
+        }
+    }
+
+    return out - data;
+}
+
+int64_t NeonFile::live_bytes (int ms)
+{
+    int kbps = m_icy_metadata.stream_bitrate;
+    if (kbps <= 0)
+        kbps = NEON_DEFAULT_KBPS;
+
+    return (int64_t) kbps * ms / 8;
+}
+
+/* Sizes the buffer of a live stream for the configured maximum depth and
+ * makes the first read wait for it to fill up to the target depth. */
+void NeonFile::setup_live ()
+{
+    if (! is_live ())
+        return;
+
+    int min_s = aud::clamp (aud_get_int ("neon", "jitter_min"), 0, 60);
+    int max_s = aud::clamp (aud_get_int ("neon", "jitter_max"), min_s, 60);
+    int target_s = aud::clamp (aud_get_int ("neon", "jitter_target"), min_s, max_s);
+
+    m_reconnect = aud_get_bool ("neon", "reconnect");
+    m_jitter_min = 1000 * min_s;
+    m_jitter_max = 1000 * max_s;
+    m_jitter_ms = 1000 * target_s;
+    m_prebuffering = (m_jitter_ms > 0);
+
+    int64_t size = live_bytes (m_jitter_max) + 2 * m_blocksize;
+    if (size > m_rb.size ())
+        m_rb.alloc (aud::min (size, (int64_t) NEON_MAX_LIVE_BUFFER));
+}
+
+/* Tries once to resume a live stream after the connection was lost, waiting
+ * a bit first unless this is the first attempt.  Called and returns with the
+ * mutex locked. */
+bool NeonFile::reconnect ()
+{
+    if (m_reconnect_tries)
+    {
+        timespec deadline;
+        clock_gettime (CLOCK_REALTIME, & deadline);
+        deadline.tv_sec += 1 << (m_reconnect_tries - 1);
+
+        while (m_reader_status.reading && pthread_cond_timedwait
+         (& m_reader_status.cond, & m_reader_status.mutex, & deadline) != ETIMEDOUT)
+            continue;
+
+        if (! m_reader_status.reading)
+            return false;
+    }
+
+    m_reconnect_tries ++;
+
+    AUDINFO ("<%p> Connection lost, reconnecting (attempt %d of %d)\n", this,
+     m_reconnect_tries, NEON_RECONNECT_TRIES);
+
+    pthread_mutex_unlock (& m_reader_status.mutex);
+
+    if (m_request)
+    {
+        ne_request_destroy (m_request);
+        m_request = nullptr;
+    }
+
+    if (m_session)
+    {
+        ne_session_destroy (m_session);
+        m_session = nullptr;
+    }
+
+    /* The position in the stream carries on where it stopped, so that
+     * metadata still waiting in the queue is applied at the right time. */
+    int64_t net_pos = m_net_pos;
+    ne_uri_free (& m_purl);
+    int ret = open_handle (0);
+    m_net_pos = net_pos;
+
+    pthread_mutex_lock (& m_reader_status.mutex);
+
+    return ! ret;
+}
+
+/* Reads [start, start + len) using a bounded range request, so that the
+ * connection can be kept alive for the next one.  Returns the number of bytes
+ * received, or -1 if the server did not honor the request. */
+int64_t NeonFile::fetch_range (ne_session * session, int64_t start, char * buf, int64_t len)
+{
+    ne_request * request = ne_request_create (session, "GET", request_path ());
+    ne_add_request_header (request, "Range", str_printf ("bytes=%" PRId64 "-%" PRId64,
+     start, start + len - 1));
+
+    int ret = ne_begin_request (request);
+    const ne_status * status = ne_get_status (request);
+
+    if (ret == NE_OK && (status->code == 401 || status->code == 407))
+    {
+        /* Authorization required. Reconnect to authenticate */
+        ne_end_request (request);
+        ret = ne_begin_request (request);
+    }
+
+    int64_t received = -1;
+
+    if (ret == NE_OK && status->code == 206)
+    {
+        ssize_t bytes;
+        received = 0;
+
+        while (received < len && (bytes = ne_read_response_block (request,
+         buf + received, len - received)) > 0)
+            received += bytes;
+
+        /* Finish the response properly, otherwise the connection is lost. */
+        if (received < len || ne_discard_response (request) != NE_OK ||
+         ne_end_request (request) != NE_OK)
+            ne_close_connection (session);
+    }
+    else
+    {
+        AUDDBG ("<%p> Range request failed: %d (%d)\n", this, ret, status->code);
+        ne_close_connection (session);
+    }
+
+    ne_request_destroy (request);
+
+    AUDDBG ("<%p> Fetched %" PRId64 " bytes at %" PRId64 "\n", this, received, start);
+
+    return received;
+}
+
+void * NeonFile::fetch_thread (void * data)
+{
+    FetchJob * job = (FetchJob *) data;
+    ne_session * session = job->file->create_session ();
+
+    job->received = job->file->fetch_range (session, job->start, job->buf, job->len);
+
+    ne_session_destroy (session);
+    return nullptr;
+}
+
+/* Fetches <count> blocks into the cache, splitting the range over several
+ * connections if so configured.  Only the first part goes over the kept-alive
+ * session; the others are fetched in parallel on fresh ones. */
+bool NeonFile::fetch_blocks (int64_t block, int count)
+{
+    int64_t size = m_content_start + m_content_length;
+    int64_t start = block * NEON_CACHE_BLKSIZE;
+    int64_t len = aud::min ((int64_t) count * NEON_CACHE_BLKSIZE, size - start);
+
+    if (len <= 0)
+        return false;
+
+    Index<char> buf;
+    buf.insert (0, len);
+
+    int nblocks = (len + NEON_CACHE_BLKSIZE - 1) / NEON_CACHE_BLKSIZE;
+    int per_job = (nblocks + m_parallel_fetches - 1) / m_parallel_fetches;
+    int64_t job_len = (int64_t) per_job * NEON_CACHE_BLKSIZE;
+
+    FetchJob jobs[NEON_MAX_FETCHES];
+    int njobs = 0;
+
+    for (int64_t offset = 0; offset < len && njobs < NEON_MAX_FETCHES; offset += job_len)
+    {
+        FetchJob & job = jobs[njobs ++];
+        job = {this, start + offset, buf.begin () + offset,
+         aud::min (job_len, len - offset), -1, pthread_t ()};
+
+        if (njobs > 1)
+            pthread_create (& job.thread, nullptr, fetch_thread, & job);
+    }
+
+    jobs[0].received = fetch_range (m_session, jobs[0].start, jobs[0].buf, jobs[0].len);
+
+    bool success = true;
+
+    for (int i = 0; i < njobs; i ++)
+    {
+        FetchJob & job = jobs[i];
+
+        if (i > 0)
+            pthread_join (job.thread, nullptr);
+
+        if (job.received != job.len)
+            success = false;
+
+        /* store what we got, as long as the blocks are complete */
+        for (int64_t offset = 0; offset < job.received; offset += NEON_CACHE_BLKSIZE)
+        {
+            int64_t pos = job.start + offset;
+            int block_len = aud::min ((int64_t) NEON_CACHE_BLKSIZE, size - pos);
+
+            if (offset + block_len > job.received)
+                break;
+
+            neon_cache_store (m_url, size, pos / NEON_CACHE_BLKSIZE,
+             job.buf + offset, block_len, m_cache_budget);
+        }
+    }
+
+    return success;
+}
+
+int64_t NeonFile::read_cached (void * ptr, int64_t size, int64_t nmemb, bool & data_read)
+{
+    int64_t total = m_content_start + m_content_length;
+    int64_t want = aud::max (aud::min (size * nmemb, total - m_pos), (int64_t) 0);
+    int64_t copied = 0;
+    int64_t fetched = -1;
+
+    want -= want % size;
+
+    while (copied < want)
+    {
+        int64_t block = m_pos / NEON_CACHE_BLKSIZE;
+        int offset = m_pos % NEON_CACHE_BLKSIZE;
+        int part = neon_cache_read (m_url, total, block, offset, (char *) ptr + copied,
+         aud::min (want - copied, (int64_t) NEON_CACHE_BLKSIZE));
+
+        if (part)
+        {
+            copied += part;
+            m_pos += part;
+            continue;
+        }
+
+        /* Cache miss.  Fetch some blocks, unless we are reading sequentially
+         * anyway, in which case streaming is cheaper. */
+        if (block == m_next_miss)
+            m_seq_misses ++;
+        else
+        {
+            m_seq_misses = 0;
+            m_fetch_blocks = NEON_READAHEAD_MIN;
+        }
+
+        if (block != fetched && m_seq_misses < NEON_SEQ_MISSES &&
+         fetch_blocks (block, m_fetch_blocks))
+        {
+            fetched = block;
+            m_next_miss = block + m_fetch_blocks;
+            m_fetch_blocks = aud::min (m_fetch_blocks * 2, NEON_READAHEAD_MAX);
+            continue;
+        }
+
+        AUDDBG ("<%p> Resuming streaming at %" PRId64 "\n", this, m_pos);
+
+        /* don't split an element between the cache and the stream */
+        int64_t partial = copied % size;
+        copied -= partial;
+        m_pos -= partial;
+
+        m_cache_mode = false;
+
+        if (reopen (m_pos) != 0)
+        {
+            AUDERR ("<%p> Error while creating new request!\n", this);
+            break;
+        }
+
+        if (! copied)
+            return try_fread (ptr, size, nmemb, data_read);
+
+        break;
+    }
+
+    if (copied)
+        data_read = true;
+
+    if (m_cache_mode && m_pos >= total)
+        m_eof = true;
+
+    return copied / size;
+}
+
 FillBufferResult NeonFile::fill_buffer ()
 {
-    char buffer[NEON_NETBLKSIZE];
     int to_read;
 
     pthread_mutex_lock (& m_reader_status.mutex);
-    to_read = aud::min (m_rb.space (), NEON_NETBLKSIZE);
+    char * buffer = m_rb.write_area (to_read);
+    to_read = aud::min (to_read, m_blocksize);
     pthread_mutex_unlock (& m_reader_status.mutex);
 
+    /* The area we write to is not visible to the consumer until it is
+     * committed, so the network read can go straight into the ring. */
     int bsize = ne_read_response_block (m_request, buffer, to_read);
 
     if (! bsize)
@@ -690,8 +1306,25 @@ FillBufferResult NeonFile::fill_buffer ()
 
     AUDDBG ("<%p> Read %d bytes of %d\n", this, bsize, to_read);
 
+    m_reconnect_tries = 0;
+
+    if (m_icy_metaint)
+        bsize = strip_icy (buffer, bsize);
+
+    if (can_cache ())
+        stage_received (buffer, bsize);
+
+    m_net_pos += bsize;
+
     pthread_mutex_lock (& m_reader_status.mutex);
-    m_rb.copy_in (buffer, bsize);
+
+    int old_len = m_rb.len ();
+    m_rb.commit (bsize);
+
+    /* Wake up the main thread only at watermark crossings. */
+    if ((! old_len && bsize) || (old_len < m_wake_mark && m_rb.len () >= m_wake_mark))
+        pthread_cond_broadcast (& m_reader_status.cond);
+
     pthread_mutex_unlock (& m_reader_status.mutex);
 
     return FILL_BUFFER_SUCCESS;
@@ -703,8 +1336,8 @@ void NeonFile::reader ()
 
     while (m_reader_status.reading)
     {
-        /* Hit the network only if we have more than NEON_NETBLKSIZE of free buffer */
-        if (m_rb.space () > NEON_NETBLKSIZE)
+        /* Hit the network only if we have room for a full block */
+        if (m_rb.space () >= m_blocksize)
         {
             pthread_mutex_unlock (& m_reader_status.mutex);
 
@@ -712,14 +1345,26 @@ void NeonFile::reader ()
 
             pthread_mutex_lock (& m_reader_status.mutex);
 
-            /* Wake up main thread if it is waiting. */
-            pthread_cond_broadcast (& m_reader_status.cond);
+            if (ret != FILL_BUFFER_SUCCESS && is_live () && m_reconnect)
+            {
+                bool resumed = false;
+
+                while (! resumed && m_reader_status.reading &&
+                 m_reconnect_tries < NEON_RECONNECT_TRIES)
+                    resumed = reconnect ();
+
+                if (resumed || ! m_reader_status.reading)
+                    continue;
+
+                AUDERR ("<%p> Giving up reconnecting\n", this);
+            }
 
             if (ret == FILL_BUFFER_ERROR)
             {
                 AUDERR ("<%p> Error while reading from the network. "
                         "Terminating reader thread\n", this);
                 m_reader_status.status = NEON_READER_ERROR;
+                pthread_cond_broadcast (& m_reader_status.cond);
                 pthread_mutex_unlock (& m_reader_status.mutex);
                 return;
             }
@@ -728,14 +1373,18 @@ void NeonFile::reader ()
                 AUDDBG ("<%p> EOF encountered while reading from the network. "
                         "Terminating reader thread\n", this);
                 m_reader_status.status = NEON_READER_EOF;
+                pthread_cond_broadcast (& m_reader_status.cond);
                 pthread_mutex_unlock (& m_reader_status.mutex);
                 return;
             }
         }
         else
         {
-            /* Not enough free space in the buffer.
-             * Sleep until the main thread wakes us up. */
+            /* Not enough free space in the buffer.  Make sure the main
+             * thread knows there is data (the low watermark may not have
+             * been reached if the buffer is small), then sleep until it
+             * wakes us up. */
+            pthread_cond_broadcast (& m_reader_status.cond);
             pthread_cond_wait (& m_reader_status.cond, & m_reader_status.mutex);
         }
     }
@@ -758,22 +1407,43 @@ VFSImpl * NeonTransport::fopen (const char * path, const char * mode, String & e
         return nullptr;
     }
 
+    file->setup_live ();
+
     return file;
 }
 
 int64_t NeonFile::try_fread (void * ptr, int64_t size, int64_t nmemb, bool & data_read)
 {
-    if (! m_request)
+    if (! size || ! nmemb || m_eof)
+        return 0;
+
+    if (m_cache_mode)
+        return read_cached (ptr, size, nmemb, data_read);
+
+    pthread_mutex_lock (& m_reader_status.mutex);
+
+    /* While the reader thread runs, it owns the request and may be
+     * reconnecting, so the request is only looked at without one. */
+    if (! m_reader_status.reading && ! m_request)
     {
+        pthread_mutex_unlock (& m_reader_status.mutex);
         AUDERR ("<%p> No request to read from, seek gone wrong?\n", this);
         return 0;
     }
 
-    if (! size || ! nmemb || m_eof)
-        return 0;
+    /* A live stream ran dry.  Let the buffer build up again before carrying
+     * on, aiming for a deeper buffer this time. */
+    if (m_jitter_max && ! m_prebuffering && m_reader_status.reading &&
+     m_reader_status.status == NEON_READER_RUN && m_rb.len () < size)
+    {
+        m_jitter_ms = aud::clamp (m_jitter_ms * 2, aud::max (m_jitter_min, 1000), m_jitter_max);
+        m_stable_pos = m_pos;
+        m_prebuffering = true;
+
+        AUDINFO ("<%p> Buffer underrun, refilling to %d ms\n", this, m_jitter_ms);
+    }
 
     /* If the buffer is empty, wait for the reader thread to fill it. */
-    pthread_mutex_lock (& m_reader_status.mutex);
 
     for (int retries = 0; retries < NEON_RETRY_COUNT; retries ++)
     {
@@ -880,6 +1550,22 @@ int64_t NeonFile::try_fread (void * ptr, int64_t size, int64_t nmemb, bool & dat
     /* Deliver data from the buffer */
     pthread_mutex_lock (& m_reader_status.mutex);
 
+    if (m_prebuffering)
+    {
+        /* leave room for the reader, or it would stop before we are done */
+        int want = aud::min (live_bytes (m_jitter_ms), (int64_t) (m_rb.size () - m_blocksize));
+
+        AUDDBG ("<%p> Prebuffering %d bytes\n", this, want);
+        m_wake_mark = want;
+
+        while (m_rb.len () < want && m_reader_status.reading &&
+         m_reader_status.status == NEON_READER_RUN)
+            pthread_cond_wait (& m_reader_status.cond, & m_reader_status.mutex);
+
+        m_wake_mark = NEON_LOW_WATERMARK;
+        m_prebuffering = false;
+    }
+
     if (m_rb.len ())
         data_read = true;
     else
@@ -892,44 +1578,26 @@ int64_t NeonFile::try_fread (void * ptr, int64_t size, int64_t nmemb, bool & dat
 
     int64_t belem = m_rb.len () / size;
 
-    if (m_icy_metaint)
+    /* Apply the ICY metadata that playback has reached */
+    while (m_icy_updates.len () && m_icy_updates[0].pos <= m_pos)
     {
-        if (! m_icy_metaleft)
-        {
-            if (! m_icy_len)
-            {
-                /* The next data in the buffer is a ICY metadata announcement.
-                 * Get the length byte */
-                m_icy_len = 16 * (unsigned char) m_rb.head ();
-                m_rb.pop ();
-
-                AUDDBG ("<%p> Expecting %d bytes of ICY metadata\n", this, m_icy_len);
-            }
-
-            if (m_icy_buf.len () < m_icy_len)
-                m_rb.move_out (m_icy_buf, -1, aud::min (m_icy_len - m_icy_buf.len (), m_rb.len ()));
-
-            if (m_icy_buf.len () >= m_icy_len)
-            {
-                /* Grab the metadata from the buffer and send it to the parser */
-                parse_icy (& m_icy_metadata, m_icy_buf.begin (), m_icy_buf.len ());
-
-                /* Reset countdown to next announcement */
-                m_icy_buf.clear ();
-                m_icy_len = 0;
-                m_icy_metaleft = m_icy_metaint;
-            }
-        }
-
-        /* The maximum number of bytes we can deliver is determined
-         * by the number of bytes left until the next metadata announcement */
-        belem = aud::min ((int64_t) m_rb.len (), m_icy_metaleft) / size;
+        Index<char> & data = m_icy_updates[0].data;
+        parse_icy (& m_icy_metadata, data.begin (), data.len ());
+        m_icy_updates.remove (0, 1);
     }
 
+    /* The maximum number of bytes we can deliver is determined
+     * by the number of bytes left until the next metadata announcement */
+    if (m_icy_updates.len () && m_icy_updates[0].pos - m_pos >= size)
+        belem = aud::min (belem, (m_icy_updates[0].pos - m_pos) / size);
+
     nmemb = aud::min (belem, nmemb);
+
+    bool was_full = (m_rb.space () < m_blocksize);
     m_rb.move_out ((char *) ptr, nmemb * size);
 
-    /* Signal the network thread to continue reading */
+    /* Signal the network thread to continue reading, but only once there
+     * is room for another block; it is not waiting otherwise. */
     if (m_reader_status.status == NEON_READER_EOF)
     {
         if (! m_rb.len ())
@@ -938,13 +1606,19 @@ int64_t NeonFile::try_fread (void * ptr, int64_t size, int64_t nmemb, bool & dat
             m_eof = true;
         }
     }
-    else
+    else if (was_full && m_rb.space () >= m_blocksize)
         pthread_cond_broadcast (& m_reader_status.cond);
 
-    pthread_mutex_unlock (& m_reader_status.mutex);
-
     m_pos += nmemb * size;
-    m_icy_metaleft -= nmemb * size;
+
+    /* After a minute without underruns, try with a shallower buffer */
+    if (m_jitter_ms > m_jitter_min && m_pos - m_stable_pos > live_bytes (60000))
+    {
+        m_jitter_ms = aud::max (m_jitter_ms - 1000, m_jitter_min);
+        m_stable_pos = m_pos;
+    }
+
+    pthread_mutex_unlock (& m_reader_status.mutex);
 
     return nmemb;
 }
@@ -1079,18 +1753,39 @@ int NeonFile::fseek (int64_t offset, VFSSeekType whence)
     {
         ne_request_destroy (m_request);
         m_request = nullptr;
+
+        /* The response was not read to the end, so the connection
+         * cannot be used for another request. */
+        if (m_session)
+            ne_close_connection (m_session);
+    }
+
+    m_rb.discard ();
+    m_icy_buf.clear ();
+    m_icy_len = 0;
+    m_icy_updates.clear ();
+    m_eof = false;
+
+    /* If the server handles ranges, don't reconnect right away.  Reads
+     * are served from the block cache, and missing blocks are fetched with
+     * range requests over a kept-alive connection. */
+    if (m_session && can_cache ())
+    {
+        AUDDBG ("<%p> Serving reads from the cache\n", this);
+        ne_set_session_flag (m_session, NE_SESSFLAG_PERSIST, 1);
+        m_pos = newpos;
+        m_cache_mode = true;
+        return 0;
     }
 
+    m_cache_mode = false;
+
     if (m_session)
     {
         ne_session_destroy (m_session);
         m_session = nullptr;
     }
 
-    m_rb.discard ();
-    m_icy_buf.clear ();
-    m_icy_len = 0;
-
     if (open_handle (newpos) != 0)
     {
         AUDERR ("<%p> Error while creating new request!\n", this);
@@ -1099,7 +1794,7 @@ int NeonFile::fseek (int64_t offset, VFSSeekType whence)
 
     /* Things seem to have worked. The next read request will start
      * the reader thread again. */
-    m_eof = false;
+    m_pos = newpos;
 
     return 0;
 }
@@ -1108,19 +1803,26 @@ String NeonFile::get_metadata (const char * field)
 {
     AUDDBG ("<%p> Field name: %s\n", this, field);
 
+    String value;
+
+    /* the headers may be updated by the reader thread when reconnecting */
+    pthread_mutex_lock (& m_reader_status.mutex);
+
     if (! strcmp (field, "track-name") && m_icy_metadata.stream_title)
-        return m_icy_metadata.stream_title;
+        value = m_icy_metadata.stream_title;
 
     if (! strcmp (field, "stream-name") && m_icy_metadata.stream_name)
-        return m_icy_metadata.stream_name;
+        value = m_icy_metadata.stream_name;
 
     if (! strcmp (field, "content-type") && m_icy_metadata.stream_contenttype)
-        return m_icy_metadata.stream_contenttype;
+        value = m_icy_metadata.stream_contenttype;
 
     if (! strcmp (field, "content-bitrate"))
-        return String (int_to_str (m_icy_metadata.stream_bitrate * 1000));
+        value = String (int_to_str (m_icy_metadata.stream_bitrate * 1000));
+
+    pthread_mutex_unlock (& m_reader_status.mutex);
 
-    return String ();
+    return value;
 }
 
 int64_t NeonFile::fsize ()
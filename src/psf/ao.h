@@ -33,6 +33,24 @@ enum
 	COMMAND_JUMP
 };
 
-Index<char> ao_get_lib(char *filename);
+// Savestates: each emulator module describes its state as a list of memory
+// blocks, which are copied verbatim into a checkpoint and back
+typedef struct
+{
+	void *ptr;
+	uint32_t size;
+} ao_state_block;
+
+#define MAX_STATE_BLOCKS			(128)
+#define STATE_BLOCK(x)				{ (void *)&(x), sizeof(x) }
+
+// ao_get_lib: load a secondary file, decoded and shared between songs;
+// hand it back with ao_release_lib when done
+struct corlett_lib;
+corlett_lib *ao_get_lib(char *filename);
+void ao_release_lib(corlett_lib *lib);
+
+// called by the engines at the end of every emulated frame
+void ao_frame_done(void);
 
 #endif // AO_H
@@ -91,93 +91,30 @@ The following data is optional and may be omitted:
 
 #define DECOMP_MAX_SIZE		((32 * 1024 * 1024) + 12)
 
-int corlett_decode(uint8_t *input, uint32_t input_len, uint8_t **output, uint64_t *size, corlett_t **c)
+static corlett_t *corlett_alloc(void)
 {
-	uint32_t *buf;
-	uint32_t res_area, comp_crc,  actual_crc;
-	uint8_t *decomp_dat, *tag_dec;
-	uLongf decomp_length, comp_length;
-
-	// 32-bit pointer to data
-	buf = (uint32_t *)input;
-
-	// Check we have a PSF format file.
-	if ((input[0] != 'P') || (input[1] != 'S') || (input[2] != 'F'))
-	{
-		return AO_FAIL;
-	}
-
-	// Get our values
-	res_area = LE32(buf[1]);
-	comp_length = LE32(buf[2]);
-	comp_crc = LE32(buf[3]);
-
-	if (comp_length > 0)
-	{
-		// Check length
-		if (input_len < comp_length + 16)
-			return AO_FAIL;
-
-		// Check CRC is correct
-		actual_crc = crc32(0, (unsigned char *)&buf[4+(res_area/4)], comp_length);
-		if (actual_crc != comp_crc)
-			return AO_FAIL;
-
-		// Decompress data if any
-		decomp_dat = (uint8_t *) malloc(DECOMP_MAX_SIZE);
-		decomp_length = DECOMP_MAX_SIZE;
-		if (uncompress(decomp_dat, &decomp_length, (unsigned char *)&buf[4+(res_area/4)], comp_length) != Z_OK)
-		{
-			free(decomp_dat);
-			return AO_FAIL;
-		}
-
-		// Resize memory buffer to what we actually need
-		decomp_dat = (uint8_t *) realloc(decomp_dat, (size_t)decomp_length + 1);
-	}
-	else
-	{
-		decomp_dat = nullptr;
-		decomp_length =  0;
-	}
-
-	// Make structure
-	*c = (corlett_t *) malloc(sizeof(corlett_t));
-	if (!(*c))
-	{
-		free(decomp_dat);
-		return AO_FAIL;
-	}
-	memset(*c, 0, sizeof(corlett_t));
-	strcpy((*c)->inf_title, "n/a");
-	strcpy((*c)->inf_copy, "n/a");
-	strcpy((*c)->inf_artist, "n/a");
-	strcpy((*c)->inf_game, "n/a");
-	strcpy((*c)->inf_year, "n/a");
-	strcpy((*c)->inf_length, "n/a");
-	strcpy((*c)->inf_fade, "n/a");
-
-	// set reserved section pointer
-	(*c)->res_section = &buf[4];
-	(*c)->res_size = res_area;
-
-	// Return it
-	if (output != nullptr && size != nullptr)
-	{
-		*output = decomp_dat;
-		*size = decomp_length;
-	}
-	else
-		free(decomp_dat);
+	corlett_t *c = (corlett_t *) malloc(sizeof(corlett_t));
+	if (!c)
+		return nullptr;
+
+	memset(c, 0, sizeof(corlett_t));
+	strcpy(c->inf_title, "n/a");
+	strcpy(c->inf_copy, "n/a");
+	strcpy(c->inf_artist, "n/a");
+	strcpy(c->inf_game, "n/a");
+	strcpy(c->inf_year, "n/a");
+	strcpy(c->inf_length, "n/a");
+	strcpy(c->inf_fade, "n/a");
+
+	return c;
+}
 
-	// Next check for tags
-	input_len -= (comp_length + 16 + res_area);
+// tag_dec points to the (optional) tag area at the end of the file
+static void corlett_parse_tags(uint8_t *tag_dec, uint32_t input_len, corlett_t *c)
+{
 	if (input_len < 5)
-		return AO_SUCCESS;
+		return;
 
-//	printf("\n\nNew corlett: input len %d\n", input_len);
-
-	tag_dec = input + (comp_length + res_area + 16);
 	if ((tag_dec[0] == '[') && (tag_dec[1] == 'T') && (tag_dec[2] == 'A') && (tag_dec[3] == 'G') && (tag_dec[4] == ']'))
 	{
 		int l, num_tags, data;
@@ -195,27 +132,27 @@ int corlett_decode(uint8_t *input, uint32_t input_len, uint8_t **output, uint64_
 			{
 				if ((*tag_dec == 0xA) || (*tag_dec == 0x00))
 				{
-					(*c)->tag_data[num_tags][l] = 0;
+					c->tag_data[num_tags][l] = 0;
 					data = false;
 					num_tags++;
 					l = 0;
 				}
 				else
 				{
-					(*c)->tag_data[num_tags][l++] = *tag_dec;
+					c->tag_data[num_tags][l++] = *tag_dec;
 				}
 			}
 			else
 			{
 				if (*tag_dec == '=')
 				{
-					(*c)->tag_name[num_tags][l] = 0;
+					c->tag_name[num_tags][l] = 0;
 					l = 0;
 					data = true;
 				}
 				else
 				{
-					(*c)->tag_name[num_tags][l++] = *tag_dec;
+					c->tag_name[num_tags][l++] = *tag_dec;
 				}
 			}
 
@@ -228,115 +165,222 @@ int corlett_decode(uint8_t *input, uint32_t input_len, uint8_t **output, uint64_
 		for (num_tags = 0; num_tags < MAX_UNKNOWN_TAGS; num_tags++)
 		{
 			// See if tag belongs in one of the special fields we have
-			if (!strcmp_nocase((*c)->tag_name[num_tags], "_lib"))
+			if (!strcmp_nocase(c->tag_name[num_tags], "_lib"))
 			{
-				strcpy((*c)->lib, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->lib, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_lib2", 5))
+			else if (!strncmp(c->tag_name[num_tags], "_lib2", 5))
 			{
-				strcpy((*c)->libaux[0], (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->libaux[0], c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_lib3", 5))
+			else if (!strncmp(c->tag_name[num_tags], "_lib3", 5))
 			{
-				strcpy((*c)->libaux[1], (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->libaux[1], c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_lib4", 5))
+			else if (!strncmp(c->tag_name[num_tags], "_lib4", 5))
 			{
-				strcpy((*c)->libaux[2], (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->libaux[2], c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_lib5", 5))
+			else if (!strncmp(c->tag_name[num_tags], "_lib5", 5))
 			{
-				strcpy((*c)->libaux[3], (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->libaux[3], c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_lib6", 5))
+			else if (!strncmp(c->tag_name[num_tags], "_lib6", 5))
 			{
-				strcpy((*c)->libaux[4], (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->libaux[4], c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_lib7", 5))
+			else if (!strncmp(c->tag_name[num_tags], "_lib7", 5))
 			{
-				strcpy((*c)->libaux[5], (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->libaux[5], c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_lib8", 5))
+			else if (!strncmp(c->tag_name[num_tags], "_lib8", 5))
 			{
-				strcpy((*c)->libaux[6], (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->libaux[6], c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_lib9", 5))
+			else if (!strncmp(c->tag_name[num_tags], "_lib9", 5))
 			{
-				strcpy((*c)->libaux[7], (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->libaux[7], c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "_refresh", 8))
+			else if (!strncmp(c->tag_name[num_tags], "_refresh", 8))
 			{
-				strcpy((*c)->inf_refresh, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->inf_refresh, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "title", 5))
+			else if (!strncmp(c->tag_name[num_tags], "title", 5))
 			{
-				strcpy((*c)->inf_title, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->inf_title, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "copyright", 9))
+			else if (!strncmp(c->tag_name[num_tags], "copyright", 9))
 			{
-				strcpy((*c)->inf_copy, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->inf_copy, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "artist", 6))
+			else if (!strncmp(c->tag_name[num_tags], "artist", 6))
 			{
-				strcpy((*c)->inf_artist, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->inf_artist, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "game", 4))
+			else if (!strncmp(c->tag_name[num_tags], "game", 4))
 			{
-				strcpy((*c)->inf_game, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->inf_game, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "year", 4))
+			else if (!strncmp(c->tag_name[num_tags], "year", 4))
 			{
-				strcpy((*c)->inf_year, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->inf_year, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "length", 6))
+			else if (!strncmp(c->tag_name[num_tags], "length", 6))
 			{
-				strcpy((*c)->inf_length, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->inf_length, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
-			else if (!strncmp((*c)->tag_name[num_tags], "fade", 4))
+			else if (!strncmp(c->tag_name[num_tags], "fade", 4))
 			{
-				strcpy((*c)->inf_fade, (*c)->tag_data[num_tags]);
-				(*c)->tag_data[num_tags][0] = 0;
-				(*c)->tag_name[num_tags][0] = 0;
+				strcpy(c->inf_fade, c->tag_data[num_tags]);
+				c->tag_data[num_tags][0] = 0;
+				c->tag_name[num_tags][0] = 0;
 			}
 		}
 	}
+}
+
+int corlett_decode(uint8_t *input, uint32_t input_len, uint8_t **output, uint64_t *size, corlett_t **c)
+{
+	uint32_t *buf;
+	uint32_t res_area, comp_crc,  actual_crc;
+	uint8_t *decomp_dat, *tag_dec;
+	uLongf decomp_length, comp_length;
+
+	// 32-bit pointer to data
+	buf = (uint32_t *)input;
+
+	// Check we have a PSF format file.
+	if ((input[0] != 'P') || (input[1] != 'S') || (input[2] != 'F'))
+	{
+		return AO_FAIL;
+	}
+
+	// Get our values
+	res_area = LE32(buf[1]);
+	comp_length = LE32(buf[2]);
+	comp_crc = LE32(buf[3]);
+
+	if (comp_length > 0)
+	{
+		// Check length
+		if (input_len < comp_length + 16)
+			return AO_FAIL;
+
+		// Check CRC is correct
+		actual_crc = crc32(0, (unsigned char *)&buf[4+(res_area/4)], comp_length);
+		if (actual_crc != comp_crc)
+			return AO_FAIL;
+
+		// Decompress data if any
+		decomp_dat = (uint8_t *) malloc(DECOMP_MAX_SIZE);
+		decomp_length = DECOMP_MAX_SIZE;
+		if (uncompress(decomp_dat, &decomp_length, (unsigned char *)&buf[4+(res_area/4)], comp_length) != Z_OK)
+		{
+			free(decomp_dat);
+			return AO_FAIL;
+		}
+
+		// Resize memory buffer to what we actually need
+		decomp_dat = (uint8_t *) realloc(decomp_dat, (size_t)decomp_length + 1);
+	}
+	else
+	{
+		decomp_dat = nullptr;
+		decomp_length =  0;
+	}
+
+	// Make structure
+	*c = corlett_alloc();
+	if (!(*c))
+	{
+		free(decomp_dat);
+		return AO_FAIL;
+	}
+
+	// set reserved section pointer
+	(*c)->res_section = &buf[4];
+	(*c)->res_size = res_area;
+
+	// Return it
+	if (output != nullptr && size != nullptr)
+	{
+		*output = decomp_dat;
+		*size = decomp_length;
+	}
+	else
+		free(decomp_dat);
+
+	// Next check for tags
+	input_len -= (comp_length + 16 + res_area);
+	if (input_len < 5)
+		return AO_SUCCESS;
+
+//	printf("\n\nNew corlett: input len %d\n", input_len);
+
+	tag_dec = input + (comp_length + res_area + 16);
+	corlett_parse_tags(tag_dec, input_len, *c);
 
 	// Bingo
 	return AO_SUCCESS;
 }
 
+// Tags only: the header tells where the tag area starts, so callers can skip
+// reading (let alone decompressing) the reserved area and the program
+int corlett_tags_offset(uint8_t *header, uint32_t *offset)
+{
+	uint32_t *buf = (uint32_t *)header;
+
+	if ((header[0] != 'P') || (header[1] != 'S') || (header[2] != 'F'))
+	{
+		return AO_FAIL;
+	}
+
+	*offset = 16 + LE32(buf[1]) + LE32(buf[2]);
+	return AO_SUCCESS;
+}
+
+int corlett_decode_tags(uint8_t *tags, uint32_t tags_len, corlett_t **c)
+{
+	*c = corlett_alloc();
+	if (!(*c))
+		return AO_FAIL;
+
+	corlett_parse_tags(tags, tags_len, *c);
+	return AO_SUCCESS;
+}
+
 uint32_t psfTimeToMS(char *str)
 {
 	int x, c=0;
@@ -30,6 +30,18 @@ typedef struct {
 	uint32_t res_size;
 } corlett_t;
 
+// A decoded library file (see ao_get_lib)
+struct corlett_lib {
+	Index<char> raw;		// file contents; c->res_section points in here
+	corlett_t *c = nullptr;
+	uint8_t *program = nullptr;	// decompressed program section
+	uint64_t program_len = 0;
+
+	~corlett_lib() { free(c); free(program); }
+};
+
 int corlett_decode(uint8_t *input, uint32_t input_len, uint8_t **output, uint64_t *size, corlett_t **c);
+int corlett_tags_offset(uint8_t *header, uint32_t *offset);
+int corlett_decode_tags(uint8_t *tags, uint32_t tags_len, corlett_t **c);
 uint32_t psfTimeToMS(char *str);
 
@@ -56,7 +56,7 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 	uint8_t *file, *lib_decoded, *alib_decoded;
 	uint32_t offset, plength, PC, SP, GP, lengthMS, fadeMS;
 	uint64_t file_len, lib_len, alib_len;
-	corlett_t *lib;
+	corlett_lib *lib;
 	int i;
 	union cpuinfo mipsinfo;
 
@@ -112,18 +112,18 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 		printf("Loading library: %s\n", c->lib);
 		#endif
 
-		Index<char> buf = ao_get_lib(c->lib);
+		lib = ao_get_lib(c->lib);
 
-		if (!buf.len())
+		if (!lib)
 			return AO_FAIL;
 
-		if (corlett_decode((uint8_t *)buf.begin(), buf.len(), &lib_decoded, &lib_len, &lib) != AO_SUCCESS)
-			return AO_FAIL;
+		lib_decoded = lib->program;
+		lib_len = lib->program_len;
 
-		if (strncmp((char *)lib_decoded, "PS-X EXE", 8))
+		if (!lib_decoded || strncmp((char *)lib_decoded, "PS-X EXE", 8))
 		{
 			printf("Major error!  PSF was OK, but referenced library is not!\n");
-			free(lib);
+			ao_release_lib(lib);
 			return AO_FAIL;
 		}
 
@@ -133,17 +133,17 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 		offset = lib_decoded[0x1c] | lib_decoded[0x1d]<<8 | lib_decoded[0x1e]<<16 | lib_decoded[0x1f]<<24;
 		printf("Text section size: %x\n", offset);
 		printf("Region: [%s]\n", &lib_decoded[0x4c]);
-		printf("refresh: [%s]\n", lib->inf_refresh);
+		printf("refresh: [%s]\n", lib->c->inf_refresh);
 		#endif
 
 		// if the original file had no refresh tag, give the lib a shot
 		if (psf_refresh == -1)
 		{
-			if (lib->inf_refresh[0] == '5')
+			if (lib->c->inf_refresh[0] == '5')
 			{
 				psf_refresh = 50;
 			}
-			if (lib->inf_refresh[0] == '6')
+			if (lib->c->inf_refresh[0] == '6')
 			{
 				psf_refresh = 60;
 			}
@@ -173,8 +173,7 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 		#endif
 		memcpy(&psx_ram[offset/4], lib_decoded + 2048, plength);
 
-		// Dispose the corlett structure for the lib - we don't use it
-		free(lib);
+		ao_release_lib(lib);
 	}
 
 	// now patch the main file into RAM OVER the libraries (but not the aux lib)
@@ -197,18 +196,18 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 			printf("Loading aux library: %s\n", c->libaux[i]);
 			#endif
 
-			Index<char> buf = ao_get_lib(c->libaux[i]);
+			lib = ao_get_lib(c->libaux[i]);
 
-			if (!buf.len())
+			if (!lib)
 				return AO_FAIL;
 
-			if (corlett_decode((uint8_t *)buf.begin(), buf.len(), &alib_decoded, &alib_len, &lib) != AO_SUCCESS)
-				return AO_FAIL;
+			alib_decoded = lib->program;
+			alib_len = lib->program_len;
 
-			if (strncmp((char *)alib_decoded, "PS-X EXE", 8))
+			if (!alib_decoded || strncmp((char *)alib_decoded, "PS-X EXE", 8))
 			{
 				printf("Major error!  PSF was OK, but referenced library is not!\n");
-				free(lib);
+				ao_release_lib(lib);
 				return AO_FAIL;
 			}
 
@@ -231,13 +230,11 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 
 			memcpy(&psx_ram[offset/4], alib_decoded + 2048, plength);
 
-			// Dispose the corlett structure for the lib - we don't use it
-			free(lib);
+			ao_release_lib(lib);
 		}
 	}
 
 	free(file);
-//	free(lib_decoded);
 
 	// Finally, set psfby tag
 	strcpy(psfby, "n/a");
@@ -341,11 +338,20 @@ int32_t psf_execute(void (*update)(const void *, int))
 		}
 
 		psx_hw_frame();
+		ao_frame_done();
 	}
 
 	return AO_SUCCESS;
 }
 
+int32_t psf_get_state(ao_state_block *blocks)
+{
+	int32_t count = mips_get_state(blocks);
+	count += psx_hw_get_state(blocks + count);
+	count += SPUgetstate(blocks + count);
+	return count;
+}
+
 int32_t psf_stop(void)
 {
 	SPUclose();
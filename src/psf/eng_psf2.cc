@@ -77,7 +77,7 @@ static uint32_t initialPC, initialSP;
 static uint32_t loadAddr, lengthMS, fadeMS;
 
 static uint8_t *filesys[MAX_FS];
-static Index<char> lib_raw_file;
+static corlett_lib *lib_file;
 static uint32_t fssize[MAX_FS];
 static int num_fs;
 
@@ -436,12 +436,11 @@ uint32_t psf2_load_file(const char *file, uint8_t *buf, uint32_t buflen)
 
 int32_t psf2_start(uint8_t *buffer, uint32_t length)
 {
-	uint8_t *file, *lib_decoded;
+	uint8_t *file;
 	uint32_t irx_len;
-	uint64_t file_len, lib_len;
+	uint64_t file_len;
 	uint8_t *buf;
 	union cpuinfo mipsinfo;
-	corlett_t *lib;
 
 	loadAddr = 0x23f00;	// this value makes allocations work out similarly to how they would
 				// in Highly Experimental (as per Shadow Hearts' hard-coded assumptions)
@@ -473,22 +472,21 @@ int32_t psf2_start(uint8_t *buffer, uint32_t length)
 		printf("Loading library: %s\n", c->lib);
 		#endif
 
-		lib_raw_file = ao_get_lib(c->lib);
+		if (lib_file)	// left over from a failed start
+			ao_release_lib(lib_file);
 
-		if (!lib_raw_file.len())
-			return AO_FAIL;
+		lib_file = ao_get_lib(c->lib);
 
-		if (corlett_decode((uint8_t *)lib_raw_file.begin(), lib_raw_file.len(),
-		 &lib_decoded, &lib_len, &lib) != AO_SUCCESS)
+		if (!lib_file)
 			return AO_FAIL;
 
 		#if DEBUG_LOADER
-		printf("Lib FS section: size %x bytes\n", lib->res_size);
+		printf("Lib FS section: size %x bytes\n", lib_file->c->res_size);
 		#endif
 
 		num_fs++;
-		filesys[1] = (uint8_t *)lib->res_section;
- 		fssize[1] = lib->res_size;
+		filesys[1] = (uint8_t *)lib_file->c->res_section;
+ 		fssize[1] = lib_file->c->res_size;
 	}
 
 	// dump all files
@@ -574,15 +572,33 @@ int32_t psf2_execute(void (*update)(const void *, int))
 		}
 
 		ps2_hw_frame();
+		ao_frame_done();
 	}
 
 	return AO_SUCCESS;
 }
 
+int32_t psf2_get_state(ao_state_block *blocks)
+{
+	int32_t count = mips_get_state(blocks);
+	count += psx_hw_get_state(blocks + count);
+	count += SPU2getstate(blocks + count);
+
+	// modules loaded by the IOP are placed after each other
+	const ao_state_block load_addr = STATE_BLOCK(loadAddr);
+	blocks[count ++] = load_addr;
+
+	return count;
+}
+
 int32_t psf2_stop(void)
 {
 	SPU2close();
-	lib_raw_file.clear();
+	if (lib_file)
+	{
+		ao_release_lib(lib_file);
+		lib_file = nullptr;
+	}
 	free(c);
 
 	return AO_SUCCESS;
@@ -49,6 +49,11 @@
 
 // REVERB info and timing vars...
 
+// resampling history (file scope, so that it can be saved with the SPU state)
+static s32 downbuf[2][8];
+static s32 upbuf[2][8];
+static int dbpos=0,ubpos=0;
+
 ////////////////////////////////////////////////////////////////////////
 
 static inline s64 g_buffer(int iOff)                          // get_buffer content helper: takes care about wraps
@@ -88,9 +93,6 @@ static inline void s_buffer1(int iOff,int iVal)                // set_buffer (+1
 
 static inline void MixREVERBLeftRight(s32 *oleft, s32 *oright, s32 inleft, s32 inright)
 {
-   static s32 downbuf[2][8];
-   static s32 upbuf[2][8];
-   static int dbpos=0,ubpos=0;
    static s32 downcoeffs[8]={ /* Symmetry is sexy. */
 				1283,5344,10895,15243,
 				15243,10895,5344,1283
@@ -194,6 +194,11 @@ int psf_seek(u32 t)
  return(0);
 }
 
+u32 psf_tell(void)
+{
+ return (u64)sampcount*10/441;
+}
+
 static int endless;
 void setendless(int e)
 {
@@ -666,6 +671,37 @@ int SPUshutdown(void)
  return 0;
 }
 
+////////////////////////////////////////////////////////////////////////
+// SPUGETSTATE: list the memory to save for a checkpoint (the seek target,
+// song length and the mixing buffer are left alone)
+////////////////////////////////////////////////////////////////////////
+
+int SPUgetstate(ao_state_block *blocks)
+{
+ const ao_state_block state[] =
+  {
+   STATE_BLOCK(regArea),
+   STATE_BLOCK(spuMem),
+   STATE_BLOCK(pSpuIrq),
+   STATE_BLOCK(s_chan),
+   STATE_BLOCK(rvb),
+   STATE_BLOCK(dwNoiseVal),
+   STATE_BLOCK(spuCtrl),
+   STATE_BLOCK(spuStat),
+   STATE_BLOCK(spuIrq),
+   STATE_BLOCK(spuAddr),
+   STATE_BLOCK(ttemp),
+   STATE_BLOCK(sampcount),
+   STATE_BLOCK(downbuf),
+   STATE_BLOCK(upbuf),
+   STATE_BLOCK(dbpos),
+   STATE_BLOCK(ubpos)
+  };
+
+ memcpy(blocks,state,sizeof(state));
+ return sizeof(state)/sizeof(state[0]);
+}
+
 void SPUinjectRAMImage(u16 *pIncoming)
 {
 	int i;
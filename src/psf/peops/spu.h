@@ -27,6 +27,7 @@
 void SPUirq(void);
 
 int psf_seek(uint32_t t);
+uint32_t psf_tell(void);
 void setendless(int e);
 void setlength(int32_t stop, int32_t fade);
 
@@ -37,6 +38,7 @@ int SPUopen(void);
 int SPUclose(void);
 int SPUshutdown(void);
 void SPUinjectRAMImage(uint16_t *pIncoming);
+int SPUgetstate(ao_state_block *blocks);
 void SPUreadDMAMem(uint32_t usPSXMem, int iSize);
 void SPUwriteDMAMem(uint32_t usPSXMem, int iSize);
 uint16_t SPUreadRegister(uint32_t reg);
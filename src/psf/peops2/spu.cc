@@ -337,6 +337,11 @@ int psf2_seek(u32 t)
  return(0);
 }
 
+u32 psf2_tell(void)
+{
+ return (u64)sampcount*10/441;
+}
+
 static int endless;
 void setendless2(int e)
 {
@@ -1000,6 +1005,44 @@ EXPORT_GCC void CALLBACK SPU2close(void)
  RemoveStreams();                                      // no more streaming
 }
 
+////////////////////////////////////////////////////////////////////////
+// SPUGETSTATE: list the memory to save for a checkpoint (the seek target,
+// song length and the mixing buffer are left alone)
+////////////////////////////////////////////////////////////////////////
+
+int SPU2getstate(ao_state_block *blocks)
+{
+ const ao_state_block state[] =
+  {
+   STATE_BLOCK(regArea),
+   STATE_BLOCK(spuMem),
+   STATE_BLOCK(pSpuIrq),
+   STATE_BLOCK(s_chan),
+   STATE_BLOCK(rvb),
+   STATE_BLOCK(dwNoiseVal),
+   STATE_BLOCK(spuCtrl2),
+   STATE_BLOCK(spuStat2),
+   STATE_BLOCK(spuIrq2),
+   STATE_BLOCK(spuAddr2),
+   STATE_BLOCK(spuRvbAddr2),
+   STATE_BLOCK(spuRvbAEnd2),
+   STATE_BLOCK(dwNewChannel2),
+   STATE_BLOCK(dwEndChannel2),
+   STATE_BLOCK(SSumR),
+   STATE_BLOCK(SSumL),
+   STATE_BLOCK(iCycle),
+   STATE_BLOCK(lastch),
+   STATE_BLOCK(iSecureStart),
+   STATE_BLOCK(sampcount),
+   STATE_BLOCK(iSpuAsyncWait),
+   {sRVBStart[0],NSSIZE*2*sizeof(int)},                // reverb mixing buffers
+   {sRVBStart[1],NSSIZE*2*sizeof(int)}
+  };
+
+ memcpy(blocks,state,sizeof(state));
+ return sizeof(state)/sizeof(state[0]);
+}
+
 #if 0
 ////////////////////////////////////////////////////////////////////////
 // SPUSHUTDOWN: called by main emu on final exit
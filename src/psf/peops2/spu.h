@@ -36,3 +36,5 @@ void SPU2async(void (*update)(const void *, int));
 void SPU2close(void);
 
 int psf2_seek(uint32_t t);
+uint32_t psf2_tell(void);
+int SPU2getstate(ao_state_block *blocks);
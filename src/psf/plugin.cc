@@ -24,9 +24,11 @@
     SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
@@ -61,6 +63,7 @@ public:
         .with_exts(exts)) {}
 
     bool init();
+    void cleanup();
 
     bool is_our_file(const char *filename, VFSFile &file);
     bool read_tag(const char *filename, VFSFile &file, Tuple &tuple, Index<char> *image);
@@ -84,19 +87,23 @@ typedef struct {
     int32_t (*start)(uint8_t *buffer, uint32_t length);
     int32_t (*stop)(void);
     int32_t (*seek)(uint32_t);
+    uint32_t (*tell)(void);
     int32_t (*execute)(void (*update)(const void *, int));
+    int32_t (*get_state)(ao_state_block *blocks); /* nullptr: no checkpoints */
 } PSFEngineFunctors;
 
 static PSFEngineFunctors psf_functor_map[ENG_COUNT] = {
-    {nullptr, nullptr, nullptr, nullptr},
-    {psf_start, psf_stop, psf_seek, psf_execute},
-    {psf2_start, psf2_stop, psf2_seek, psf2_execute},
-    {spx_start, spx_stop, psf_seek, spx_execute},
+    {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+    {psf_start, psf_stop, psf_seek, psf_tell, psf_execute, psf_get_state},
+    {psf2_start, psf2_stop, psf2_seek, psf2_tell, psf2_execute, psf2_get_state},
+    {spx_start, spx_stop, psf_seek, psf_tell, spx_execute, nullptr},
 };
 
 const char* const PSFPlugin::defaults[] =
 {
     "ignore_length", "FALSE",
+    "checkpoint_interval", "10",
+    "checkpoint_memory", "64",
     nullptr
 };
 
@@ -112,10 +119,107 @@ static String dirpath;
 bool stop_flag = false;
 
 /* The emulation engine can only seek forward, not back.  This variable is set
- * a non-negative time (milliseconds) when the song is to be restarted in order
- * to seek backward. */
+ * a non-negative time (milliseconds) when the song is to be restored from a
+ * checkpoint, or else restarted, in order to seek backward. */
 static int reverse_seek;
 
+/* Checkpoints are snapshots of the whole emulator state, saved every few
+ * seconds of playback so that a seek can resume from the nearest one rather
+ * than emulating the song again from the beginning.  When the memory budget is
+ * used up, every other checkpoint is dropped and the interval doubled. */
+struct Checkpoint {
+    int time; /* milliseconds */
+    Index<char> state;
+};
+
+static Index<Checkpoint> checkpoints;
+static int checkpoint_interval, checkpoint_limit, next_checkpoint;
+
+static void reset_checkpoints()
+{
+    checkpoints.clear();
+    checkpoint_interval = aud_get_int("psf", "checkpoint_interval") * 1000;
+    checkpoint_limit = 0;
+    next_checkpoint = 0;
+}
+
+/* ao_frame_done: called by the engine between frames */
+void ao_frame_done()
+{
+    if (!checkpoint_interval || !f->get_state)
+        return;
+
+    int time = f->tell();
+    if (time < next_checkpoint)
+        return;
+
+    ao_state_block blocks[MAX_STATE_BLOCKS];
+    int count = f->get_state(blocks);
+
+    int64_t size = 0;
+    for (int i = 0; i < count; i++)
+        size += blocks[i].size;
+
+    if (!checkpoint_limit)
+    {
+        int64_t budget = (int64_t)aud_get_int("psf", "checkpoint_memory") << 20;
+        checkpoint_limit = aud::max(2, (int)(budget / size));
+    }
+
+    Checkpoint &cp = checkpoints.append();
+    cp.time = time;
+    cp.state.resize(size);
+
+    char *out = cp.state.begin();
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(out, blocks[i].ptr, blocks[i].size);
+        out += blocks[i].size;
+    }
+
+    if (checkpoints.len() >= checkpoint_limit)
+    {
+        for (int i = 1; i < checkpoints.len(); i++)
+            checkpoints.remove(i, 1);
+
+        checkpoint_interval *= 2;
+    }
+
+    next_checkpoint = checkpoints[checkpoints.len() - 1].time + checkpoint_interval;
+}
+
+/* latest checkpoint at or before <time>, if starting from it saves anything
+ * over continuing from the current position */
+static const Checkpoint *find_checkpoint(int time)
+{
+    const Checkpoint *found = nullptr;
+    for (const Checkpoint &cp : checkpoints)
+    {
+        if (cp.time > time)
+            break;
+        found = &cp;
+    }
+
+    int current = f->tell();
+    if (found && time >= current && found->time <= current)
+        return nullptr;
+
+    return found;
+}
+
+static void load_checkpoint(const Checkpoint *cp)
+{
+    ao_state_block blocks[MAX_STATE_BLOCKS];
+    int count = f->get_state(blocks);
+
+    const char *in = cp->state.begin();
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(blocks[i].ptr, in, blocks[i].size);
+        in += blocks[i].size;
+    }
+}
+
 static PSFEngine psf_probe(const char *buf, int len)
 {
     if (len < 4)
@@ -136,21 +240,174 @@ static PSFEngine psf_probe(const char *buf, int len)
     return ENG_NONE;
 }
 
+/* Every track of a set references the same _lib file, often several megabytes
+ * once decompressed, so decoded libraries are kept around between songs.  An
+ * entry is identified by path, size and modification time; unused entries are
+ * dropped, least recently used first, when the total exceeds LIB_CACHE_SIZE. */
+#define LIB_CACHE_SIZE (64 << 20)
+
+struct LibCacheEntry {
+    String path;
+    int64_t size, mtime;
+    corlett_lib *lib;
+    int users;
+    unsigned stamp;
+};
+
+static Index<LibCacheEntry> lib_cache;
+static unsigned lib_cache_stamp;
+static pthread_mutex_t lib_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t lib_mtime(const char *path)
+{
+    struct stat st;
+    StringBuf local = uri_to_filename(path);
+    return (local && !stat(local, &st)) ? (int64_t)st.st_mtime : 0;
+}
+
+static LibCacheEntry *lib_cache_lookup(const char *path, int64_t size, int64_t mtime)
+{
+    for (LibCacheEntry &entry : lib_cache)
+    {
+        if (!strcmp(entry.path, path) && entry.size == size && entry.mtime == mtime)
+            return &entry;
+    }
+
+    return nullptr;
+}
+
+/* call with lib_cache_mutex held */
+static void lib_cache_trim()
+{
+    while (1)
+    {
+        int64_t total = 0;
+        int oldest = -1;
+
+        for (int i = 0; i < lib_cache.len(); i++)
+        {
+            const LibCacheEntry &entry = lib_cache[i];
+            total += entry.lib->raw.len() + entry.lib->program_len;
+
+            if (!entry.users && (oldest < 0 || entry.stamp < lib_cache[oldest].stamp))
+                oldest = i;
+        }
+
+        if (total <= LIB_CACHE_SIZE || oldest < 0)
+            break;
+
+        delete lib_cache[oldest].lib;
+        lib_cache.remove(oldest, 1);
+    }
+}
+
 /* ao_get_lib: called to load secondary files */
-Index<char> ao_get_lib(char *filename)
+corlett_lib *ao_get_lib(char *filename)
 {
-    VFSFile file(filename_build({dirpath, filename}), "r");
-    return file ? file.read_all() : Index<char>();
+    StringBuf path = filename_build({dirpath, filename});
+    VFSFile file(path, "r");
+    if (!file)
+        return nullptr;
+
+    int64_t size = file.fsize();
+    int64_t mtime = lib_mtime(path);
+
+    pthread_mutex_lock(&lib_cache_mutex);
+
+    LibCacheEntry *entry = lib_cache_lookup(path, size, mtime);
+    if (entry)
+    {
+        entry->users++;
+        entry->stamp = ++lib_cache_stamp;
+        pthread_mutex_unlock(&lib_cache_mutex);
+        return entry->lib;
+    }
+
+    pthread_mutex_unlock(&lib_cache_mutex);
+
+    corlett_lib *lib = new corlett_lib;
+    lib->raw = file.read_all();
+
+    if (!lib->raw.len() || corlett_decode((uint8_t *)lib->raw.begin(),
+     lib->raw.len(), &lib->program, &lib->program_len, &lib->c) != AO_SUCCESS)
+    {
+        delete lib;
+        return nullptr;
+    }
+
+    pthread_mutex_lock(&lib_cache_mutex);
+
+    /* another thread may have decoded the same file meanwhile */
+    entry = lib_cache_lookup(path, size, mtime);
+    if (entry)
+    {
+        delete lib;
+        lib = entry->lib;
+        entry->users++;
+        entry->stamp = ++lib_cache_stamp;
+    }
+    else
+    {
+        LibCacheEntry &added = lib_cache.append();
+        added.path = String(path);
+        added.size = size;
+        added.mtime = mtime;
+        added.lib = lib;
+        added.users = 1;
+        added.stamp = ++lib_cache_stamp;
+
+        lib_cache_trim();
+    }
+
+    pthread_mutex_unlock(&lib_cache_mutex);
+    return lib;
+}
+
+void ao_release_lib(corlett_lib *lib)
+{
+    pthread_mutex_lock(&lib_cache_mutex);
+
+    for (LibCacheEntry &entry : lib_cache)
+    {
+        if (entry.lib == lib)
+            entry.users--;
+    }
+
+    lib_cache_trim();
+    pthread_mutex_unlock(&lib_cache_mutex);
+}
+
+void PSFPlugin::cleanup()
+{
+    for (LibCacheEntry &entry : lib_cache)
+        delete entry.lib;
+
+    lib_cache.clear();
 }
 
 bool PSFPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Index<char> *image)
 {
-    Index<char> buf = file.read_all ();
-    if (!buf.len())
+    /* only the tag area at the end is needed, so skip over the program */
+    uint8_t header[16];
+    uint32_t offset;
+    if (file.fread(header, 1, sizeof header) != sizeof header ||
+     corlett_tags_offset(header, &offset) != AO_SUCCESS)
         return false;
 
+    /* a file without tags ends at the offset, and some transports
+     * cannot seek to the very end */
+    Index<char> buf;
+    int64_t size = file.fsize();
+    if (size < 0 || offset < size)
+    {
+        if (file.fseek(offset, VFS_SEEK_SET) < 0)
+            return false;
+
+        buf = file.read_all ();
+    }
+
     corlett_t *c;
-    if (corlett_decode((uint8_t *)buf.begin(), buf.len(), nullptr, nullptr, &c) != AO_SUCCESS)
+    if (corlett_decode_tags((uint8_t *)buf.begin(), buf.len(), &c) != AO_SUCCESS)
         return false;
 
     tuple.set_int(Tuple::Length, psfTimeToMS(c->inf_length) + psfTimeToMS(c->inf_fade));
@@ -200,33 +457,52 @@ bool PSFPlugin::play(const char *filename, VFSFile &file)
     open_audio(FMT_S16_NE, 44100, 2);
 
     reverse_seek = -1;
+    reset_checkpoints();
 
-    /* This loop will restart playback from the beginning when necessary to seek
-     * backwards in the file (reverse_seek >= 0). */
-    do
+    if (f->start((uint8_t *)buf.begin(), buf.len()) != AO_SUCCESS)
     {
-        if (f->start((uint8_t *)buf.begin(), buf.len()) != AO_SUCCESS)
-        {
-            error = true;
-            goto cleanup;
-        }
-
-        if (reverse_seek >= 0)
-        {
-            f->seek(reverse_seek); /* should never fail here */
-            reverse_seek = -1;
-        }
+        error = true;
+        goto cleanup;
+    }
 
+    /* This loop will go back to a checkpoint, or else restart playback from
+     * the beginning, when necessary to seek in the file (reverse_seek >= 0). */
+    while (1)
+    {
         stop_flag = false;
 
         f->execute(update);
-        f->stop();
+
+        if (reverse_seek < 0)
+            break;
+
+        const Checkpoint *cp = find_checkpoint(reverse_seek);
+        if (cp)
+            load_checkpoint(cp);
+        else
+        {
+            /* the restarted engine has reloaded the song, so checkpoints
+             * pointing into the old copy can't be used any more */
+            reset_checkpoints();
+
+            f->stop();
+            if (f->start((uint8_t *)buf.begin(), buf.len()) != AO_SUCCESS)
+            {
+                error = true;
+                goto cleanup;
+            }
+        }
+
+        f->seek(reverse_seek); /* should never fail here */
+        reverse_seek = -1;
     }
-    while (reverse_seek >= 0);
+
+    f->stop();
 
 cleanup:
     f = nullptr;
     dirpath = String ();
+    checkpoints.clear();
 
     return ! error;
 }
@@ -243,7 +519,8 @@ void PSFPlugin::update(const void *data, int bytes)
 
     if (seek >= 0)
     {
-        if (!f->seek(seek))
+        /* a checkpoint past the current position also helps seeking forward */
+        if (find_checkpoint(seek) || !f->seek(seek))
         {
             reverse_seek = seek;
             stop_flag = true;
@@ -269,6 +546,13 @@ const char *const PSFPlugin::exts[] = { "psf", "minipsf", "psf2", "minipsf2", "s
 const PreferencesWidget PSFPlugin::widgets[] = {
     WidgetLabel(N_("<b>OpenPSF Configuration</b>")),
     WidgetCheck(N_("Ignore length from file"), WidgetBool("psf", "ignore_length")),
+    WidgetLabel(N_("<b>Seeking</b>")),
+    WidgetSpin(N_("Save a checkpoint every:"),
+        WidgetInt("psf", "checkpoint_interval"),
+        {0, 300, 1, N_("seconds")}),
+    WidgetSpin(N_("Memory for checkpoints:"),
+        WidgetInt("psf", "checkpoint_memory"),
+        {8, 1024, 8, N_("MiB")})
 };
 
 const PluginPreferences PSFPlugin::prefs = {{widgets}};
@@ -2975,6 +2975,18 @@ void mips_set_icount(int count)
 	mips_ICount = count;
 }
 
+int mips_get_state(ao_state_block *blocks)
+{
+	const ao_state_block state[] =
+	{
+		STATE_BLOCK(mipscpu),
+		STATE_BLOCK(mips_ICount)
+	};
+
+	memcpy(blocks, state, sizeof(state));
+	return sizeof(state) / sizeof(state[0]);
+}
+
 
 #if (HAS_PSXCPU)
 /**************************************************************************
@@ -291,6 +291,7 @@ extern int psf_refresh;
 int32_t psf_start(uint8_t *buffer, uint32_t length);
 int32_t psf_execute(void (*update)(const void *, int));
 int32_t psf_stop(void);
+int32_t psf_get_state(ao_state_block *blocks);
 
 /* eng_psf2.cc */
 uint32_t psf2_load_elf(uint8_t *start, uint32_t len);
@@ -301,6 +302,7 @@ int32_t psf2_stop(void);
 int32_t psf2_command(int32_t, int32_t);
 uint32_t psf2_get_loadaddr(void);
 void psf2_set_loadaddr(uint32_t addr);
+int32_t psf2_get_state(ao_state_block *blocks);
 
 /* eng_spx.cc */
 int32_t spx_start(uint8_t *buffer, uint32_t length);
@@ -323,6 +325,7 @@ void mips_set_status(uint32_t status);
 uint32_t mips_get_ePC(void);
 int mips_get_icount(void);
 void mips_set_icount(int count);
+int mips_get_state(ao_state_block *blocks);
 
 /* psx_hw.cc */
 extern uint32_t psx_ram[((2*1024*1024)/4)+4];
@@ -338,6 +341,7 @@ void ps2_hw_frame(void);
 void psx_hw_init(void);
 void psx_bios_hle(uint32_t pc);
 void psx_hw_runcounters(void);
+int psx_hw_get_state(ao_state_block *blocks);
 
 uint8_t program_read_byte_32le(offs_t address);
 uint16_t program_read_word_32le(offs_t address);
@@ -1313,6 +1313,71 @@ void psx_hw_init(void)
 	root_cnts[3].interrupt = 1;
 }
 
+// everything the IOP and its HLE BIOS/OS change while a song plays (the file
+// tables only point into the song's own data, which stays put until it ends)
+int psx_hw_get_state(ao_state_block *blocks)
+{
+	const ao_state_block state[] =
+	{
+		STATE_BLOCK(psx_ram),
+		STATE_BLOCK(psx_scratch),
+		STATE_BLOCK(softcall_target),
+		STATE_BLOCK(filestat),
+		STATE_BLOCK(filedata),
+		STATE_BLOCK(filesize),
+		STATE_BLOCK(filepos),
+		STATE_BLOCK(intr_susp),
+		STATE_BLOCK(sys_time),
+		STATE_BLOCK(timerexp),
+		STATE_BLOCK(iNumLibs),
+		STATE_BLOCK(reglibs),
+		STATE_BLOCK(iNumFlags),
+		STATE_BLOCK(evflags),
+		STATE_BLOCK(iNumSema),
+		STATE_BLOCK(semaphores),
+		STATE_BLOCK(iNumThreads),
+		STATE_BLOCK(iCurThread),
+		STATE_BLOCK(threads),
+		STATE_BLOCK(iop_timers),
+		STATE_BLOCK(iNumTimers),
+		STATE_BLOCK(root_cnts),
+		STATE_BLOCK(Event),
+		STATE_BLOCK(CounterEvent),
+		STATE_BLOCK(spu_delay),
+		STATE_BLOCK(dma_icr),
+		STATE_BLOCK(irq_data),
+		STATE_BLOCK(irq_mask),
+		STATE_BLOCK(dma_timer),
+		STATE_BLOCK(WAI),
+		STATE_BLOCK(dma4_madr),
+		STATE_BLOCK(dma4_bcr),
+		STATE_BLOCK(dma4_chcr),
+		STATE_BLOCK(dma4_delay),
+		STATE_BLOCK(dma7_madr),
+		STATE_BLOCK(dma7_bcr),
+		STATE_BLOCK(dma7_chcr),
+		STATE_BLOCK(dma7_delay),
+		STATE_BLOCK(dma4_cb),
+		STATE_BLOCK(dma7_cb),
+		STATE_BLOCK(dma4_fval),
+		STATE_BLOCK(dma4_flag),
+		STATE_BLOCK(dma7_fval),
+		STATE_BLOCK(dma7_flag),
+		STATE_BLOCK(irq9_cb),
+		STATE_BLOCK(irq9_fval),
+		STATE_BLOCK(irq9_flag),
+		STATE_BLOCK(gpu_stat),
+		STATE_BLOCK(fcnt),
+		STATE_BLOCK(heap_addr),
+		STATE_BLOCK(entry_int),
+		STATE_BLOCK(irq_regs),
+		STATE_BLOCK(irq_mutex)
+	};
+
+	memcpy(blocks, state, sizeof(state));
+	return sizeof(state) / sizeof(state[0]);
+}
+
 void psx_bios_hle(uint32_t pc)
 {
 	uint32_t subcall, status;
@@ -17,9 +17,13 @@
  * the use of this software.
  */
 
+#include <pthread.h>
+#include <string.h>
+
 #include <QApplication>
 #include <QIcon>
 #include <QMimeData>
+#include <QThread>
 #include <QUrl>
 
 #include <libaudcore/audstrings.h>
@@ -297,41 +301,206 @@ QString PlaylistModel::queuePos(int row) const
 
 /* ---------------------------------- */
 
-void PlaylistProxyModel::setFilter(const char * filter)
+/* rows below this are filtered on a single thread */
+static constexpr int s_minRowsPerThread = 16384;
+
+struct FilterSlice
 {
-    m_searchTerms = str_list_to_index(filter, " ");
-    invalidateFilter();
+    const Index<String> * keys;
+    const Index<String> * terms;
+    Index<bool> * accepted;
+    int first, last;
+    bool narrowing;
+};
+
+static bool matchesTerms(const char * key, const Index<String> & terms)
+{
+    for (auto & term : terms)
+    {
+        if (!strstr(key, term))
+            return false;
+    }
+
+    return true;
 }
 
-bool PlaylistProxyModel::filterAcceptsRow(int source_row,
-                                          const QModelIndex &) const
+static void * filterSlice(void * data)
 {
-    if (!m_searchTerms.len())
-        return true;
+    auto slice = (FilterSlice *)data;
 
-    Tuple tuple = m_playlist.entry_tuple(source_row);
+    for (int row = slice->first; row < slice->last; row++)
+    {
+        bool & accepted = (*slice->accepted)[row];
 
-    String strings[] = {tuple.get_str(Tuple::Title),
-                        tuple.get_str(Tuple::Artist),
-                        tuple.get_str(Tuple::Album),
-                        tuple.get_str(Tuple::Basename)};
+        /* when narrowing, rows already filtered out stay out */
+        if (!slice->narrowing || accepted)
+            accepted = matchesTerms((*slice->keys)[row], *slice->terms);
+    }
 
-    for (auto & term : m_searchTerms)
+    return nullptr;
+}
+
+/* true if every row matching <terms> is known to match <prev> as well,
+ * e.g. when the user has typed more characters */
+static bool isNarrowing(const Index<String> & prev, const Index<String> & terms)
+{
+    if (!prev.len())
+        return false;
+
+    for (auto & p : prev)
     {
-        bool found = false;
+        bool covered = false;
 
-        for (auto & s : strings)
+        for (auto & term : terms)
         {
-            if (s && strstr_nocase_utf8(s, term))
+            if (strstr(term, p))
             {
-                found = true;
+                covered = true;
                 break;
             }
         }
 
-        if (!found)
+        if (!covered)
             return false;
     }
 
     return true;
 }
+
+String PlaylistProxyModel::rowKey(int row) const
+{
+    Tuple tuple = m_playlist.entry_tuple(row, Playlist::NoWait);
+
+    String title = tuple.get_str(Tuple::Title);
+    String artist = tuple.get_str(Tuple::Artist);
+    String album = tuple.get_str(Tuple::Album);
+    String basename = tuple.get_str(Tuple::Basename);
+
+    /* the separator keeps a term from matching across two fields */
+    StringBuf key = str_concat({title ? title : "", "\n", artist ? artist : "",
+                                "\n", album ? album : "", "\n",
+                                basename ? basename : ""});
+
+    return String(str_tolower_utf8(key));
+}
+
+void PlaylistProxyModel::filterRows(bool narrowing)
+{
+    int rows = m_keys.len();
+    int threads = aud::clamp(rows / s_minRowsPerThread, 1,
+                             aud::max(QThread::idealThreadCount(), 1));
+
+    Index<FilterSlice> slices;
+    Index<pthread_t> workers;
+
+    for (int i = 0; i < threads; i++)
+        slices.append(FilterSlice{&m_keys, &m_searchTerms, &m_accepted,
+                                  rows * i / threads, rows * (i + 1) / threads,
+                                  narrowing});
+
+    /* the first slice is done on this thread, as is any slice for which
+     * no worker could be started */
+    for (int i = 1; i < threads; i++)
+    {
+        pthread_t worker;
+        if (pthread_create(&worker, nullptr, filterSlice, &slices[i]) == 0)
+            workers.append(worker);
+        else
+            filterSlice(&slices[i]);
+    }
+
+    filterSlice(&slices[0]);
+
+    for (pthread_t & worker : workers)
+        pthread_join(worker, nullptr);
+}
+
+void PlaylistProxyModel::setFilter(const char * filter)
+{
+    auto terms = str_list_to_index(str_tolower_utf8(filter), " ");
+
+    if (!terms.len())
+    {
+        m_searchTerms.clear();
+        m_keys.clear();
+        m_accepted.clear();
+        invalidateFilter();
+        return;
+    }
+
+    bool narrowing = isNarrowing(m_searchTerms, terms);
+
+    /* the cache is built when filtering starts; it follows the rows the
+     * source model has, which can lag behind the playlist until a pending
+     * update arrives, so that later entriesAdded/Removed calls line up */
+    if (!m_searchTerms.len())
+    {
+        int rows = sourceModel() ? sourceModel()->rowCount() : 0;
+
+        m_keys.insert(0, rows);
+        m_accepted.insert(0, rows);
+
+        for (int row = 0; row < rows; row++)
+            m_keys[row] = rowKey(row);
+    }
+
+    m_searchTerms = std::move(terms);
+    filterRows(narrowing);
+    invalidateFilter();
+}
+
+void PlaylistProxyModel::entriesAdded(int row, int count)
+{
+    if (!m_searchTerms.len() || row < 0 || row > m_keys.len() || count < 1)
+        return;
+
+    m_keys.insert(row, count);
+    m_accepted.insert(row, count);
+
+    for (int i = row; i < row + count; i++)
+    {
+        m_keys[i] = rowKey(i);
+        m_accepted[i] = matchesTerms(m_keys[i], m_searchTerms);
+    }
+}
+
+void PlaylistProxyModel::entriesRemoved(int row, int count)
+{
+    if (!m_searchTerms.len() || row < 0 || count < 1)
+        return;
+
+    count = aud::min(count, m_keys.len() - row);
+    if (count < 1)
+        return;
+
+    m_keys.remove(row, count);
+    m_accepted.remove(row, count);
+}
+
+void PlaylistProxyModel::entriesChanged(int row, int count)
+{
+    if (!m_searchTerms.len() || row < 0)
+        return;
+
+    int last = aud::min(row + count, m_keys.len());
+
+    for (int i = row; i < last; i++)
+    {
+        m_keys[i] = rowKey(i);
+        m_accepted[i] = matchesTerms(m_keys[i], m_searchTerms);
+    }
+}
+
+bool PlaylistProxyModel::filterAcceptsRow(int source_row,
+                                          const QModelIndex &) const
+{
+    if (!m_searchTerms.len())
+        return true;
+
+    /* rows the cache does not know about yet are let through until the
+     * playlist update for them arrives */
+    if (source_row < 0 || source_row >= m_accepted.len())
+        return true;
+
+    return m_accepted[source_row];
+}
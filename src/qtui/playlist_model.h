@@ -94,11 +94,25 @@ public:
 
     void setFilter(const char * filter);
 
+    /* keep the filter cache in step with the playlist; these must be called
+     * before the corresponding PlaylistModel functions */
+    void entriesAdded(int row, int count);
+    void entriesRemoved(int row, int count);
+    void entriesChanged(int row, int count);
+
 private:
     bool filterAcceptsRow(int source_row, const QModelIndex &) const;
 
+    String rowKey(int row) const;
+    void filterRows(bool narrowing);
+
     Playlist m_playlist;
     Index<String> m_searchTerms;
+
+    /* case-folded title, artist, album and file name of each entry, and
+     * whether it matches the search terms; kept only while filtering */
+    Index<String> m_keys;
+    Index<bool> m_accepted;
 };
 
 #endif
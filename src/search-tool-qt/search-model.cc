@@ -19,6 +19,9 @@
 
 #include "search-model.h"
 
+#include <string.h>
+#include <algorithm>
+
 #include <QMimeData>
 #include <QUrl>
 
@@ -135,18 +138,68 @@ void SearchModel::update ()
     }
 }
 
-void SearchModel::destroy_database ()
+/* incremental updates larger than this are done by a background rebuild */
+static constexpr int max_incremental = 5000;
+
+/* terms shorter than this have no trigrams and are matched by scanning */
+static constexpr int min_indexed_len = 3;
+
+static constexpr int max_terms = 31;
+
+/* calls func for each (byte-wise) trigram of a string */
+template<class F>
+static void for_each_trigram (const char * str, F func)
 {
-    m_playlist = Playlist ();
-    m_items.clear ();
-    m_hidden_items = 0;
-    m_database.clear ();
+    auto s = (const unsigned char *) str;
+    int len = strlen (str);
+
+    for (int i = 0; i + 3 <= len; i ++)
+        func (Trigram {s[i] | (s[i + 1] << 8) | ((unsigned) s[i + 2] << 16)});
 }
 
-void SearchModel::add_to_database (int entry, std::initializer_list<Key> keys)
+void SearchDatabase::index_item (Item * item)
+{
+    item->id = m_all_items.len ();
+    m_all_items.append (item);
+    m_marks.append ();
+
+    for_each_trigram (item->folded, [&] (Trigram tri)
+    {
+        Index<int> * list = m_trigrams.lookup (tri);
+        if (! list)
+            list = m_trigrams.add (tri, Index<int> ());
+
+        /* ids are handed out in increasing order, so the list stays sorted;
+         * a trigram occurring more than once in a name is listed once */
+        if (! list->len () || list->end ()[-1] != item->id)
+            list->append (item->id);
+    });
+}
+
+void SearchDatabase::unindex_item (Item * item)
+{
+    for_each_trigram (item->folded, [&] (Trigram tri)
+    {
+        Index<int> * list = m_trigrams.lookup (tri);
+        if (! list)
+            return;
+
+        int * pos = std::lower_bound (list->begin (), list->end (), item->id);
+        if (pos != list->end () && * pos == item->id)
+            list->remove (pos - list->begin (), 1);
+
+        if (! list->len ())
+            m_trigrams.remove (tri);
+    });
+
+    m_all_items[item->id] = nullptr;
+    m_removed_items ++;
+}
+
+void SearchDatabase::add_to_database (int entry, std::initializer_list<Key> keys)
 {
     Item * parent = nullptr;
-    auto hash = & m_database;
+    auto hash = & m_tree;
 
     for (auto & key : keys)
     {
@@ -155,7 +208,16 @@ void SearchModel::add_to_database (int entry, std::initializer_list<Key> keys)
 
         Item * item = hash->lookup (key);
         if (! item)
+        {
             item = hash->add (key, Item (key.field, key.name, parent));
+            index_item (item);
+        }
+
+        if (item->matches.len () && item->matches.end ()[-1] > entry && ! item->unsorted)
+        {
+            item->unsorted = true;
+            m_unsorted.append (item);
+        }
 
         item->matches.append (entry);
 
@@ -164,49 +226,187 @@ void SearchModel::add_to_database (int entry, std::initializer_list<Key> keys)
     }
 }
 
-void SearchModel::create_database (Playlist playlist)
+void SearchDatabase::add_entry (int entry, const Tuple & tuple)
 {
-    destroy_database ();
+    String album_artist = tuple.get_str (Tuple::AlbumArtist);
+    String artist = tuple.get_str (Tuple::Artist);
 
-    int entries = playlist.n_entries ();
+    if (album_artist && album_artist != artist)
+    {
+        /* album and song have different artists;
+         * add separately under respective artists */
+        add_to_database (entry,
+         {{SearchField::Artist, album_artist},
+          {SearchField::Album, tuple.get_str (Tuple::Album)}});
+        /* add Title node under a HiddenAlbum node so that it can
+         * still be searched by album name (without listing the
+         * album twice) */
+        add_to_database (entry,
+         {{SearchField::Artist, artist},
+          {SearchField::HiddenAlbum, tuple.get_str (Tuple::Album)},
+          {SearchField::Title, tuple.get_str (Tuple::Title)}});
+    }
+    else
+    {
+        /* album and song have the same artist;
+         * add hierarchically under that artist */
+        add_to_database (entry,
+         {{SearchField::Artist, artist},
+          {SearchField::Album, tuple.get_str (Tuple::Album)},
+          {SearchField::Title, tuple.get_str (Tuple::Title)}});
+    }
 
-    for (int e = 0; e < entries; e ++)
+    /* add separately under genre */
+    add_to_database (entry,
+     {{SearchField::Genre, tuple.get_str (Tuple::Genre)}});
+
+    m_entries ++;
+}
+
+void SearchDatabase::remove_entries (int at, int removed, int added)
+{
+    int end = at + removed;
+    int shift = added - removed;
+    Index<Item *> emptied;
+
+    for (Item * item : m_all_items)
     {
-        Tuple tuple = playlist.entry_tuple (e, Playlist::NoWait);
-        String album_artist = tuple.get_str (Tuple::AlbumArtist);
-        String artist = tuple.get_str (Tuple::Artist);
+        if (! item)
+            continue;
+
+        int kept = 0;
 
-        if (album_artist && album_artist != artist)
+        for (int entry : item->matches)
         {
-            /* album and song have different artists;
-             * add separately under respective artists */
-            add_to_database (e,
-             {{SearchField::Artist, album_artist},
-              {SearchField::Album, tuple.get_str (Tuple::Album)}});
-            /* add Title node under a HiddenAlbum node so that it can
-             * still be searched by album name (without listing the
-             * album twice) */
-            add_to_database (e,
-             {{SearchField::Artist, artist},
-              {SearchField::HiddenAlbum, tuple.get_str (Tuple::Album)},
-              {SearchField::Title, tuple.get_str (Tuple::Title)}});
+            if (entry < at)
+                item->matches[kept ++] = entry;
+            else if (entry >= end)
+                item->matches[kept ++] = entry + shift;
         }
+
+        item->matches.remove (kept, -1);
+
+        if (! kept)
+            emptied.append (item);
+    }
+
+    /* an item's songs are a subset of its parent's, so the descendants of
+     * an emptied item are emptied too; removing the topmost ones from the
+     * tree frees the rest, so find those before freeing anything */
+    Index<Item *> topmost;
+
+    for (Item * item : emptied)
+    {
+        unindex_item (item);
+
+        if (! item->parent || item->parent->matches.len ())
+            topmost.append (item);
+    }
+
+    for (Item * item : topmost)
+    {
+        auto & hash = item->parent ? item->parent->children : m_tree;
+        hash.remove (Key {item->field, item->name});
+    }
+
+    m_entries -= removed;
+}
+
+void SearchDatabase::sort_matches ()
+{
+    for (Item * item : m_unsorted)
+    {
+        item->matches.sort ([] (const int & a, const int & b)
+            { return a - b; });
+        item->unsorted = false;
+    }
+
+    m_unsorted.clear ();
+}
+
+SearchDatabase::Mark & SearchDatabase::mark (int id)
+{
+    Mark & mark = m_marks[id];
+    if (mark.serial != m_serial)
+        mark = {m_serial, 0, false};
+
+    return mark;
+}
+
+/* finds the items whose own name contains a term, by intersecting the
+ * posting lists of the term's trigrams and then checking the survivors */
+void SearchDatabase::find_term (const char * term, unsigned bit, Index<int> & found)
+{
+    Index<const Index<int> *> lists;
+    bool missing = false;
+
+    for_each_trigram (term, [&] (Trigram tri)
+    {
+        const Index<int> * list = m_trigrams.lookup (tri);
+        if (list)
+            lists.append (list);
         else
+            missing = true;
+    });
+
+    /* some trigram does not occur anywhere */
+    if (missing)
+        return;
+
+    lists.sort ([] (const Index<int> * const & a, const Index<int> * const & b)
+        { return a->len () - b->len (); });
+
+    for (int id : * lists[0])
+    {
+        bool in_all = true;
+
+        for (int i = 1; i < lists.len () && in_all; i ++)
+            in_all = std::binary_search (lists[i]->begin (), lists[i]->end (), id);
+
+        if (in_all && strstr (m_all_items[id]->folded, term))
         {
-            /* album and song have the same artist;
-             * add hierarchically under that artist */
-            add_to_database (e,
-             {{SearchField::Artist, artist},
-              {SearchField::Album, tuple.get_str (Tuple::Album)},
-              {SearchField::Title, tuple.get_str (Tuple::Title)}});
+            mark (id).terms |= bit;
+            found.append (id);
         }
+    }
+}
+
+/* checks an item and its descendants, any of which may match because
+ * the remaining terms are found in their own names or their ancestors' */
+void SearchDatabase::search_subtree (Item & item, const Index<String> & terms,
+ unsigned indexed, Index<const Item *> & results)
+{
+    Mark & item_mark = mark (item.id);
+
+    /* an item may be reached both directly and through an ancestor */
+    if (item_mark.visited)
+        return;
+
+    item_mark.visited = true;
 
-        /* add separately under genre */
-        add_to_database (e,
-         {{SearchField::Genre, tuple.get_str (Tuple::Genre)}});
+    bool matched = true;
+
+    for (int t = 0; t < terms.len () && matched; t ++)
+    {
+        unsigned bit = 1u << t;
+        matched = false;
+
+        for (const Item * i = & item; i && ! matched; i = i->parent)
+        {
+            if (indexed & bit)
+                matched = (mark (i->id).terms & bit);
+            else
+                matched = strstr (i->folded, terms[t]);
+        }
     }
 
-    m_playlist = playlist;
+    /* adding an item with exactly one child is redundant, so avoid it */
+    if (matched && item.children.n_items () != 1 &&
+     item.field != SearchField::HiddenAlbum)
+        results.append (& item);
+
+    item.children.iterate ([&] (const Key & key, Item & child)
+        { search_subtree (child, terms, indexed, results); });
 }
 
 static void search_recurse (SimpleHash<Key, Item> & domain,
@@ -237,6 +437,183 @@ static void search_recurse (SimpleHash<Key, Item> & domain,
     });
 }
 
+void SearchDatabase::search (const Index<String> & terms,
+ Index<const Item *> & results)
+{
+    if (terms.len () > max_terms)
+        return;
+
+    m_serial ++;
+
+    /* look up each term that is long enough in the index, and start from
+     * whichever of them occurs in the fewest names */
+    unsigned indexed = 0;
+    Index<int> start;
+    bool have_start = false;
+
+    for (int t = 0; t < terms.len (); t ++)
+    {
+        if (strlen (terms[t]) < min_indexed_len)
+            continue;
+
+        Index<int> found;
+        find_term (terms[t], 1u << t, found);
+        indexed |= 1u << t;
+
+        if (! have_start || found.len () < start.len ())
+        {
+            start = std::move (found);
+            have_start = true;
+        }
+    }
+
+    if (have_start)
+    {
+        for (int id : start)
+            search_subtree (* m_all_items[id], terms, indexed, results);
+    }
+    else
+    {
+        /* only short terms (or none at all); check every item */
+        search_recurse (m_tree, terms, (1 << terms.len ()) - 1, results);
+    }
+}
+
+void SearchModel::destroy_database ()
+{
+    cancel_build ();
+
+    m_playlist = Playlist ();
+    m_items.clear ();
+    m_hidden_items = 0;
+    m_database.clear ();
+}
+
+void SearchModel::create_database (Playlist playlist)
+{
+    m_playlist = playlist;
+
+    /* the playlist may have changed since the running build read it */
+    if (m_building)
+        m_build_again = true;
+    else
+        start_build ();
+}
+
+void SearchModel::update_database (Playlist playlist, const Playlist::Update & update)
+{
+    if (playlist != m_playlist || ! m_database || m_building ||
+     update.level < Playlist::Metadata)
+    {
+        create_database (playlist);
+        return;
+    }
+
+    /* the changed entries lie between the unchanged ones at either end */
+    int at = update.before;
+    int removed = m_database->n_entries () - update.before - update.after;
+    int added = playlist.n_entries () - update.before - update.after;
+
+    if (removed < 0 || added < 0 || removed + added > max_incremental ||
+     m_database->n_removed_items () > m_database->n_items ())
+    {
+        create_database (playlist);
+        return;
+    }
+
+    /* the current results may point to removed items */
+    m_items.clear ();
+    m_hidden_items = 0;
+
+    m_database->remove_entries (at, removed, added);
+
+    for (int e = at; e < at + added; e ++)
+        m_database->add_entry (e, playlist.entry_tuple (e, Playlist::NoWait));
+
+    m_database->sort_matches ();
+}
+
+void SearchModel::start_build ()
+{
+    m_building = true;
+    m_build_again = false;
+    m_build_playlist = m_playlist;
+
+    pthread_create (& m_build_thread, nullptr, build_thread, this);
+}
+
+void * SearchModel::build_thread (void * data)
+{
+    auto model = (SearchModel *) data;
+    auto playlist = model->m_build_playlist;
+    auto database = new SearchDatabase;
+
+    int entries = playlist.n_entries ();
+
+    for (int e = 0; e < entries; e ++)
+    {
+        /* check now and then whether the build is still wanted */
+        if (! (e & 0xfff))
+        {
+            auto lh = model->m_build_lock.take ();
+            if (model->m_build_cancel)
+            {
+                delete database;
+                return nullptr;
+            }
+        }
+
+        database->add_entry (e, playlist.entry_tuple (e, Playlist::NoWait));
+    }
+
+    model->m_build_result = database;
+    model->m_build_done.queue ([model] () { model->build_done (); });
+
+    return nullptr;
+}
+
+void SearchModel::build_done ()
+{
+    pthread_join (m_build_thread, nullptr);
+    m_building = false;
+
+    /* the results point into the old database */
+    m_items.clear ();
+    m_hidden_items = 0;
+
+    m_database.capture (m_build_result);
+    m_build_result = nullptr;
+
+    /* if an update is still on its way, the build may have read the
+     * playlist halfway through a change, so read it again */
+    if (m_build_again || m_build_playlist.update_pending ())
+        start_build ();
+
+    if (ready_func)
+        ready_func (ready_data);
+}
+
+void SearchModel::cancel_build ()
+{
+    if (! m_building)
+        return;
+
+    {
+        auto lh = m_build_lock.take ();
+        m_build_cancel = true;
+    }
+
+    pthread_join (m_build_thread, nullptr);
+    m_build_done.stop ();
+
+    delete m_build_result;
+    m_build_result = nullptr;
+
+    m_build_cancel = false;
+    m_building = false;
+    m_build_again = false;
+}
+
 static int item_compare (const Item * const & a, const Item * const & b)
 {
     if (a->field < b->field)
@@ -269,16 +646,20 @@ void SearchModel::do_search (const Index<String> & terms, int max_results)
     m_items.clear ();
     m_hidden_items = 0;
 
-    /* effectively limits number of search terms to 32 */
-    search_recurse (m_database, terms, (1 << terms.len ()) - 1, m_items);
+    if (! m_database)
+        return;
 
-    /* first sort by number of songs per item */
-    m_items.sort (item_compare_pass1);
+    m_database->search (terms, m_items);
 
-    /* limit to items with most songs */
+    /* limit to items with most songs; only those need to be ranked */
     if (m_items.len () > max_results)
     {
         m_hidden_items = m_items.len () - max_results;
+
+        std::nth_element (m_items.begin (), m_items.begin () + max_results,
+         m_items.end (), [] (const Item * a, const Item * b)
+            { return item_compare_pass1 (a, b) < 0; });
+
         m_items.remove (max_results, -1);
     }
 
@@ -124,6 +124,7 @@ private:
     void show_hide_widgets ();
     void search_timeout ();
     void library_updated ();
+    void database_ready ();
     void location_changed ();
     void walk_library_paths ();
     void setup_monitor ();
@@ -270,6 +271,8 @@ void SearchWidget::init_library ()
 {
     m_library.connect_update
      (aud::obj_member<SearchWidget, & SearchWidget::library_updated>, this);
+    m_model.connect_ready
+     (aud::obj_member<SearchWidget, & SearchWidget::database_ready>, this);
 
     if (aud_get_bool (CFG_ID, "rescan_on_startup"))
         m_library.begin_add (get_uri ());
@@ -290,7 +293,7 @@ void SearchWidget::show_hide_widgets ()
     {
         m_help_label.hide ();
 
-        if (m_library.is_ready ())
+        if (m_library.is_ready () && m_model.is_ready ())
         {
             m_wait_label.hide ();
             m_results_list.show ();
@@ -344,7 +347,7 @@ void SearchWidget::library_updated ()
 {
     if (m_library.is_ready ())
     {
-        m_model.create_database (m_library.playlist ());
+        m_model.update_database (m_library.playlist (), m_library.last_update ());
         search_timeout ();
     }
     else
@@ -357,6 +360,12 @@ void SearchWidget::library_updated ()
     show_hide_widgets ();
 }
 
+void SearchWidget::database_ready ()
+{
+    search_timeout ();
+    show_hide_widgets ();
+}
+
 void SearchWidget::location_changed ()
 {
     auto uri = audqt::file_entry_get_uri (m_file_entry);
@@ -173,5 +173,7 @@ void Library::scan_complete ()
 
 void Library::playlist_update ()
 {
-    check_ready_and_update (m_playlist.update_detail ().level >= Playlist::Metadata);
+    m_update = m_playlist.update_detail ();
+    check_ready_and_update (m_update.level >= Playlist::Metadata);
+    m_update = Playlist::Update ();
 }
@@ -33,6 +33,10 @@ public:
     Playlist playlist () const { return m_playlist; }
     bool is_ready () const { return m_is_ready; }
 
+    /* the change that triggered the current update, if it was a change to
+     * the playlist's entries; otherwise the level is NoUpdate */
+    const Playlist::Update & last_update () const { return m_update; }
+
     void begin_add (const char * uri);
     void check_ready_and_update (bool force);
 
@@ -52,6 +56,7 @@ private:
 
     Playlist m_playlist;
     bool m_is_ready = false;
+    Playlist::Update m_update {};
     SimpleHash<String, bool> m_added_table;
 
     /* to allow safe callback access from playlist add thread */
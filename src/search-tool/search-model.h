@@ -22,8 +22,12 @@
 
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
+#include <libaudcore/mainloop.h>
 #include <libaudcore/multihash.h>
 #include <libaudcore/playlist.h>
+#include <libaudcore/threads.h>
+
+#include <pthread.h>
 
 enum class SearchField {
     Genre,
@@ -63,6 +67,8 @@ struct Item
     Item * parent;
     SimpleHash<Key, Item> children;
     Index<int> matches;
+    int id = -1; /* position in SearchDatabase's list of all items */
+    bool unsorted = false; /* matches were appended out of order */
 
     Item (SearchField field, const String & name, Item * parent) :
         field (field),
@@ -74,24 +80,115 @@ struct Item
     Item & operator= (Item &&) = default;
 };
 
+struct Trigram
+{
+    unsigned code;
+
+    bool operator== (const Trigram & b) const
+        { return code == b.code; }
+    unsigned hash () const
+        { return code * 0x9e3779b1; }
+};
+
+/* The item tree built from the library playlist, along with a trigram index
+ * over the folded names of its items. A database is filled in on a worker
+ * thread and then handed to the main thread, which alone touches it after. */
+class SearchDatabase
+{
+public:
+    int n_entries () const { return m_entries; }
+    int n_items () const { return m_all_items.len () - m_removed_items; }
+    int n_removed_items () const { return m_removed_items; }
+
+    void add_entry (int entry, const Tuple & tuple);
+
+    /* removes entries [at, at + removed) and renumbers the ones after them
+     * to make room for <added> entries at <at>, which are then filled in
+     * with add_entry() and completed with sort_matches() */
+    void remove_entries (int at, int removed, int added);
+    void sort_matches ();
+
+    void search (const Index<String> & terms, Index<const Item *> & results);
+
+private:
+    /* per-item scratch state for search(), valid only when serial matches */
+    struct Mark
+    {
+        int serial;
+        unsigned terms;
+        bool visited;
+    };
+
+    void add_to_database (int entry, std::initializer_list<Key> keys);
+    void index_item (Item * item);
+    void unindex_item (Item * item);
+    Mark & mark (int id);
+    void find_term (const char * term, unsigned bit, Index<int> & found);
+    void search_subtree (Item & item, const Index<String> & terms,
+     unsigned indexed, Index<const Item *> & results);
+
+    SimpleHash<Key, Item> m_tree;
+    int m_entries = 0;
+
+    /* trigram index over the folded names of all items; the slots of
+     * removed items stay empty until the database is next rebuilt */
+    Index<Item *> m_all_items;
+    SimpleHash<Trigram, Index<int>> m_trigrams;
+    int m_removed_items = 0;
+
+    Index<Item *> m_unsorted;
+    Index<Mark> m_marks;
+    int m_serial = 0;
+};
+
 class SearchModel
 {
 public:
+    ~SearchModel () { cancel_build (); }
+
     int num_items () const { return m_items.len (); }
     const Item & item_at (int idx) const { return * m_items[idx]; }
     int num_hidden_items () const { return m_hidden_items; }
 
+    /* false while the first database for a playlist is being built */
+    bool is_ready () const { return (bool) m_database; }
+
+    /* called on the main thread when a newly built database is swapped in */
+    void connect_ready (void (* func) (void *), void * data)
+    {
+        ready_func = func;
+        ready_data = data;
+    }
+
     void destroy_database ();
     void create_database (Playlist playlist);
+    void update_database (Playlist playlist, const Playlist::Update & update);
     void do_search (const Index<String> & terms, int max_results);
 
 private:
-    void add_to_database (int entry, std::initializer_list<Key> keys);
+    void start_build ();
+    void cancel_build ();
+    void build_done ();
+    static void * build_thread (void * data);
 
     Playlist m_playlist;
-    SimpleHash<Key, Item> m_database;
+    SmartPtr<SearchDatabase> m_database;
     Index<const Item *> m_items;
     int m_hidden_items = 0;
+
+    /* background build; m_build_playlist and m_build_result belong to the
+     * worker thread until it has been joined */
+    bool m_building = false;
+    bool m_build_again = false;
+    pthread_t m_build_thread;
+    Playlist m_build_playlist;
+    SearchDatabase * m_build_result = nullptr;
+    aud::spinlock m_build_lock;
+    bool m_build_cancel = false;
+    QueuedFunc m_build_done;
+
+    void (* ready_func) (void *) = nullptr;
+    void * ready_data = nullptr;
 };
 
 #endif // SEARCHMODEL_H
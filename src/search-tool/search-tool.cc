@@ -118,7 +118,7 @@ static void show_hide_widgets ()
     {
         gtk_widget_hide (help_label);
 
-        if (s_library->is_ready ())
+        if (s_library->is_ready () && s_model.is_ready ())
         {
             gtk_widget_hide (wait_label);
             gtk_widget_show (scrolled);
@@ -173,7 +173,7 @@ void Library::signal_update ()
 {
     if (s_library->is_ready ())
     {
-        s_model.create_database (s_library->playlist ());
+        s_model.update_database (s_library->playlist (), s_library->last_update ());
         search_timeout ();
     }
     else
@@ -187,9 +187,16 @@ void Library::signal_update ()
     show_hide_widgets ();
 }
 
+static void database_ready (void *)
+{
+    search_timeout ();
+    show_hide_widgets ();
+}
+
 static void search_init ()
 {
     s_library = new Library;
+    s_model.connect_ready (database_ready, nullptr);
 
     if (aud_get_bool (CFG_ID, "rescan_on_startup"))
         s_library->begin_add (get_uri ());
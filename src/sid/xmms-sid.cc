@@ -177,11 +177,41 @@ bool SIDPlugin::play(const char *filename, VFSFile &file)
 
     char *audioBuffer = new char[audioBufSize];
     int64_t bytes_played = 0;
+    int frameSize = xs_cfg.audioChannels * 2;
+    int bytesPerSec = xs_cfg.audioFrequency * frameSize;
 
     while (! check_stop ())
     {
-        if (check_seek () >= 0)
-            AUDWARN ("Seeking is not implemented, ignoring.\n");
+        int seek_value = check_seek ();
+        if (seek_value >= 0) {
+            int64_t pos = aud::rescale<int64_t> (bytes_played, bytesPerSec, 1000);
+
+            /* The engine can only run forward, so going back means starting over */
+            if (seek_value < pos) {
+                if (!xs_sidplayfp_initsong(subTune))
+                    break;
+                pos = 0;
+            }
+
+            /* Emulate whole seconds without mixing any audio, then render
+             * (and drop) the remainder to land on the exact position */
+            if (seek_value / 1000 > pos / 1000) {
+                xs_sidplayfp_skip(seek_value / 1000);
+                pos = seek_value / 1000 * 1000;
+            }
+
+            int64_t skipBytes = aud::rescale<int64_t> (seek_value - pos, 1000, bytesPerSec);
+            skipBytes -= skipBytes % frameSize;
+            while (skipBytes > 0) {
+                int rendered = xs_sidplayfp_fillbuffer(audioBuffer, aud::min<int64_t> (skipBytes, audioBufSize));
+                if (!rendered)
+                    break;
+                skipBytes -= rendered;
+            }
+
+            bytes_played = aud::rescale<int64_t> (seek_value, 1000, bytesPerSec);
+            bytes_played -= bytes_played % frameSize;
+        }
 
         int bufRemaining = xs_sidplayfp_fillbuffer(audioBuffer, audioBufSize);
 
@@ -189,8 +219,7 @@ bool SIDPlugin::play(const char *filename, VFSFile &file)
         bytes_played += bufRemaining;
 
         /* Check if we have played enough */
-        int time_played = aud::rescale<int64_t> (bytes_played,
-         xs_cfg.audioFrequency * xs_cfg.audioChannels * 2, 1000);
+        int time_played = aud::rescale<int64_t> (bytes_played, bytesPerSec, 1000);
 
         if (xs_cfg.playMaxTimeEnable) {
             if (xs_cfg.playMaxTimeUnknown) {
@@ -26,12 +26,11 @@
 
 #include "xs_config.h"
 #include "xs_sidplay2.h"
+#include "xs_slsdb.h"
 
-#include <pthread.h>
 #include <string.h>
 
 #include <sidplayfp/sidplayfp.h>
-#include <sidplayfp/SidDatabase.h>
 #include <sidplayfp/SidInfo.h>
 #include <sidplayfp/SidTune.h>
 #include <sidplayfp/SidTuneInfo.h>
@@ -44,10 +43,6 @@ struct SidState {
     sidplayfp *currEng;
     sidbuilder *currBuilder;
     SidTune *currTune;
-
-    SidDatabase database;
-    bool database_loaded = false;
-    pthread_mutex_t database_mutex = PTHREAD_MUTEX_INITIALIZER;
 };
 
 static SidState state;
@@ -154,9 +149,6 @@ bool xs_sidplayfp_init()
             state.currEng->setRoms((uint8_t*)kernal.begin(), (uint8_t*)basic.begin(), (uint8_t*)chargen.begin());
     }
 
-    /* Load song length database */
-    state.database_loaded = state.database.open(SIDDATADIR "/sidplayfp/Songlengths.md5");
-
     /* Create the sidtune */
     state.currTune = new SidTune(0);
 
@@ -184,8 +176,7 @@ void xs_sidplayfp_close()
         state.currTune = nullptr;
     }
 
-    if (state.database_loaded)
-        state.database.close();
+    xs_slsdb_close();
 }
 
 
@@ -215,6 +206,16 @@ unsigned xs_sidplayfp_fillbuffer(char * audioBuffer, unsigned audioBufSize)
 }
 
 
+/* Emulate without rendering any audio until the song position reaches
+ * the given number of seconds (or the tune stops by itself)
+ */
+void xs_sidplayfp_skip(unsigned seconds)
+{
+    while (state.currEng->isPlaying() && state.currEng->time() < seconds)
+        state.currEng->play(nullptr, 0);
+}
+
+
 /* Load a given SID-tune file
  */
 bool xs_sidplayfp_load(const void *buf, int64_t bufSize)
@@ -250,17 +251,18 @@ bool xs_sidplayfp_getinfo(xs_tuneinfo_t &ti, const void *buf, int64_t bufSize)
     /* Fill in subtune information */
     ti.subTunes.insert(0, ti.nsubTunes);
 
-    if (state.database_loaded)
+    /* Look up sub-tune lengths in the song-length database (which is only
+     * loaded the first time it is needed) */
+    if (ti.nsubTunes > 0)
     {
-        pthread_mutex_lock(&state.database_mutex);
+        char md5[SidTune::MD5_LENGTH + 1];
+        Index<int> lengths;
+        lengths.insert(0, ti.nsubTunes);
 
-        for (int i = 0; i < ti.nsubTunes; i++)
-        {
-            myTune.selectSong(i + 1);
-            ti.subTunes[i].tuneLength = state.database.lengthMs(myTune);
-        }
+        int found = xs_slsdb_lookup(myTune.createMD5New(md5), lengths.begin(), ti.nsubTunes);
 
-        pthread_mutex_unlock(&state.database_mutex);
+        for (int i = 0; i < ti.nsubTunes && i < found; i++)
+            ti.subTunes[i].tuneLength = lengths[i];
     }
 
     return true;
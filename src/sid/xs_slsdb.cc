@@ -0,0 +1,394 @@
+/*
+   XMMS-SID - SIDPlay input plugin for X MultiMedia System (XMMS)
+
+   Indexed song-length database
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "xs_slsdb.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/index.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/vfs.h>
+
+#define XS_SLSDB_SOURCE SIDDATADIR "/sidplayfp/Songlengths.md5"
+#define XS_SLSDB_MAGIC "AUDSLDB1"
+
+/* The index file is a header, a hash table of entries keyed by MD5 (open
+ * addressing, linear probing), and the pool of lengths the entries point
+ * into. It is only ever read on the machine that wrote it, so everything
+ * is in native byte order.
+ */
+struct SlsdbHeader {
+    char magic[8];
+    int64_t sourceSize;     /* size and mtime of the text database it was */
+    int64_t sourceTime;     /* built from, to notice when that changes */
+    uint32_t nBuckets;      /* power of 2 */
+    uint32_t nLengths;
+};
+
+struct SlsdbEntry {
+    uint8_t md5[16];
+    uint32_t first;         /* index of the first length in the pool */
+    uint32_t count;         /* number of sub-tunes, 0 = empty bucket */
+};
+
+#define XS_SLSDB_UNKNOWN 0xffffffff
+
+/* a tune parsed from the text database */
+struct SlsdbRecord {
+    uint8_t md5[16];
+    uint32_t first, count;
+};
+
+static pthread_mutex_t slsdb_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool slsdb_tried = false;
+
+static const char *slsdb_map = nullptr;
+static size_t slsdb_map_size = 0;
+#ifdef _WIN32
+static Index<char> slsdb_data;
+#endif
+
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+
+static bool parse_md5(const char *str, uint8_t md5[16])
+{
+    for (int i = 0; i < 16; i++) {
+        int hi = hex_digit(str[2 * i]);
+        int lo = hex_digit(str[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+
+        md5[i] = (hi << 4) | lo;
+    }
+
+    return true;
+}
+
+
+static uint32_t md5_hash(const uint8_t md5[16])
+{
+    /* the digest is already well distributed */
+    return md5[0] | (md5[1] << 8) | (md5[2] << 16) | ((uint32_t)md5[3] << 24);
+}
+
+
+/* Parse one "m:ss[.SSS]" length, possibly followed by "(attributes)",
+ * advancing str past it
+ */
+static uint32_t parse_length(const char *&str, const char *end)
+{
+    uint32_t min = 0, sec = 0, ms = 0;
+    bool valid = false;
+
+    while (str < end && *str >= '0' && *str <= '9')
+        min = min * 10 + (*str++ - '0');
+
+    if (str < end && *str == ':') {
+        str++;
+        while (str < end && *str >= '0' && *str <= '9') {
+            sec = sec * 10 + (*str++ - '0');
+            valid = true;
+        }
+
+        if (str < end && *str == '.') {
+            str++;
+            int digits = 0;
+            while (str < end && *str >= '0' && *str <= '9') {
+                if (digits++ < 3)
+                    ms = ms * 10 + (*str - '0');
+                str++;
+            }
+            for (; digits < 3; digits++)
+                ms *= 10;
+        }
+    }
+
+    /* skip attributes and anything else up to the next length */
+    while (str < end && *str != ' ' && *str != '\t')
+        str++;
+    while (str < end && (*str == ' ' || *str == '\t'))
+        str++;
+
+    return valid ? (min * 60 + sec) * 1000 + ms : XS_SLSDB_UNKNOWN;
+}
+
+
+/* Convert the text database into an index file
+ */
+static bool slsdb_build(const char *path, const struct stat &source)
+{
+    VFSFile file("file://" XS_SLSDB_SOURCE, "r");
+    if (!file)
+        return false;
+
+    Index<char> text = file.read_all();
+
+    Index<SlsdbRecord> records;
+    Index<uint32_t> lengths;
+
+    const char *p = text.begin(), *end = text.end();
+    while (p < end) {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+
+        /* lines look like "<32 hex digits>=<length> <length> ..." */
+        SlsdbRecord rec;
+        if (eol - p > 33 && p[32] == '=' && parse_md5(p, rec.md5)) {
+            const char *s = p + 33;
+            const char *lineEnd = eol;
+            if (lineEnd > s && lineEnd[-1] == '\r')
+                lineEnd--;
+
+            rec.first = lengths.len();
+            while (s < lineEnd)
+                lengths.append(parse_length(s, lineEnd));
+            rec.count = lengths.len() - rec.first;
+
+            if (rec.count)
+                records.append(rec);
+        }
+
+        p = eol + 1;
+    }
+
+    text.clear();
+
+    uint32_t nBuckets = 16;
+    while (nBuckets < (uint32_t)records.len() * 2)
+        nBuckets <<= 1;
+
+    Index<SlsdbEntry> table;
+    table.insert(0, nBuckets);
+    memset(table.begin(), 0, nBuckets * sizeof(SlsdbEntry));
+
+    for (const SlsdbRecord &rec : records) {
+        uint32_t i = md5_hash(rec.md5) & (nBuckets - 1);
+        while (table[i].count && memcmp(table[i].md5, rec.md5, 16))
+            i = (i + 1) & (nBuckets - 1);
+
+        /* later duplicates win, as with a plain text lookup */
+        memcpy(table[i].md5, rec.md5, 16);
+        table[i].first = rec.first;
+        table[i].count = rec.count;
+    }
+
+    SlsdbHeader header;
+    memcpy(header.magic, XS_SLSDB_MAGIC, 8);
+    header.sourceSize = source.st_size;
+    header.sourceTime = source.st_mtime;
+    header.nBuckets = nBuckets;
+    header.nLengths = lengths.len();
+
+    /* write to a temporary file so a partial index is never picked up */
+    StringBuf tmp = str_concat({path, ".tmp"});
+    FILE *out = fopen(tmp, "wb");
+    if (!out) {
+        AUDERR("[SIDPlayFP] Cannot create %s\n", (const char *)tmp);
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof header, 1, out) == 1 &&
+        fwrite(table.begin(), sizeof(SlsdbEntry), nBuckets, out) == nBuckets &&
+        fwrite(lengths.begin(), sizeof(uint32_t), lengths.len(), out) == (size_t)lengths.len();
+
+    if (fclose(out) != 0)
+        ok = false;
+
+#ifdef _WIN32
+    /* rename() won't replace an existing file here */
+    if (ok)
+        remove(path);
+#endif
+
+    if (!ok || rename(tmp, path) != 0) {
+        AUDERR("[SIDPlayFP] Cannot write %s\n", path);
+        remove(tmp);
+        return false;
+    }
+
+    AUDINFO("[SIDPlayFP] Indexed %d tunes from " XS_SLSDB_SOURCE "\n", records.len());
+    return true;
+}
+
+
+static bool slsdb_valid(const char *data, size_t size, const struct stat &source)
+{
+    if (size < sizeof(SlsdbHeader))
+        return false;
+
+    const SlsdbHeader *header = (const SlsdbHeader *)data;
+    if (memcmp(header->magic, XS_SLSDB_MAGIC, 8) ||
+        header->sourceSize != (int64_t)source.st_size ||
+        header->sourceTime != (int64_t)source.st_mtime)
+        return false;
+
+    return header->nBuckets && !(header->nBuckets & (header->nBuckets - 1)) &&
+        size == sizeof(SlsdbHeader) + (size_t)header->nBuckets * sizeof(SlsdbEntry) +
+        (size_t)header->nLengths * sizeof(uint32_t);
+}
+
+
+static void slsdb_unmap()
+{
+#ifdef _WIN32
+    slsdb_data.clear();
+#else
+    if (slsdb_map)
+        munmap((void *)slsdb_map, slsdb_map_size);
+#endif
+
+    slsdb_map = nullptr;
+    slsdb_map_size = 0;
+}
+
+
+static bool slsdb_map_file(const char *path, const struct stat &source)
+{
+#ifdef _WIN32
+    VFSFile file(filename_to_uri(path), "r");
+    if (!file)
+        return false;
+
+    slsdb_data = file.read_all();
+    slsdb_map = slsdb_data.begin();
+    slsdb_map_size = slsdb_data.len();
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    slsdb_map = (const char *)map;
+    slsdb_map_size = st.st_size;
+#endif
+
+    if (!slsdb_valid(slsdb_map, slsdb_map_size, source)) {
+        slsdb_unmap();
+        return false;
+    }
+
+    return true;
+}
+
+
+/* Map the index, (re)building it first if it is missing or stale.
+ * Called with slsdb_mutex held.
+ */
+static void slsdb_open()
+{
+    struct stat source;
+    if (stat(XS_SLSDB_SOURCE, &source) != 0)
+        return;
+
+    StringBuf path = filename_build({aud_get_path(AudPath::UserDir), "sid-songlengths.idx"});
+
+    if (slsdb_map_file(path, source))
+        return;
+
+    if (slsdb_build(path, source))
+        slsdb_map_file(path, source);
+}
+
+
+int xs_slsdb_lookup(const char *md5, int *lengths, int maxLengths)
+{
+    uint8_t key[16];
+    if (!md5 || strlen(md5) < 32 || !parse_md5(md5, key))
+        return 0;
+
+    pthread_mutex_lock(&slsdb_mutex);
+
+    if (!slsdb_tried) {
+        slsdb_tried = true;
+        slsdb_open();
+    }
+
+    int count = 0;
+
+    if (slsdb_map) {
+        const SlsdbHeader *header = (const SlsdbHeader *)slsdb_map;
+        const SlsdbEntry *table = (const SlsdbEntry *)(header + 1);
+        const uint32_t *pool = (const uint32_t *)(table + header->nBuckets);
+
+        uint32_t i = md5_hash(key) & (header->nBuckets - 1);
+        for (uint32_t probes = 0; table[i].count && probes < header->nBuckets; probes++) {
+            if (!memcmp(table[i].md5, key, 16)) {
+                const SlsdbEntry &entry = table[i];
+                if (entry.first <= header->nLengths &&
+                    entry.count <= header->nLengths - entry.first) {
+                    count = entry.count;
+                    for (int j = 0; j < count && j < maxLengths; j++) {
+                        uint32_t ms = pool[entry.first + j];
+                        lengths[j] = (ms == XS_SLSDB_UNKNOWN) ? -1 : (int)ms;
+                    }
+                }
+                break;
+            }
+
+            i = (i + 1) & (header->nBuckets - 1);
+        }
+    }
+
+    pthread_mutex_unlock(&slsdb_mutex);
+    return count;
+}
+
+
+void xs_slsdb_close()
+{
+    pthread_mutex_lock(&slsdb_mutex);
+    slsdb_unmap();
+    slsdb_tried = false;
+    pthread_mutex_unlock(&slsdb_mutex);
+}
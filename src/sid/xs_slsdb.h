@@ -0,0 +1,21 @@
+#ifndef XS_SLSDB_H
+#define XS_SLSDB_H
+
+/* Song-length database: lengths of the sub-tunes of HVSC tunes, looked up
+ * by the MD5 of the tune (as given by SidTune::createMD5New()).
+ *
+ * The text database (Songlengths.md5) is converted once into a compact
+ * binary index in the user's config directory, which is then mapped into
+ * memory the first time a lookup is made.
+ */
+
+/* Get the lengths in milliseconds of the tune with the given MD5 (32 hex
+ * digits). Returns the number of sub-tunes listed (at most maxLengths are
+ * stored), or 0 if the tune is not in the database. Thread-safe.
+ */
+int xs_slsdb_lookup(const char *md5, int *lengths, int maxLengths);
+
+/* Unmap the index */
+void xs_slsdb_close();
+
+#endif /* XS_SLSDB_H */
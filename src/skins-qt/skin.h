@@ -189,8 +189,10 @@ void skin_draw_playlistwin_frame (QPainter & cr, int width, int height, bool foc
 void skin_draw_mainwin_titlebar (QPainter & cr, bool shaded, bool focus);
 
 /* ui_skin_load_ini.c */
-void skin_load_hints (const char * path);
-void skin_load_pl_colors (const char * path);
-void skin_load_masks (const char * path);
+class SkinFiles;
+
+void skin_load_hints (SkinFiles & files);
+void skin_load_pl_colors (SkinFiles & files);
+void skin_load_masks (SkinFiles & files);
 
 #endif
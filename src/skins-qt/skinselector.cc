@@ -39,23 +39,12 @@ Index<SkinNode> skinlist;
 static AudguiPixbuf skin_get_preview (const char * path)
 {
     AudguiPixbuf preview;
+    SkinFiles files;
+    Index<char> data;
 
-    StringBuf archive_path;
-    if (file_is_archive (path))
-    {
-        archive_path = archive_decompress (path);
-        if (! archive_path)
-            return preview;
-
-        path = archive_path;
-    }
-
-    StringBuf preview_path = skin_pixmap_locate (path, "main");
-    if (preview_path)
-        preview.capture (gdk_pixbuf_new_from_file (preview_path, nullptr));
-
-    if (archive_path)
-        del_directory (archive_path);
+    /* only the main window bitmap is read from the skin */
+    if (files.open (path) && files.read_pixmap ("main", nullptr, data))
+        preview.capture (pixbuf_new_from_data (data, "main"));
 
     return preview;
 }
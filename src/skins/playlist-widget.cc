@@ -77,6 +77,174 @@ void PlaylistWidget::calc_layout ()
         m_first = 0;
 }
 
+bool PlaylistWidget::calc_columns ()
+{
+    m_show_numbers = aud_get_bool ("show_numbers_in_pl");
+    m_show_queue = (m_playlist.n_queued () > 0);
+
+    int number_width = 0, length_width = 0, queue_width = 0;
+
+    for (int i = m_first; i < m_first + m_rows && i < m_length; i ++)
+    {
+        Row & row = get_row (i);
+        number_width = aud::max (number_width, row.number_width);
+        length_width = aud::max (length_width, row.length_width);
+        queue_width = aud::max (queue_width, row.queue_width);
+    }
+
+    int left = 3, right = 3;
+
+    if (m_show_numbers)
+        left += number_width + 4;
+
+    right += length_width + 6;
+    int queue_right = right;
+
+    if (m_show_queue)
+        right += queue_width + 6;
+
+    if (left == m_left && right == m_right && queue_right == m_queue_right)
+        return false;
+
+    m_left = left;
+    m_right = right;
+    m_queue_right = queue_right;
+    return true;
+}
+
+PangoLayout * PlaylistWidget::create_layout (const char * text, int * width)
+{
+    PangoLayout * layout = gtk_widget_create_pango_layout (gtk_dr (), text);
+    pango_layout_set_font_description (layout, m_font.get ());
+
+    if (width)
+    {
+        PangoRectangle rect;
+        pango_layout_get_pixel_extents (layout, nullptr, & rect);
+        * width = rect.width;
+    }
+
+    return layout;
+}
+
+PlaylistWidget::Row & PlaylistWidget::get_row (int entry)
+{
+    Row & row = m_cache[entry];
+
+    /* the widget may be drawn before an update is delivered, so check
+     * that the cached layouts still match the entry */
+    Tuple tuple = m_playlist.entry_tuple (entry, Playlist::NoWait);
+    String title = tuple.get_str (Tuple::FormattedTitle);
+    int length = tuple.get_int (Tuple::Length);
+    int queue_pos = m_show_queue ? m_playlist.queue_find_entry (entry) : -1;
+
+    if (! row.title_layout || title != row.title)
+    {
+        if (! row.title_layout)
+            m_n_cached ++;
+
+        row.title = title;
+        row.title_layout.capture (create_layout (title));
+        pango_layout_set_ellipsize (row.title_layout.get (), PANGO_ELLIPSIZE_END);
+    }
+
+    if (length != row.length)
+    {
+        row.length = length;
+        row.length_width = 0;
+
+        if (length >= 0)
+            row.length_layout.capture (create_layout (str_format_time (length), & row.length_width));
+        else
+            row.length_layout.clear ();
+    }
+
+    if (m_show_numbers && ! row.number_layout)
+    {
+        char buf[16];
+        snprintf (buf, sizeof buf, "%d.", 1 + entry);
+        row.number_layout.capture (create_layout (buf, & row.number_width));
+    }
+
+    if (queue_pos != row.queue_pos)
+    {
+        row.queue_pos = queue_pos;
+        row.queue_width = 0;
+
+        if (queue_pos >= 0)
+        {
+            char buf[16];
+            snprintf (buf, sizeof buf, "(#%d)", 1 + queue_pos);
+            row.queue_layout.capture (create_layout (buf, & row.queue_width));
+        }
+        else
+            row.queue_layout.clear ();
+    }
+
+    return row;
+}
+
+void PlaylistWidget::clear_cache ()
+{
+    m_cache.clear ();
+    m_n_cached = 0;
+}
+
+/* keep layouts only for the entries around the visible ones */
+void PlaylistWidget::trim_cache ()
+{
+    if (m_n_cached <= aud::max (4 * m_rows, 256))
+        return;
+
+    int keep_first = m_first - m_rows;
+    int keep_last = m_first + 2 * m_rows;
+
+    m_n_cached = 0;
+
+    for (int i = 0; i < m_cache.len (); i ++)
+    {
+        if (! m_cache[i].title_layout)
+            continue;
+
+        if (i < keep_first || i >= keep_last)
+            m_cache[i] = Row ();
+        else
+            m_n_cached ++;
+    }
+}
+
+void PlaylistWidget::invalidate_rows (int first, int last)
+{
+    if (first >= last)
+        return;
+
+    if (m_dirty_first < m_dirty_last)
+    {
+        first = aud::min (first, m_dirty_first);
+        last = aud::max (last, m_dirty_last);
+    }
+
+    m_dirty_first = first;
+    m_dirty_last = last;
+}
+
+void PlaylistWidget::queue_draw_rows (int first, int last)
+{
+    first = aud::max (first, m_first);
+    last = aud::min (last, m_first + m_rows);
+
+    if (first < last)
+        queue_draw_area (0, m_offset + m_row_height * (first - m_first),
+         m_width, m_row_height * (last - first));
+}
+
+/* the hover line is 2 pixels high, centered on the top of the row */
+void PlaylistWidget::queue_draw_hover (int row)
+{
+    if (row >= m_first && row <= m_first + m_rows)
+        queue_draw_area (0, m_offset + m_row_height * (row - m_first) - 1, m_width, 2);
+}
+
 int PlaylistWidget::calc_position (int y) const
 {
     if (y < m_offset)
@@ -123,8 +291,8 @@ void PlaylistWidget::cancel_all ()
 
     if (m_hover != -1)
     {
+        queue_draw_hover (m_hover);
         m_hover = -1;
-        queue_draw ();
     }
 
     popup_hide ();
@@ -133,9 +301,15 @@ void PlaylistWidget::cancel_all ()
 void PlaylistWidget::draw (cairo_t * cr)
 {
     int active_entry = m_playlist.get_position ();
-    int left = 3, right = 3;
-    PangoLayout * layout;
-    int width;
+
+    /* only the rows in the exposed area are drawn */
+    double x1, y1, x2, y2;
+    cairo_clip_extents (cr, & x1, & y1, & x2, & y2);
+
+    int top = m_first + aud::max ((int) y1 - m_offset, 0) / m_row_height;
+    int bottom = m_first + aud::max ((int) y2 - m_offset + m_row_height, 0) / m_row_height;
+    bottom = aud::min (bottom, m_first + m_rows);
+    bottom = aud::min (bottom, aud::min (m_length, m_cache.len ()));
 
     /* background */
 
@@ -144,15 +318,14 @@ void PlaylistWidget::draw (cairo_t * cr)
 
     /* playlist title */
 
-    if (m_offset)
+    if (m_offset && y1 < m_offset)
     {
-        layout = gtk_widget_create_pango_layout (gtk_dr (), m_title_text);
-        pango_layout_set_font_description (layout, m_font.get ());
-        pango_layout_set_width (layout, PANGO_SCALE * (m_width - left - right));
+        PangoLayout * layout = create_layout (m_title_text);
+        pango_layout_set_width (layout, PANGO_SCALE * (m_width - 6));
         pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
         pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_MIDDLE);
 
-        cairo_move_to (cr, left, 0);
+        cairo_move_to (cr, 3, 0);
         set_cairo_color (cr, skin.colors[SKIN_PLEDIT_NORMAL]);
         pango_cairo_show_layout (cr, layout);
         g_object_unref (layout);
@@ -160,7 +333,7 @@ void PlaylistWidget::draw (cairo_t * cr)
 
     /* selection highlight */
 
-    for (int i = m_first; i < m_first + m_rows && i < m_length; i ++)
+    for (int i = top; i < bottom; i ++)
     {
         if (! m_playlist.entry_selected (i))
             continue;
@@ -170,111 +343,39 @@ void PlaylistWidget::draw (cairo_t * cr)
         cairo_fill (cr);
     }
 
-    /* entry numbers */
-
-    if (aud_get_bool ("show_numbers_in_pl"))
-    {
-        width = 0;
-
-        for (int i = m_first; i < m_first + m_rows && i < m_length; i ++)
-        {
-            char buf[16];
-            snprintf (buf, sizeof buf, "%d.", 1 + i);
-
-            layout = gtk_widget_create_pango_layout (gtk_dr (), buf);
-            pango_layout_set_font_description (layout, m_font.get ());
-
-            PangoRectangle rect;
-            pango_layout_get_pixel_extents (layout, nullptr, & rect);
-            width = aud::max (width, rect.width);
-
-            cairo_move_to (cr, left, m_offset + m_row_height * (i - m_first));
-            set_cairo_color (cr, skin.colors[(i == active_entry) ?
-             SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]);
-            pango_cairo_show_layout (cr, layout);
-            g_object_unref (layout);
-        }
-
-        left += width + 4;
-    }
-
-    /* entry lengths */
-
-    width = 0;
+    /* entry numbers, lengths, queue positions, and titles */
 
-    for (int i = m_first; i < m_first + m_rows && i < m_length; i ++)
+    for (int i = top; i < bottom; i ++)
     {
-        Tuple tuple = m_playlist.entry_tuple (i, Playlist::NoWait);
-        int len = tuple.get_int (Tuple::Length);
-        if (len < 0)
-            continue;
-
-        layout = gtk_widget_create_pango_layout (gtk_dr (), str_format_time (len));
-        pango_layout_set_font_description (layout, m_font.get ());
+        Row & row = get_row (i);
+        int y = m_offset + m_row_height * (i - m_first);
 
-        PangoRectangle rect;
-        pango_layout_get_pixel_extents (layout, nullptr, & rect);
-        width = aud::max (width, rect.width);
-
-        cairo_move_to (cr, m_width - right - rect.width, m_offset + m_row_height * (i - m_first));
         set_cairo_color (cr, skin.colors[(i == active_entry) ?
          SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]);
-        pango_cairo_show_layout (cr, layout);
-        g_object_unref (layout);
-    }
-
-    right += width + 6;
-
-    /* queue positions */
 
-    if (m_playlist.n_queued ())
-    {
-        width = 0;
-
-        for (int i = m_first; i < m_first + m_rows && i < m_length; i ++)
+        if (m_show_numbers)
         {
-            int pos = m_playlist.queue_find_entry (i);
-            if (pos < 0)
-                continue;
-
-            char buf[16];
-            snprintf (buf, sizeof buf, "(#%d)", 1 + pos);
-
-            layout = gtk_widget_create_pango_layout (gtk_dr (), buf);
-            pango_layout_set_font_description (layout, m_font.get ());
-
-            PangoRectangle rect;
-            pango_layout_get_pixel_extents (layout, nullptr, & rect);
-            width = aud::max (width, rect.width);
-
-            cairo_move_to (cr, m_width - right - rect.width, m_offset +
-             m_row_height * (i - m_first));
-            set_cairo_color (cr, skin.colors[(i == active_entry) ?
-             SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]);
-            pango_cairo_show_layout (cr, layout);
-            g_object_unref (layout);
+            cairo_move_to (cr, 3, y);
+            pango_cairo_show_layout (cr, row.number_layout.get ());
         }
 
-        right += width + 6;
-    }
-
-    /* titles */
+        if (row.length_layout)
+        {
+            cairo_move_to (cr, m_width - 3 - row.length_width, y);
+            pango_cairo_show_layout (cr, row.length_layout.get ());
+        }
 
-    for (int i = m_first; i < m_first + m_rows && i < m_length; i ++)
-    {
-        Tuple tuple = m_playlist.entry_tuple (i, Playlist::NoWait);
-        String title = tuple.get_str (Tuple::FormattedTitle);
+        if (row.queue_layout)
+        {
+            cairo_move_to (cr, m_width - m_queue_right - row.queue_width, y);
+            pango_cairo_show_layout (cr, row.queue_layout.get ());
+        }
 
-        layout = gtk_widget_create_pango_layout (gtk_dr (), title);
-        pango_layout_set_font_description (layout, m_font.get ());
-        pango_layout_set_width (layout, PANGO_SCALE * (m_width - left - right));
-        pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+        /* does nothing unless the width has changed */
+        pango_layout_set_width (row.title_layout.get (), PANGO_SCALE * (m_width - m_left - m_right));
 
-        cairo_move_to (cr, left, m_offset + m_row_height * (i - m_first));
-        set_cairo_color (cr, skin.colors[(i == active_entry) ?
-         SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]);
-        pango_cairo_show_layout (cr, layout);
-        g_object_unref (layout);
+        cairo_move_to (cr, m_left, y);
+        pango_cairo_show_layout (cr, row.title_layout.get ());
     }
 
     /* focus rectangle */
@@ -318,6 +419,7 @@ void PlaylistWidget::resize (int width, int height)
 {
     m_width = width * config.scale;
     m_height = height * config.scale;
+    m_dirty_all = true;
 
     Widget::resize (m_width, m_height);
     refresh ();
@@ -337,6 +439,9 @@ void PlaylistWidget::set_font (const char * font)
     m_row_height = aud::max (rect.height, 1);
 
     g_object_unref (layout);
+
+    clear_cache ();
+    m_dirty_all = true;
     refresh ();
 }
 
@@ -346,6 +451,7 @@ void PlaylistWidget::refresh ()
     m_playlist = Playlist::active_playlist ();
     m_length = m_playlist.n_entries ();
 
+    String prev_title = m_title_text;
     update_title ();
     calc_layout ();
 
@@ -354,14 +460,105 @@ void PlaylistWidget::refresh ()
         cancel_all ();
         m_first = 0;
         ensure_visible (m_playlist.get_focus ());
+        clear_cache ();
+        m_dirty_all = true;
+    }
+
+    if (m_title_text != prev_title)
+        m_dirty_all = true;
+
+    m_cache.resize (m_length);
+
+    if (calc_columns ())
+        m_dirty_all = true;
+
+    /* changes of the current entry and the focus rectangle are tracked
+     * here, since they don't necessarily come with a playlist update */
+    int position = m_playlist.get_position ();
+    if (position != m_drawn_position)
+    {
+        invalidate_rows (m_drawn_position, m_drawn_position + 1);
+        invalidate_rows (position, position + 1);
+        m_drawn_position = position;
+    }
+
+    /* see draw() */
+    int focus = m_playlist.get_focus ();
+    if (focus >= 0 && m_playlist.entry_selected (focus) && m_playlist.n_selected () == 1)
+        focus = -1;
+
+    if (focus != m_drawn_focus)
+    {
+        invalidate_rows (m_drawn_focus, m_drawn_focus + 1);
+        invalidate_rows (focus, focus + 1);
+        m_drawn_focus = focus;
+    }
+
+    if (m_dirty_all)
+        queue_draw ();
+    else
+    {
+        /* move the rows that stay visible rather than drawing them again */
+        int shift = m_drawn_first - m_first;
+
+        if (shift > -m_rows && shift < m_rows)
+        {
+            if (shift)
+                scroll_area (0, m_offset, m_width, m_row_height * m_rows, m_row_height * shift);
+        }
+        else
+            queue_draw_rows (m_first, m_first + m_rows);
+
+        queue_draw_rows (m_dirty_first, m_dirty_last);
     }
 
-    queue_draw ();
+    m_drawn_first = m_first;
+    m_dirty_first = m_dirty_last = 0;
+    m_dirty_all = false;
+
+    trim_cache ();
 
     if (m_slider)
         m_slider->refresh ();
 }
 
+void PlaylistWidget::playlist_update ()
+{
+    if (m_playlist == Playlist::active_playlist ())
+    {
+        auto update = m_playlist.update_detail ();
+
+        if (update.level != Playlist::NoUpdate)
+        {
+            int length = m_playlist.n_entries ();
+            int first = update.before;
+            int last = length - update.after;
+
+            /* entries after an insertion or removal have moved */
+            if (update.level == Playlist::Structure)
+                last = aud::max (aud::max (length, m_cache.len ()), m_first + m_rows);
+
+            if (update.level >= Playlist::Metadata)
+            {
+                for (int i = first; i < last && i < m_cache.len (); i ++)
+                {
+                    if (m_cache[i].title_layout)
+                        m_n_cached --;
+
+                    m_cache[i] = Row ();
+                }
+            }
+
+            invalidate_rows (first, last);
+        }
+
+        if (update.queue_changed)
+            m_dirty_all = true;
+    }
+
+    refresh ();
+}
+
 void PlaylistWidget::ensure_visible (int position)
 {
     if (position < m_first || position >= m_first + m_rows)
@@ -615,8 +812,9 @@ void PlaylistWidget::hover (int x, int y)
 
     if (row != m_hover)
     {
+        queue_draw_hover (m_hover);
+        queue_draw_hover (row);
         m_hover = row;
-        queue_draw ();
     }
 }
 
@@ -625,7 +823,7 @@ int PlaylistWidget::hover_end ()
     int temp = m_hover;
     m_hover = -1;
 
-    queue_draw ();
+    queue_draw_hover (temp);
     return temp;
 }
 
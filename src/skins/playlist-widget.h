@@ -29,6 +29,7 @@
 #define SKINS_UI_SKINNED_PLAYLIST_H
 
 #include <libaudcore/hook.h>
+#include <libaudcore/index.h>
 #include <libaudcore/mainloop.h>
 #include <libaudcore/playlist.h>
 
@@ -38,6 +39,11 @@ class PlaylistSlider;
 
 typedef SmartPtr<PangoFontDescription, pango_font_description_free> PangoFontDescPtr;
 
+static inline void unref_layout (PangoLayout * layout)
+    { g_object_unref (layout); }
+
+typedef SmartPtr<PangoLayout, unref_layout> PangoLayoutPtr;
+
 class PlaylistWidget : public Widget
 {
 public:
@@ -48,6 +54,7 @@ public:
     void resize (int width, int height);
     void set_font (const char * m_font);
     void refresh ();
+    void playlist_update ();
     bool handle_keypress (GdkEventKey * event);
     void row_info (int * m_rows, int * m_first);
     void scroll_to (int row);
@@ -56,6 +63,14 @@ public:
     int hover_end ();
 
 private:
+    /* layouts of one playlist entry, kept until the entry changes */
+    struct Row {
+        String title;
+        int length = -1, queue_pos = -1;
+        PangoLayoutPtr title_layout, length_layout, number_layout, queue_layout;
+        int length_width = 0, number_width = 0, queue_width = 0;
+    };
+
     void draw (cairo_t * cr);
     bool button_press (GdkEventButton * event);
     bool button_release (GdkEventButton * event);
@@ -64,6 +79,16 @@ private:
 
     void update_title ();
     void calc_layout ();
+    bool calc_columns ();
+
+    PangoLayout * create_layout (const char * text, int * width = nullptr);
+    Row & get_row (int entry);
+    void clear_cache ();
+    void trim_cache ();
+
+    void invalidate_rows (int first, int last);
+    void queue_draw_rows (int first, int last);
+    void queue_draw_hover (int row);
 
     int calc_position (int y) const;
     int adjust_position (bool relative, int position) const;
@@ -94,6 +119,16 @@ private:
     int m_width = 0, m_height = 0, m_row_height = 1, m_offset = 0, m_rows = 0, m_first = 0;
     int m_scroll = 0, m_hover = -1, m_drag = 0, m_popup_pos = -1;
     QueuedFunc m_popup_timer;
+
+    Index<Row> m_cache;
+    int m_n_cached = 0;
+    bool m_show_numbers = false, m_show_queue = false;
+    int m_left = 3, m_right = 3, m_queue_right = 3;
+
+    /* what is on screen, and which entries need to be drawn again */
+    int m_drawn_first = 0, m_drawn_position = -1, m_drawn_focus = -1;
+    int m_dirty_first = 0, m_dirty_last = 0;
+    bool m_dirty_all = true;
 };
 
 #endif
@@ -197,9 +197,11 @@ void skin_draw_playlistwin_frame (cairo_t * cr, int width, int height, bool focu
 void skin_draw_mainwin_titlebar (cairo_t * cr, bool shaded, bool focus);
 
 /* ui_skin_load_ini.c */
-void skin_load_hints (const char * path);
-void skin_load_pl_colors (const char * path);
-void skin_load_masks (const char * path);
+class SkinFiles;
+
+void skin_load_hints (SkinFiles & files);
+void skin_load_pl_colors (SkinFiles & files);
+void skin_load_masks (SkinFiles & files);
 
 static inline void set_cairo_color (cairo_t * cr, uint32_t c)
 {
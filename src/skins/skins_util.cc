@@ -24,12 +24,14 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include <glib/gstdio.h>
+#include <zlib.h>
 
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
@@ -49,6 +51,10 @@
 StringBuf find_file_case_path (const char * folder, const char * basename)
 {
     static SimpleHash<String, Index<String>> cache;
+    /* skin thumbnails are made on worker threads */
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock (& mutex);
 
     String key (folder);
     Index<String> * list = cache.lookup (key);
@@ -57,7 +63,10 @@ StringBuf find_file_case_path (const char * folder, const char * basename)
     {
         GDir * handle = g_dir_open (folder, 0, nullptr);
         if (! handle)
+        {
+            pthread_mutex_unlock (& mutex);
             return StringBuf ();
+        }
 
         list = cache.add (key, Index<String> ());
 
@@ -68,13 +77,19 @@ StringBuf find_file_case_path (const char * folder, const char * basename)
         g_dir_close (handle);
     }
 
+    StringBuf path;
+
     for (const String & entry : * list)
     {
         if (! strcmp_nocase (entry, basename))
-            return filename_build ({folder, entry});
+        {
+            path = filename_build ({folder, entry});
+            break;
+        }
     }
 
-    return StringBuf ();
+    pthread_mutex_unlock (& mutex);
+    return path;
 }
 
 VFSFile open_local_file_nocase (const char * folder, const char * basename)
@@ -83,20 +98,6 @@ VFSFile open_local_file_nocase (const char * folder, const char * basename)
     return path ? VFSFile (path, "r") : VFSFile ();
 }
 
-StringBuf skin_pixmap_locate (const char * folder, const char * basename, const char * altname)
-{
-    static const char * const exts[] = {".bmp", ".png", ".xpm"};
-
-    for (const char * ext : exts)
-    {
-        StringBuf name = find_file_case_path (folder, str_concat ({basename, ext}));
-        if (name)
-            return name.settle ();
-    }
-
-    return altname ? skin_pixmap_locate (folder, altname) : StringBuf ();
-}
-
 char * text_parse_line (char * text)
 {
     char * newline = strchr (text, '\n');
@@ -284,6 +285,304 @@ StringBuf archive_decompress (const char * filename)
     return tmpdir;
 }
 
+/*
+ * In-process archive reading
+ */
+
+/* largest file unpacked from a skin archive (256 MiB) */
+#define MAX_UNPACKED_SIZE 0x10000000
+
+static unsigned get_le16 (const char * p)
+{
+    auto u = (const unsigned char *) p;
+    return u[0] | (u[1] << 8);
+}
+
+static unsigned get_le32 (const char * p)
+{
+    auto u = (const unsigned char *) p;
+    return u[0] | (u[1] << 8) | (u[2] << 16) | ((unsigned) u[3] << 24);
+}
+
+static StringBuf member_key (const char * name, int len)
+{
+    /* archives made on Windows may use backslashes */
+    for (int i = len; i --; )
+    {
+        if (name[i] == '/' || name[i] == '\\')
+        {
+            name += i + 1;
+            len -= i + 1;
+            break;
+        }
+    }
+
+    return str_tolower (str_copy (name, len));
+}
+
+SkinFiles::~SkinFiles ()
+{
+    if (m_tempdir)
+        del_directory (m_tempdir);
+}
+
+bool SkinFiles::open (const char * path)
+{
+    ArchiveType type = archive_get_type (path);
+
+    if (type == ARCHIVE_UNKNOWN)
+    {
+        if (! g_file_test (path, G_FILE_TEST_IS_DIR))
+            return false;
+
+        m_folder = String (path);
+        return true;
+    }
+
+    if (type == ARCHIVE_TBZ2)
+    {
+        /* no bzip2 decoder at hand; fall back to the external tools */
+        m_tempdir = String (archive_decompress (path));
+        if (! m_tempdir)
+            return false;
+
+        m_folder = m_tempdir;
+        return true;
+    }
+
+    VFSFile file (path, "r");
+    if (! file)
+        return false;
+
+    m_data = file.read_all ();
+
+    bool success = (type == ARCHIVE_ZIP) ? open_zip () : open_tar (type == ARCHIVE_TGZ);
+    if (! success)
+        AUDWARN ("Unable to read skin archive %s\n", path);
+
+    return success;
+}
+
+bool SkinFiles::open_zip ()
+{
+    const char * data = m_data.begin ();
+    int len = m_data.len ();
+
+    /* the end of central directory record is followed by a comment of
+     * at most 64 KiB */
+    int end = -1;
+    for (int pos = len - 22; pos >= 0 && pos >= len - 22 - 0xffff; pos --)
+    {
+        if (get_le32 (data + pos) == 0x06054b50)
+        {
+            end = pos;
+            break;
+        }
+    }
+
+    if (end < 0)
+        return false;
+
+    int count = get_le16 (data + end + 10);
+    unsigned pos = get_le32 (data + end + 16);
+
+    for (int i = 0; i < count; i ++)
+    {
+        /* compare without adding to the offset, which may be near 4 GiB */
+        if (end < 46 || pos > (unsigned) (end - 46) ||
+         get_le32 (data + pos) != 0x02014b50)
+            return false;
+
+        int method = get_le16 (data + pos + 10);
+        unsigned packed_size = get_le32 (data + pos + 20);
+        unsigned size = get_le32 (data + pos + 24);
+        int name_len = get_le16 (data + pos + 28);
+        int extra_len = get_le16 (data + pos + 30);
+        int comment_len = get_le16 (data + pos + 32);
+        unsigned local = get_le32 (data + pos + 42);
+
+        const char * name = data + pos + 46;
+        pos += 46 + name_len + extra_len + comment_len;
+
+        if (pos > (unsigned) end)
+            return false;
+
+        /* skip folders and anything we can't decode */
+        if (! name_len || name[name_len - 1] == '/' || (method != 0 && method != 8) ||
+         (method == 0 && size != packed_size))
+            continue;
+
+        /* the data follows the local header, whose extra field may differ
+         * from the one in the central directory */
+        if (len < 30 || local > (unsigned) (len - 30) ||
+         get_le32 (data + local) != 0x04034b50)
+            continue;
+
+        unsigned offset = local + 30 + get_le16 (data + local + 26) +
+         get_le16 (data + local + 28);
+
+        if (offset > (unsigned) len || packed_size > (unsigned) len - offset ||
+         size > MAX_UNPACKED_SIZE)
+            continue;
+
+        m_members.add (String (member_key (name, name_len)),
+         {(int) offset, (int) size, (int) packed_size, method == 8});
+    }
+
+    return true;
+}
+
+static bool gunzip (const Index<char> & in, Index<char> & out)
+{
+    z_stream stream {};
+    if (inflateInit2 (& stream, 15 + 32) != Z_OK)  /* expect a gzip header */
+        return false;
+
+    stream.next_in = (Bytef *) in.begin ();
+    stream.avail_in = in.len ();
+
+    int ret = Z_OK;
+    while (ret == Z_OK)
+    {
+        int pos = out.len ();
+        if (pos >= MAX_UNPACKED_SIZE)
+            break;
+
+        out.resize (pos + aud::min (aud::max (in.len (), 65536), MAX_UNPACKED_SIZE - pos));
+
+        stream.next_out = (Bytef *) out.begin () + pos;
+        stream.avail_out = out.len () - pos;
+
+        ret = inflate (& stream, Z_NO_FLUSH);
+        out.resize (out.len () - stream.avail_out);
+    }
+
+    inflateEnd (& stream);
+    return ret == Z_STREAM_END;
+}
+
+bool SkinFiles::open_tar (bool gzipped)
+{
+    if (gzipped)
+    {
+        Index<char> tar;
+        if (! gunzip (m_data, tar))
+            return false;
+
+        m_data = std::move (tar);
+    }
+
+    const char * data = m_data.begin ();
+    int len = m_data.len ();
+
+    for (int pos = 0; pos + 512 <= len; )
+    {
+        const char * header = data + pos;
+
+        /* the archive ends with empty blocks */
+        if (! header[0])
+            break;
+
+        char size_str[13];
+        memcpy (size_str, header + 124, 12);
+        size_str[12] = 0;
+
+        long size = strtol (size_str, nullptr, 8);
+        if (size < 0 || size > len - pos - 512)
+            return false;
+
+        char type = header[156];
+        if (type == '0' || type == 0)
+            m_members.add (String (member_key (header, strnlen (header, 100))),
+             {pos + 512, (int) size, (int) size, false});
+
+        pos += 512 + (int) ((size + 511) & ~511);
+    }
+
+    return true;
+}
+
+bool SkinFiles::read (const char * basename, Index<char> & data)
+{
+    if (m_folder)
+    {
+        VFSFile file = open_local_file_nocase (m_folder, basename);
+        if (! file)
+            return false;
+
+        data = file.read_all ();
+        return true;
+    }
+
+    const Member * member = m_members.lookup (String (str_tolower (basename)));
+    if (! member)
+        return false;
+
+    const char * packed = m_data.begin () + member->offset;
+
+    data.clear ();
+
+    if (! member->deflated)
+    {
+        data.insert (packed, 0, member->size);
+        return true;
+    }
+
+    data.resize (member->size);
+
+    z_stream stream {};
+    if (inflateInit2 (& stream, -MAX_WBITS) != Z_OK)  /* raw deflate */
+        return false;
+
+    stream.next_in = (Bytef *) packed;
+    stream.avail_in = member->packed_size;
+    stream.next_out = (Bytef *) data.begin ();
+    stream.avail_out = member->size;
+
+    int ret = inflate (& stream, Z_FINISH);
+    inflateEnd (& stream);
+
+    if (ret != Z_STREAM_END || stream.avail_out)
+    {
+        AUDWARN ("Error decompressing %s from skin archive\n", basename);
+        data.clear ();
+        return false;
+    }
+
+    return true;
+}
+
+bool SkinFiles::read_pixmap (const char * basename, const char * altname,
+ Index<char> & data)
+{
+    static const char * const exts[] = {".bmp", ".png", ".xpm"};
+
+    for (const char * ext : exts)
+    {
+        if (read (str_concat ({basename, ext}), data))
+            return true;
+    }
+
+    return altname ? read_pixmap (altname, nullptr, data) : false;
+}
+
+VFSFile SkinFiles::open_file (const char * basename)
+{
+    if (m_folder)
+        return open_local_file_nocase (m_folder, basename);
+
+    Index<char> data;
+    if (! read (basename, data))
+        return VFSFile ();
+
+    VFSFile file = VFSFile::tmpfile ();
+    if (! file || file.fwrite (data.begin (), 1, data.len ()) != data.len () ||
+     file.fseek (0, VFS_SEEK_SET) != 0)
+        return VFSFile ();
+
+    return file;
+}
+
 static void del_directory_func (const char * path, const char *)
 {
     if (g_file_test (path, G_FILE_TEST_IS_DIR))
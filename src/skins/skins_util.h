@@ -26,6 +26,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <libaudcore/multihash.h>
 #include <libaudcore/vfs.h>
 
 typedef void (* DirForeachFunc) (const char * path, const char * basename);
@@ -33,8 +34,6 @@ typedef void (* DirForeachFunc) (const char * path, const char * basename);
 StringBuf find_file_case_path (const char * folder, const char * basename);
 
 VFSFile open_local_file_nocase (const char * folder, const char * basename);
-StringBuf skin_pixmap_locate (const char * folder, const char * basename,
- const char * altname = nullptr);
 
 char * text_parse_line (char * text);
 
@@ -49,4 +48,41 @@ bool file_is_archive (const char * filename);
 StringBuf archive_basename (const char * str);
 StringBuf archive_decompress (const char * path);
 
+/* The files making up a skin, which is either a folder or an archive.
+ * Zip and (gzipped) tar archives are read into memory and their members
+ * only decompressed when asked for; other archives are still extracted to
+ * a temporary folder. Files are matched by name without regard to case or
+ * to the folders they are stored in inside an archive. */
+class SkinFiles
+{
+public:
+    SkinFiles () = default;
+    SkinFiles (const SkinFiles &) = delete;
+    SkinFiles & operator= (const SkinFiles &) = delete;
+    ~SkinFiles ();
+
+    bool open (const char * path);
+
+    bool read (const char * basename, Index<char> & data);
+    bool read_pixmap (const char * basename, const char * altname,
+     Index<char> & data);
+
+    /* for parsers that want a file; the contents of an archive member are
+     * copied to a temporary one */
+    VFSFile open_file (const char * basename);
+
+private:
+    struct Member {
+        int offset, size, packed_size;
+        bool deflated;
+    };
+
+    bool open_zip ();
+    bool open_tar (bool gzipped);
+
+    String m_folder, m_tempdir;
+    Index<char> m_data;
+    SimpleHash<String, Member> m_members; /* keyed by lowercase basename */
+};
+
 #endif
@@ -21,11 +21,17 @@
  * using our public API to be a derived work.
  */
 
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <glib/gstdio.h>
+
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
+#include <libaudcore/mainloop.h>
 #include <libaudcore/runtime.h>
 #include <libaudgui/libaudgui-gtk.h>
 
@@ -33,6 +39,7 @@
 #include "skin.h"
 #include "skinselector.h"
 #include "skins_util.h"
+#include "surface.h"
 #include "view.h"
 
 enum SkinViewCols {
@@ -53,33 +60,60 @@ static void skin_view_on_cursor_changed (GtkTreeView * treeview);
 static AudguiPixbuf skin_get_preview (const char * path)
 {
     AudguiPixbuf preview;
+    SkinFiles files;
+    Index<char> data;
 
-    StringBuf archive_path;
-    if (file_is_archive (path))
-    {
-        archive_path = archive_decompress (path);
-        if (! archive_path)
-            return preview;
+    /* only the main window bitmap is read from the skin */
+    if (files.open (path) && files.read_pixmap ("main", nullptr, data))
+        preview.capture (pixbuf_new_from_data (data, "main"));
 
-        path = archive_path;
-    }
+    return preview;
+}
 
-    StringBuf preview_path = skin_pixmap_locate (path, "main");
-    if (preview_path)
-        preview.capture (gdk_pixbuf_new_from_file (preview_path, nullptr));
+/* deletes the thumbnails made for older versions of a skin, that is every
+ * "<base>-<size>-<mtime>.png" other than the current one */
+static void skin_remove_old_thumbnails (const char * base, const char * current)
+{
+    const char * thumb_dir = skins_get_skin_thumb_dir ();
+    GDir * dir = g_dir_open (thumb_dir, 0, nullptr);
+    if (! dir)
+        return;
 
-    if (archive_path)
-        del_directory (archive_path);
+    int len = strlen (base);
+    const char * entry;
 
-    return preview;
+    while ((entry = g_dir_read_name (dir)))
+    {
+        if (strncmp (entry, base, len) || ! strcmp (entry, current))
+            continue;
+
+        /* match the whole name, so that another skin whose name merely
+         * starts with this one's is left alone */
+        int64_t st_size, st_mtime;
+        int end = 0;
+
+        if (sscanf (entry + len, "-%" SCNd64 "-%" SCNd64 ".png%n",
+         & st_size, & st_mtime, & end) == 2 && end && ! entry[len + end])
+            g_unlink (filename_build ({thumb_dir, entry}));
+    }
+
+    g_dir_close (dir);
 }
 
-static AudguiPixbuf skin_get_thumbnail (const char * path)
+/* The cached thumbnail is named after the skin's size and modification time
+ * as well as its name, so that a changed skin gets a new thumbnail and the
+ * old one is deleted. Called from a worker thread. */
+static AudguiPixbuf skin_get_thumbnail (const char * path, int size)
 {
-    StringBuf base = filename_get_base (path);
-    base.insert (-1, ".png");
+    GStatBuf info;
+    if (g_stat (path, & info) < 0)
+        return AudguiPixbuf ();
+
+    String base (filename_get_base (path));
+    StringBuf thumbfile = str_printf ("%s-%" PRId64 "-%" PRId64 ".png",
+     (const char *) base, (int64_t) info.st_size, (int64_t) info.st_mtime);
 
-    StringBuf thumbname = filename_build ({skins_get_skin_thumb_dir (), base});
+    StringBuf thumbname = filename_build ({skins_get_skin_thumb_dir (), thumbfile});
     AudguiPixbuf thumb;
 
     if (g_file_test (thumbname, G_FILE_TEST_EXISTS))
@@ -92,16 +126,96 @@ static AudguiPixbuf skin_get_thumbnail (const char * path)
         if (thumb)
         {
             make_directory (skins_get_skin_thumb_dir ());
-            gdk_pixbuf_save (thumb.get (), thumbname, "png", nullptr, nullptr);
+            if (gdk_pixbuf_save (thumb.get (), thumbname, "png", nullptr, nullptr))
+                skin_remove_old_thumbnails (base, thumbfile);
         }
     }
 
     if (thumb)
-        audgui_pixbuf_scale_within (thumb, audgui_get_dpi () * 3 / 2);
+        audgui_pixbuf_scale_within (thumb, size);
 
     return thumb;
 }
 
+/* Thumbnails are made by a pool of worker threads and filled into the list
+ * as they become ready; the serial number identifies the current list so
+ * that results for an older one are thrown away. */
+struct ThumbJob {
+    int serial, row, size;
+    String path;
+};
+
+struct ThumbResult {
+    int serial, row;
+    AudguiPixbuf thumb;
+};
+
+static GThreadPool * thumb_pool;
+static GtkListStore * thumb_store;
+static QueuedFunc thumb_deliver;
+
+static pthread_mutex_t thumb_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int thumb_serial;
+static Index<ThumbResult> thumb_results;
+
+static void thumb_deliver_cb ()
+{
+    pthread_mutex_lock (& thumb_mutex);
+    Index<ThumbResult> results = std::move (thumb_results);
+    int serial = thumb_serial;
+    pthread_mutex_unlock (& thumb_mutex);
+
+    for (const ThumbResult & result : results)
+    {
+        GtkTreeIter iter;
+        if (result.serial == serial && thumb_store && gtk_tree_model_iter_nth_child
+         ((GtkTreeModel *) thumb_store, & iter, nullptr, result.row))
+        {
+            gtk_list_store_set (thumb_store, & iter,
+             SKIN_VIEW_COL_PREVIEW, result.thumb.get (), -1);
+        }
+    }
+}
+
+static void thumb_job (void * data, void *)
+{
+    auto job = (ThumbJob *) data;
+
+    pthread_mutex_lock (& thumb_mutex);
+    bool current = (job->serial == thumb_serial);
+    pthread_mutex_unlock (& thumb_mutex);
+
+    AudguiPixbuf thumb;
+    if (current)
+        thumb = skin_get_thumbnail (job->path, job->size);
+
+    if (thumb)
+    {
+        pthread_mutex_lock (& thumb_mutex);
+
+        if (job->serial == thumb_serial)
+        {
+            thumb_results.append (job->serial, job->row, std::move (thumb));
+            thumb_deliver.queue (thumb_deliver_cb);
+        }
+
+        pthread_mutex_unlock (& thumb_mutex);
+    }
+
+    delete job;
+}
+
+/* an empty image of the size of a scaled main window, shown until the
+ * thumbnail is ready */
+static AudguiPixbuf thumb_placeholder (int size)
+{
+    AudguiPixbuf placeholder (gdk_pixbuf_new (GDK_COLORSPACE_RGB, true, 8,
+     size, aud::max (size * 116 / 275, 1)));
+
+    gdk_pixbuf_fill (placeholder.get (), 0);
+    return placeholder;
+}
+
 static void scan_skindir_func (const char * path, const char * basename)
 {
     if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
@@ -149,21 +263,34 @@ void skin_view_update (GtkTreeView * treeview)
     String current_path = aud_get_str ("skins", "skin");
     GtkTreePath * current_skin = nullptr;
 
-    for (const SkinNode & node : skinlist)
+    pthread_mutex_lock (& thumb_mutex);
+    int serial = ++ thumb_serial;
+    thumb_results.clear ();
+    pthread_mutex_unlock (& thumb_mutex);
+
+    int size = audgui_get_dpi () * 3 / 2;
+    AudguiPixbuf placeholder = thumb_placeholder (size);
+
+    /* looked up once here; the workers only read it */
+    skins_get_skin_thumb_dir ();
+
+    for (int row = 0; row < skinlist.len (); row ++)
     {
-        AudguiPixbuf thumbnail = skin_get_thumbnail (node.path);
+        const SkinNode & node = skinlist[row];
         StringBuf formattedname = str_concat ({"<big><b>", node.name,
          "</b></big>\n<i>", node.desc, "</i>"});
 
         GtkTreeIter iter;
         gtk_list_store_append (store, & iter);
         gtk_list_store_set (store, & iter,
-         SKIN_VIEW_COL_PREVIEW, thumbnail.get (),
+         SKIN_VIEW_COL_PREVIEW, placeholder.get (),
          SKIN_VIEW_COL_FORMATTEDNAME, (const char *) formattedname,
          SKIN_VIEW_COL_NAME, (const char *) node.name, -1);
 
         if (! current_skin && strstr (current_path, node.name))
             current_skin = gtk_tree_model_get_path ((GtkTreeModel *) store, & iter);
+
+        g_thread_pool_push (thumb_pool, new ThumbJob {serial, row, size, node.path}, nullptr);
     }
 
     if (current_skin)
@@ -195,6 +322,21 @@ static void skin_view_on_cursor_changed (GtkTreeView * treeview)
         view_apply_skin ();
 }
 
+static void skin_view_destroyed ()
+{
+    pthread_mutex_lock (& thumb_mutex);
+    thumb_serial ++;
+    pthread_mutex_unlock (& thumb_mutex);
+
+    /* the remaining jobs see the new serial and return at once */
+    g_thread_pool_free (thumb_pool, false, true);
+    thumb_pool = nullptr;
+
+    thumb_deliver.stop ();
+    thumb_results.clear ();
+    thumb_store = nullptr;
+}
+
 void skin_view_realize (GtkTreeView * treeview)
 {
     gtk_widget_show_all ((GtkWidget *) treeview);
@@ -209,6 +351,10 @@ void skin_view_realize (GtkTreeView * treeview)
     gtk_tree_view_set_model (treeview, (GtkTreeModel *) store);
     g_object_unref (store);
 
+    thumb_store = store;
+    thumb_pool = g_thread_pool_new (thumb_job, nullptr,
+     aud::max (g_get_num_processors (), 1u), false, nullptr);
+
     GtkTreeViewColumn * column = gtk_tree_view_column_new ();
     gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_AUTOSIZE);
     gtk_tree_view_column_set_spacing (column, 16);
@@ -229,4 +375,5 @@ void skin_view_realize (GtkTreeView * treeview)
 
     g_signal_connect (treeview, "cursor-changed",
      (GCallback) skin_view_on_cursor_changed, nullptr);
+    g_signal_connect (treeview, "destroy", (GCallback) skin_view_destroyed, nullptr);
 }
@@ -31,10 +31,21 @@ cairo_surface_t * surface_new (int w, int h)
     return cairo_image_surface_create (CAIRO_FORMAT_RGB24, w, h);
 }
 
-cairo_surface_t * surface_new_from_file (const char * name)
+GdkPixbuf * pixbuf_new_from_data (const Index<char> & data, const char * name)
 {
     GError * error = nullptr;
-    AudguiPixbuf p (gdk_pixbuf_new_from_file (name, & error));
+    GdkPixbufLoader * loader = gdk_pixbuf_loader_new ();
+    GdkPixbuf * pixbuf = nullptr;
+
+    bool ok = gdk_pixbuf_loader_write (loader, (const guchar *) data.begin (),
+     data.len (), & error);
+
+    /* the loader must be closed even after an error */
+    if (! gdk_pixbuf_loader_close (loader, ok ? & error : nullptr))
+        ok = false;
+
+    if (ok && (pixbuf = gdk_pixbuf_loader_get_pixbuf (loader)))
+        g_object_ref (pixbuf);
 
     if (error)
     {
@@ -42,6 +53,14 @@ cairo_surface_t * surface_new_from_file (const char * name)
         g_error_free (error);
     }
 
+    g_object_unref (loader);
+    return pixbuf;
+}
+
+cairo_surface_t * surface_new_from_data (const Index<char> & data, const char * name)
+{
+    AudguiPixbuf p (pixbuf_new_from_data (data, name));
+
     if (! p)
         return nullptr;
 
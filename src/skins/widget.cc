@@ -98,6 +98,47 @@ void Widget::add_drawable (int width, int height)
     set_drawable (widget);
 }
 
+/* the drawable has no window of its own, so both of these work in
+ * coordinates of the parent window, offset by the allocation */
+
+void Widget::queue_draw_area (int x, int y, int width, int height)
+{
+    if (! m_drawable || ! gtk_widget_get_realized (m_drawable))
+        return;
+
+    GtkAllocation alloc;
+    gtk_widget_get_allocation (m_drawable, & alloc);
+
+    GdkRectangle rect = {alloc.x + x * m_scale, alloc.y + y * m_scale,
+     width * m_scale, height * m_scale};
+
+    gdk_window_invalidate_rect (gtk_widget_get_window (m_drawable), & rect, false);
+}
+
+/* moves what is already on screen within an area by dy pixels; the part of
+ * the area that is uncovered is queued for redrawing */
+void Widget::scroll_area (int x, int y, int width, int height, int dy)
+{
+    if (! m_drawable || ! gtk_widget_get_realized (m_drawable))
+        return;
+
+    GtkAllocation alloc;
+    gtk_widget_get_allocation (m_drawable, & alloc);
+
+    GdkRectangle rect = {alloc.x + x * m_scale, alloc.y + y * m_scale,
+     width * m_scale, height * m_scale};
+
+#ifdef USE_GTK3
+    cairo_region_t * region = cairo_region_create_rectangle (& rect);
+    gdk_window_move_region (gtk_widget_get_window (m_drawable), region, 0, dy * m_scale);
+    cairo_region_destroy (region);
+#else
+    GdkRegion * region = gdk_region_rectangle (& rect);
+    gdk_window_move_region (gtk_widget_get_window (m_drawable), region, 0, dy * m_scale);
+    gdk_region_destroy (region);
+#endif
+}
+
 #ifdef USE_GTK3
 void Widget::draw_now ()
 {
@@ -141,6 +182,13 @@ gboolean Widget::draw_cb (GtkWidget * widget, GdkEventExpose * event, Widget * m
 {
     cairo_t * cr = gdk_cairo_create (gtk_widget_get_window (widget));
 
+    /* limit drawing to the exposed area, as GTK 3 does */
+    if (event)
+    {
+        gdk_cairo_region (cr, event->region);
+        cairo_clip (cr);
+    }
+
     if (! gtk_widget_get_has_window (widget))
     {
         GtkAllocation alloc;
@@ -23,9 +23,9 @@
 #include "mem.h"
 #include "MMU.h"
 #include "NDSSystem.h"
+#include "state.h"
 
 // ========================================================= IPC FIFO
-IPC_FIFO ipc_fifo[2]; // 0 - ARM9, 1 - ARM7
 
 void IPC_FIFOinit(uint8_t proc)
 {
@@ -31,7 +31,9 @@ struct IPC_FIFO
 	uint8_t size;
 };
 
-extern IPC_FIFO ipc_fifo[2];
+// the state lives in DesmumeState, see state.h
+inline IPC_FIFO (&desmume_ipc_fifo())[2];
+#define ipc_fifo (desmume_ipc_fifo())
 extern void IPC_FIFOinit(uint8_t proc);
 extern void IPC_FIFOsend(uint8_t proc, uint32_t val);
 extern uint32_t IPC_FIFOrecv(uint8_t proc);
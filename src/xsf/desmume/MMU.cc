@@ -29,6 +29,7 @@
 #include "slot1.h"
 #include "readwrite.h"
 #include "MMU_timing.h"
+#include "state.h"
 
 // http://home.utah.edu/~nahaj/factoring/isqrt.c.html
 static uint64_t isqrt(uint64_t x)
@@ -64,59 +65,57 @@ static uint64_t isqrt(uint64_t x)
 	return root;
 }
 
-uint32_t partie = 1;
-uint32_t _MMU_MAIN_MEM_MASK = 0x3FFFFF;
-uint32_t _MMU_MAIN_MEM_MASK16 = 0x3FFFFF & ~1;
-uint32_t _MMU_MAIN_MEM_MASK32 = 0x3FFFFF & ~3;
-
-MMU_struct MMU;
-MMU_struct_new MMU_new;
-MMU_struct_timing MMU_timing;
-
-uint8_t *MMU_struct::MMU_MEM[2][256] =
+// fills in where each 1MB region of the address space points in this
+// thread's MMU
+static void MMU_InitMemMap()
 {
-	//arm9
+	uint8_t *const mem[2][256] =
 	{
-		/* 0X*/	DUP16(MMU.ARM9_ITCM),
-		/* 1X*/	//DUP16(MMU.ARM9_ITCM)
-		/* 1X*/	DUP16(MMU.UNUSED_RAM),
-		/* 2X*/	DUP16(MMU.MAIN_MEM),
-		/* 3X*/	DUP16(MMU.SWIRAM),
-		/* 4X*/	DUP16(MMU.ARM9_REG),
-		/* 5X*/	DUP16(MMU.ARM9_VMEM),
-		/* 6X*/	DUP16(MMU.ARM9_LCD),
-		/* 7X*/	DUP16(MMU.ARM9_OAM),
-		/* 8X*/	DUP16(nullptr),
-		/* 9X*/	DUP16(nullptr),
-		/* AX*/	DUP16(MMU.UNUSED_RAM),
-		/* BX*/	DUP16(MMU.UNUSED_RAM),
-		/* CX*/	DUP16(MMU.UNUSED_RAM),
-		/* DX*/	DUP16(MMU.UNUSED_RAM),
-		/* EX*/	DUP16(MMU.UNUSED_RAM),
-		/* FX*/	DUP16(MMU.ARM9_BIOS)
-	},
-	//arm7
-	{
-		/* 0X*/	DUP16(MMU.ARM7_BIOS),
-		/* 1X*/	DUP16(MMU.UNUSED_RAM),
-		/* 2X*/	DUP16(MMU.MAIN_MEM),
-		/* 3X*/	DUP8(MMU.SWIRAM),
-				DUP8(MMU.ARM7_ERAM),
-		/* 4X*/	DUP8(MMU.ARM7_REG),
-				DUP8(MMU.ARM7_WIRAM),
-		/* 5X*/	DUP16(MMU.UNUSED_RAM),
-		/* 6X*/	DUP16(MMU.ARM9_LCD),
-		/* 7X*/	DUP16(MMU.UNUSED_RAM),
-		/* 8X*/	DUP16(nullptr),
-		/* 9X*/	DUP16(nullptr),
-		/* AX*/	DUP16(MMU.UNUSED_RAM),
-		/* BX*/	DUP16(MMU.UNUSED_RAM),
-		/* CX*/	DUP16(MMU.UNUSED_RAM),
-		/* DX*/	DUP16(MMU.UNUSED_RAM),
-		/* EX*/	DUP16(MMU.UNUSED_RAM),
-		/* FX*/	DUP16(MMU.UNUSED_RAM)
-	}
-};
+		//arm9
+		{
+			/* 0X*/	DUP16(MMU.ARM9_ITCM),
+			/* 1X*/	//DUP16(MMU.ARM9_ITCM)
+			/* 1X*/	DUP16(MMU.UNUSED_RAM),
+			/* 2X*/	DUP16(MMU.MAIN_MEM),
+			/* 3X*/	DUP16(MMU.SWIRAM),
+			/* 4X*/	DUP16(MMU.ARM9_REG),
+			/* 5X*/	DUP16(MMU.ARM9_VMEM),
+			/* 6X*/	DUP16(MMU.ARM9_LCD),
+			/* 7X*/	DUP16(MMU.ARM9_OAM),
+			/* 8X*/	DUP16(nullptr),
+			/* 9X*/	DUP16(nullptr),
+			/* AX*/	DUP16(MMU.UNUSED_RAM),
+			/* BX*/	DUP16(MMU.UNUSED_RAM),
+			/* CX*/	DUP16(MMU.UNUSED_RAM),
+			/* DX*/	DUP16(MMU.UNUSED_RAM),
+			/* EX*/	DUP16(MMU.UNUSED_RAM),
+			/* FX*/	DUP16(MMU.ARM9_BIOS)
+		},
+		//arm7
+		{
+			/* 0X*/	DUP16(MMU.ARM7_BIOS),
+			/* 1X*/	DUP16(MMU.UNUSED_RAM),
+			/* 2X*/	DUP16(MMU.MAIN_MEM),
+			/* 3X*/	DUP8(MMU.SWIRAM),
+					DUP8(MMU.ARM7_ERAM),
+			/* 4X*/	DUP8(MMU.ARM7_REG),
+					DUP8(MMU.ARM7_WIRAM),
+			/* 5X*/	DUP16(MMU.UNUSED_RAM),
+			/* 6X*/	DUP16(MMU.ARM9_LCD),
+			/* 7X*/	DUP16(MMU.UNUSED_RAM),
+			/* 8X*/	DUP16(nullptr),
+			/* 9X*/	DUP16(nullptr),
+			/* AX*/	DUP16(MMU.UNUSED_RAM),
+			/* BX*/	DUP16(MMU.UNUSED_RAM),
+			/* CX*/	DUP16(MMU.UNUSED_RAM),
+			/* DX*/	DUP16(MMU.UNUSED_RAM),
+			/* EX*/	DUP16(MMU.UNUSED_RAM),
+			/* FX*/	DUP16(MMU.UNUSED_RAM)
+		}
+	};
+
+	memcpy(MMU.MMU_MEM, mem, sizeof(mem));
+}
 
 uint32_t MMU_struct::MMU_MASK[2][256] =
 {
@@ -173,15 +172,13 @@ uint32_t MMU_struct::MMU_MASK[2][256] =
 // for all of the below, values = 41 indicate unmapped memory
 static const uint8_t VRAM_PAGE_UNMAPPED = 41;
 
-static const unsigned VRAM_LCDC_PAGES = 41;
-static uint8_t vram_lcdc_map[VRAM_LCDC_PAGES];
+#define vram_lcdc_map (desmume_state->m_vram_lcdc_map)
 
-// in the range of 0x06000000 - 0x06800000 in 16KB pages (the ARM9 vram mappable area)
+// vram_arm9_map: in the range of 0x06000000 - 0x06800000 in 16KB pages (the ARM9 vram mappable area)
 // this maps to 16KB pages in the LCDC buffer which is what will actually contain the data
-uint8_t vram_arm9_map[VRAM_ARM9_PAGES];
 
 // this chooses which banks are mapped in the 128K banks starting at 0x06000000 in ARM7
-static uint8_t vram_arm7_map[2];
+#define vram_arm7_map (desmume_state->m_vram_arm7_map)
 
 struct TVramBankInfo
 {
@@ -328,8 +325,6 @@ static inline uint32_t MMU_LCDmap(int PROCNUM, uint32_t addr, bool &unmapped, bo
 		return LCDC_HACKY_LOCATION + (vram_page << 14) + ofs;
 }
 
-VramConfiguration vramConfiguration;
-
 // maps the specified bank to LCDC
 static inline void MMU_vram_lcdc(int bank)
 {
@@ -627,12 +622,25 @@ void MMU_VRAM_unmap_all()
 		MMU.texInfo.textureSlotAddr[i] = MMU.blank_memory;
 }
 
+// the cpus' decode caches tag their entries by address only, so anything that changes
+// which memory an address reads from, or fills memory behind the write counters' back,
+// has to throw them away
+static void MMU_codeMapChanged()
+{
+	armcpu_flushDecodeCache(&NDS_ARM7);
+	armcpu_flushDecodeCache(&NDS_ARM9);
+}
+
 static inline void MMU_VRAMmapControl(uint8_t block, uint8_t VRAMBankCnt)
 {
 	// handle WRAM, first of all
 	if (block == 7)
 	{
-		MMU.WRAMCNT = VRAMBankCnt & 3;
+		if (MMU.WRAMCNT != (VRAMBankCnt & 3))
+		{
+			MMU.WRAMCNT = VRAMBankCnt & 3;
+			MMU_codeMapChanged();
+		}
 		return;
 	}
 
@@ -716,6 +724,7 @@ static inline void MMU_VRAMmapControl(uint8_t block, uint8_t VRAMBankCnt)
 void MMU_Init()
 {
 	memset((void*)&MMU, 0, sizeof(MMU_struct));
+	MMU_InitMemMap();
 
 	MMU.CART_ROM = MMU.UNUSED_RAM;
 
@@ -827,10 +836,15 @@ void MMU_Reset()
 	MMU_timing.arm9dataFetch.Reset();
 	MMU_timing.arm9codeCache.Reset();
 	MMU_timing.arm9dataCache.Reset();
+
+	// memory was cleared above without going through the write counters
+	MMU_codeMapChanged();
 }
 
 void SetupMMU(bool debugConsole, bool dsi)
 {
+	uint32_t oldMask = _MMU_MAIN_MEM_MASK;
+
 	if (debugConsole)
 		_MMU_MAIN_MEM_MASK = 0x7FFFFF;
 	else
@@ -839,6 +853,10 @@ void SetupMMU(bool debugConsole, bool dsi)
 		_MMU_MAIN_MEM_MASK = 0xFFFFFF;
 	_MMU_MAIN_MEM_MASK16 = _MMU_MAIN_MEM_MASK & ~1;
 	_MMU_MAIN_MEM_MASK32 = _MMU_MAIN_MEM_MASK & ~3;
+
+	// main memory is mirrored differently now
+	if (_MMU_MAIN_MEM_MASK != oldMask)
+		MMU_codeMapChanged();
 }
 
 void MMU_setRom(uint8_t *rom, uint32_t)
@@ -1584,6 +1602,19 @@ uint32_t DmaController::read32()
 	return ret;
 }
 
+uint32_t *MMU_codeGen(const uint8_t *p)
+{
+	if (p >= MMU.MAIN_MEM && p < MMU.MAIN_MEM + sizeof(MMU.MAIN_MEM))
+		return &MMU.MAIN_MEM_codeGen[(p - MMU.MAIN_MEM) >> MMU_CODE_PAGE_SHIFT];
+	if (p >= MMU.ARM9_ITCM && p < MMU.ARM9_ITCM + sizeof(MMU.ARM9_ITCM))
+		return &MMU.ARM9_ITCM_codeGen[(p - MMU.ARM9_ITCM) >> MMU_CODE_PAGE_SHIFT];
+	if (p >= MMU.ARM7_ERAM && p < MMU.ARM7_ERAM + sizeof(MMU.ARM7_ERAM))
+		return &MMU.ARM7_ERAM_codeGen[(p - MMU.ARM7_ERAM) >> MMU_CODE_PAGE_SHIFT];
+	if (p >= MMU.SWIRAM && p < MMU.SWIRAM + sizeof(MMU.SWIRAM))
+		return &MMU.SWIRAM_codeGen[(p - MMU.SWIRAM) >> MMU_CODE_PAGE_SHIFT];
+	return nullptr;
+}
+
 // ================================================================================================== ARM9 *
 // =========================================================================================================
 // =========================================================================================================
@@ -1595,6 +1626,7 @@ void FASTCALL _MMU_ARM9_write08(uint32_t adr, uint8_t val)
 	if (adr < 0x02000000)
 	{
 		T1WriteByte(MMU.ARM9_ITCM, adr & 0x7FFF, val);
+		++MMU.ARM9_ITCM_codeGen[(adr & 0x7FFF) >> MMU_CODE_PAGE_SHIFT];
 		return;
 	}
 
@@ -1677,6 +1709,8 @@ void FASTCALL _MMU_ARM9_write08(uint32_t adr, uint8_t val)
 
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	MMU.MMU_MEM[ARMCPU_ARM9][adr >> 20][adr & MMU.MMU_MASK[ARMCPU_ARM9][adr >> 20]] = val;
+	if ((adr & 0x0E000000) == 0x02000000)
+		MMU_codeWritten(&MMU.MMU_MEM[ARMCPU_ARM9][adr >> 20][adr & MMU.MMU_MASK[ARMCPU_ARM9][adr >> 20]]);
 }
 
 // ================================================= MMU ARM9 write 16
@@ -1687,6 +1721,7 @@ void FASTCALL _MMU_ARM9_write16(uint32_t adr, uint16_t val)
 	if (adr < 0x02000000)
 	{
 		T1WriteWord(MMU.ARM9_ITCM, adr & 0x7FFF, val);
+		++MMU.ARM9_ITCM_codeGen[(adr & 0x7FFF) >> MMU_CODE_PAGE_SHIFT];
 		return;
 	}
 
@@ -1815,6 +1850,8 @@ void FASTCALL _MMU_ARM9_write16(uint32_t adr, uint16_t val)
 
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	T1WriteWord(MMU.MMU_MEM[ARMCPU_ARM9][adr >> 20], adr & MMU.MMU_MASK[ARMCPU_ARM9][adr >> 20], val);
+	if ((adr & 0x0E000000) == 0x02000000)
+		MMU_codeWritten(&MMU.MMU_MEM[ARMCPU_ARM9][adr >> 20][adr & MMU.MMU_MASK[ARMCPU_ARM9][adr >> 20]]);
 }
 
 // ================================================= MMU ARM9 write 32
@@ -1825,6 +1862,7 @@ void FASTCALL _MMU_ARM9_write32(uint32_t adr, uint32_t val)
 	if (adr < 0x02000000)
 	{
 		T1WriteLong(MMU.ARM9_ITCM, adr & 0x7FFF, val);
+		++MMU.ARM9_ITCM_codeGen[(adr & 0x7FFF) >> MMU_CODE_PAGE_SHIFT];
 		return;
 	}
 
@@ -1955,6 +1993,8 @@ void FASTCALL _MMU_ARM9_write32(uint32_t adr, uint32_t val)
 
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	T1WriteLong(MMU.MMU_MEM[ARMCPU_ARM9][adr >> 20], adr & MMU.MMU_MASK[ARMCPU_ARM9][adr >> 20], val);
+	if ((adr & 0x0E000000) == 0x02000000)
+		MMU_codeWritten(&MMU.MMU_MEM[ARMCPU_ARM9][adr >> 20][adr & MMU.MMU_MASK[ARMCPU_ARM9][adr >> 20]]);
 }
 
 // ================================================= MMU ARM9 read 08
@@ -2244,6 +2284,8 @@ void FASTCALL _MMU_ARM7_write08(uint32_t adr, uint8_t val)
 
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	MMU.MMU_MEM[ARMCPU_ARM7][adr >> 20][adr & MMU.MMU_MASK[ARMCPU_ARM7][adr >> 20]] = val;
+	if ((adr & 0x0E000000) == 0x02000000)
+		MMU_codeWritten(&MMU.MMU_MEM[ARMCPU_ARM7][adr >> 20][adr & MMU.MMU_MASK[ARMCPU_ARM7][adr >> 20]]);
 }
 
 // ================================================= MMU ARM7 write 16
@@ -2540,6 +2582,8 @@ void FASTCALL _MMU_ARM7_write16(uint32_t adr, uint16_t val)
 
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	T1WriteWord(MMU.MMU_MEM[ARMCPU_ARM7][adr >> 20], adr & MMU.MMU_MASK[ARMCPU_ARM7][adr >> 20], val);
+	if ((adr & 0x0E000000) == 0x02000000)
+		MMU_codeWritten(&MMU.MMU_MEM[ARMCPU_ARM7][adr >> 20][adr & MMU.MMU_MASK[ARMCPU_ARM7][adr >> 20]]);
 }
 
 // ================================================= MMU ARM7 write 32
@@ -2620,6 +2664,8 @@ void FASTCALL _MMU_ARM7_write32(uint32_t adr, uint32_t val)
 
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	T1WriteLong(MMU.MMU_MEM[ARMCPU_ARM7][adr >> 20], adr & MMU.MMU_MASK[ARMCPU_ARM7][adr >> 20], val);
+	if ((adr & 0x0E000000) == 0x02000000)
+		MMU_codeWritten(&MMU.MMU_MEM[ARMCPU_ARM7][adr >> 20][adr & MMU.MMU_MASK[ARMCPU_ARM7][adr >> 20]]);
 }
 
 // ================================================= MMU ARM7 read 08
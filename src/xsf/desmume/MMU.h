@@ -298,6 +298,9 @@ struct nds_dscard
 #define DUP8(x)  x, x, x, x,  x, x, x, x
 #define DUP16(x) x, x, x, x,  x, x, x, x,  x, x, x, x,  x, x, x, x
 
+// size of the pages whose writes are counted for the cpus' decode caches
+#define MMU_CODE_PAGE_SHIFT 8
+
 struct MMU_struct
 {
 	//ARM9 mem
@@ -358,7 +361,14 @@ struct MMU_struct
 	// (also since the emulator doesn't prevent unaligned accesses)
 	uint8_t MORE_UNUSED_RAM[4];
 
-	static uint8_t *MMU_MEM[2][256];
+	// write counters for each page of the memories the cpus can run cached code from.
+	// a decoded instruction is reused only while the counter of its page is unchanged
+	uint32_t MAIN_MEM_codeGen[sizeof(MAIN_MEM) >> MMU_CODE_PAGE_SHIFT];
+	uint32_t ARM9_ITCM_codeGen[sizeof(ARM9_ITCM) >> MMU_CODE_PAGE_SHIFT];
+	uint32_t ARM7_ERAM_codeGen[sizeof(ARM7_ERAM) >> MMU_CODE_PAGE_SHIFT];
+	uint32_t SWIRAM_codeGen[sizeof(SWIRAM) >> MMU_CODE_PAGE_SHIFT];
+
+	uint8_t *MMU_MEM[2][256];
 	static uint32_t MMU_MASK[2][256];
 
 	uint8_t ARM9_RW_MODE;
@@ -444,8 +454,11 @@ struct MMU_struct_new
 	bool is_dma(uint32_t adr) { return adr >= _REG_DMA_CONTROL_MIN && adr <= _REG_DMA_CONTROL_MAX; }
 };
 
-extern MMU_struct MMU;
-extern MMU_struct_new MMU_new;
+// the state lives in DesmumeState, see state.h
+inline MMU_struct &desmume_MMU();
+inline MMU_struct_new &desmume_MMU_new();
+#define MMU (desmume_MMU())
+#define MMU_new (desmume_MMU_new())
 
 void MMU_Init();
 void MMU_DeInit();
@@ -507,10 +520,13 @@ struct VramConfiguration
 	}
 };
 
-extern VramConfiguration vramConfiguration;
+inline VramConfiguration &desmume_vramConfiguration();
+#define vramConfiguration (desmume_vramConfiguration())
 
+const unsigned VRAM_LCDC_PAGES = 41;
 const int VRAM_ARM9_PAGES = 512;
-extern uint8_t vram_arm9_map[VRAM_ARM9_PAGES];
+inline uint8_t (&desmume_vram_arm9_map())[VRAM_ARM9_PAGES];
+#define vram_arm9_map (desmume_vram_arm9_map())
 
 template<int PROCNUM, MMU_ACCESS_TYPE AT> uint8_t _MMU_read08(uint32_t addr);
 template<int PROCNUM, MMU_ACCESS_TYPE AT> uint16_t _MMU_read16(uint32_t addr);
@@ -540,13 +556,27 @@ uint8_t  FASTCALL _MMU_ARM7_read08(uint32_t adr);
 uint16_t FASTCALL _MMU_ARM7_read16(uint32_t adr);
 uint32_t FASTCALL _MMU_ARM7_read32(uint32_t adr);
 
-extern uint32_t partie;
+inline uint32_t &desmume_partie();
+#define partie (desmume_partie())
 
-extern uint32_t _MMU_MAIN_MEM_MASK;
-extern uint32_t _MMU_MAIN_MEM_MASK16;
-extern uint32_t _MMU_MAIN_MEM_MASK32;
+inline uint32_t &desmume_MMU_MAIN_MEM_MASK();
+inline uint32_t &desmume_MMU_MAIN_MEM_MASK16();
+inline uint32_t &desmume_MMU_MAIN_MEM_MASK32();
+#define _MMU_MAIN_MEM_MASK (desmume_MMU_MAIN_MEM_MASK())
+#define _MMU_MAIN_MEM_MASK16 (desmume_MMU_MAIN_MEM_MASK16())
+#define _MMU_MAIN_MEM_MASK32 (desmume_MMU_MAIN_MEM_MASK32())
 void SetupMMU(bool debugConsole, bool dsi);
 
+// returns the write counter for the page holding the given byte of emulated memory,
+// or nullptr if code running from there isn't cached
+uint32_t *MMU_codeGen(const uint8_t *p);
+inline void MMU_codeWritten(const uint8_t *p)
+{
+	uint32_t *gen = MMU_codeGen(p);
+	if (gen)
+		++*gen;
+}
+
 // ALERT!!!!!!!!!!!!!!
 // the following inline functions dont do the 0x0FFFFFFF mask.
 // this may result in some unexpected behavior
@@ -698,6 +728,7 @@ inline void _MMU_write08(int PROCNUM, MMU_ACCESS_TYPE AT, uint32_t addr, uint8_t
 	if ((addr & 0x0F000000) == 0x02000000)
 	{
 		T1WriteByte( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK, val);
+		++MMU.MAIN_MEM_codeGen[(addr & _MMU_MAIN_MEM_MASK) >> MMU_CODE_PAGE_SHIFT];
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 1, val, LUAMEMHOOK_WRITE);
 #endif
@@ -736,6 +767,7 @@ inline void _MMU_write16(int PROCNUM, MMU_ACCESS_TYPE AT, uint32_t addr, uint16_
 	if ((addr & 0x0F000000) == 0x02000000)
 	{
 		T1WriteWord( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK16, val);
+		++MMU.MAIN_MEM_codeGen[(addr & _MMU_MAIN_MEM_MASK16) >> MMU_CODE_PAGE_SHIFT];
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 2, val, LUAMEMHOOK_WRITE);
 #endif
@@ -774,6 +806,7 @@ inline void _MMU_write32(int PROCNUM, MMU_ACCESS_TYPE AT, uint32_t addr, uint32_
 	if ((addr & 0x0F000000) == 0x02000000)
 	{
 		T1WriteLong( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK32, val);
+		++MMU.MAIN_MEM_codeGen[(addr & _MMU_MAIN_MEM_MASK32) >> MMU_CODE_PAGE_SHIFT];
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 4, val, LUAMEMHOOK_WRITE);
 #endif
@@ -28,15 +28,13 @@
 #include "readwrite.h"
 #include "firmware.h"
 #include "slot1.h"
+#include "state.h"
 
 // ===============================================================
 
-TCommonSettings CommonSettings;
+__thread DesmumeState *desmume_state __attribute__((tls_model("initial-exec")));
 
-GameInfo gameInfo;
-NDSSystem nds;
-static std::unique_ptr<CFIRMWARE> firmware;
-volatile bool execute = false;
+#define firmware (desmume_state->m_firmware)
 
 int NDS_Init()
 {
@@ -147,8 +145,8 @@ enum ESI_DISPCNT
 	ESI_DISPCNT_HStart, ESI_DISPCNT_HStartIRQ, ESI_DISPCNT_HDraw, ESI_DISPCNT_HBlank
 };
 
-uint64_t nds_timer;
-static uint64_t nds_arm9_timer, nds_arm7_timer;
+#define nds_arm9_timer (desmume_state->m_nds_arm9_timer)
+#define nds_arm7_timer (desmume_state->m_nds_arm7_timer)
 
 struct TSequenceItem
 {
@@ -318,7 +316,7 @@ struct TSequenceItem_sqrtunit : public TSequenceItem
 	}
 };
 
-static struct Sequencer
+struct Sequencer
 {
 	bool nds_vblankEnded;
 	bool reschedule;
@@ -340,7 +338,23 @@ static struct Sequencer
 
 	void execHardware();
 	uint64_t findNext();
-} sequencer;
+};
+
+#define sequencer (*desmume_state->m_sequencer)
+
+DesmumeState::DesmumeState() : m_sequencer(new Sequencer()), m_synchronizer(metaspu_construct(m_synchmethod))
+{
+}
+
+DesmumeState::~DesmumeState()
+{
+	if (m_SNDCore)
+		m_SNDCore->DeInit();
+	delete m_SPU_core;
+	delete m_synchronizer;
+	free(m_postProcessBuffer);
+	delete m_sequencer;
+}
 
 void NDS_RescheduleTimers()
 {
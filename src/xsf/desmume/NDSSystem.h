@@ -56,7 +56,9 @@ template<typename Type> struct buttonstruct
 	};
 };
 
-extern volatile bool execute;
+// the state lives in DesmumeState, see state.h
+inline volatile bool &desmume_execute();
+#define execute (desmume_execute())
 
 struct NDS_header
 {
@@ -110,7 +112,8 @@ struct NDS_header
 	uint8_t reserved[160];
 };
 
-extern uint64_t nds_timer;
+inline uint64_t &desmume_nds_timer();
+#define nds_timer (desmume_nds_timer())
 void NDS_Reschedule();
 void NDS_RescheduleDMA();
 void NDS_RescheduleTimers();
@@ -169,7 +172,8 @@ struct NDS_fw_config_data
 	uint8_t language;
 };
 
-extern NDSSystem nds;
+inline NDSSystem &desmume_nds();
+#define nds (desmume_nds())
 
 int NDS_Init ();
 
@@ -206,7 +210,7 @@ struct RomBanner
 
 struct GameInfo
 {
-	GameInfo() : romdata() { }
+	GameInfo() : crc(0), header(), ROMserial(), ROMname(), romdata(), romsize(0), allocatedSize(0), mask(0), isHomebrew(false) { }
 
 	void loadData(char *buf, int size)
 	{
@@ -249,7 +253,8 @@ struct GameInfo
 	bool isHomebrew;
 };
 
-extern GameInfo gameInfo;
+inline GameInfo &desmume_gameInfo();
+#define gameInfo (desmume_gameInfo())
 
 struct UserButtons : buttonstruct<bool>
 {
@@ -280,7 +285,7 @@ void execHardware_doAllDma(EDMAMode modeNum);
 
 template<bool FORCE> void NDS_exec(int32_t nb = 560190 << 1);
 
-extern struct TCommonSettings
+struct TCommonSettings
 {
 	TCommonSettings() : UseExtBIOS(false), SWIFromBIOS(false), PatchSWI3(false), UseExtFirmware(false), BootFromFirmware(false), ConsoleType(NDS_CONSOLE_TYPE_FAT), rigorous_timing(false), advanced_timing(true),
 		spuInterpolationMode(SPUInterpolation_Linear), manualBackupType(0), spu_captureMuted(false), spu_advanced(false)
@@ -291,8 +296,8 @@ extern struct TCommonSettings
 		NDS_FillDefaultFirmwareConfigData(&this->InternalFirmConf);
 
     bool solo = false;
-    static char* soloEnv = strdup("SOLO_2SF_n");
-    static char* muteEnv = strdup("MUTE_2SF_n");
+    char soloEnv[] = "SOLO_2SF_n";
+    char muteEnv[] = "MUTE_2SF_n";
 		for (int i = 0; i < 16; ++i) {
       if (i < 10) {
         soloEnv[9] = '0' + i;
@@ -345,4 +350,7 @@ extern struct TCommonSettings
 	bool spu_muteChannels[16];
 	bool spu_captureMuted;
 	bool spu_advanced;
-} CommonSettings;
+};
+
+inline TCommonSettings &desmume_CommonSettings();
+#define CommonSettings (desmume_CommonSettings())
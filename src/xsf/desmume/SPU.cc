@@ -43,6 +43,7 @@
 #include "emufile.h"
 #include "matrix.h"
 #include "bits.h"
+#include "state.h"
 
 static inline s16 read16(u32 addr) { return (s16)_MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(addr); }
 static inline u8 read08(u32 addr) { return _MMU_read08<ARMCPU_ARM7,MMU_AT_DEBUG>(addr); }
@@ -50,18 +51,14 @@ static inline u8 read08(u32 addr) { return _MMU_read08<ARMCPU_ARM7,MMU_AT_DEBUG>
 #define K_ADPCM_LOOPING_RECOVERY_INDEX 99999
 #define COSINE_INTERPOLATION_RESOLUTION 8192
 
-SPU_struct *SPU_core = 0;
-int SPU_currentCoreNum = SNDCORE_DUMMY;
-static int volume = 100;
-SampleCache spuSampleCache;
+#define spu_volume (desmume_state->m_spu_volume)
+#define spu_buffersize (desmume_state->m_spu_buffersize)
+#define synchmode (desmume_state->m_synchmode)
+#define synchmethod (desmume_state->m_synchmethod)
+#define synchronizer (desmume_state->m_synchronizer)
 
-static size_t buffersize = 0;
-static ESynchMode synchmode = ESynchMode_Synchronous;
-static ESynchMethod synchmethod = ESynchMethod_0;
-static ISynchronizingAudioBuffer* synchronizer = metaspu_construct(synchmethod);
-
-static int SNDCoreId=-1;
-static SoundInterface_struct *SNDCore=NULL;
+#define SNDCoreId (desmume_state->m_SNDCoreId)
+#define SNDCore (desmume_state->m_SNDCore)
 extern SoundInterface_struct *SNDCoreList[];
 
 static const int format_shift[] = { 2, 1, 3, 0 };
@@ -80,17 +77,16 @@ static const s16 wavedutytbl[8][8] = {
 
 static const double ARM7_CLOCK = 33513982;
 
-double DESMUME_SAMPLE_RATE = 48000;
-static double samples_per_hline = (DESMUME_SAMPLE_RATE / 59.8261f) / 263.0f;
-static double sampleLength = DESMUME_SAMPLE_RATE / 32728.498;
+#define samples_per_hline (desmume_state->m_samples_per_hline)
+#define spu_sample_length (desmume_state->m_spu_sample_length)
 
 void SetDesmumeSampleRate(double rate) {
   DESMUME_SAMPLE_RATE = rate;
-  sampleLength = DESMUME_SAMPLE_RATE / 32728.498;
+  spu_sample_length = DESMUME_SAMPLE_RATE / 32728.498;
   samples_per_hline = (DESMUME_SAMPLE_RATE / 59.8261f) / 263.0f;
 }
 
-static double samples = 0;
+#define spu_samples (desmume_state->m_spu_samples)
 
 template<typename T>
 static FORCEINLINE T MinMax(T val, T min, T max)
@@ -109,7 +105,7 @@ int SPU_ChangeSoundCore(int coreid, int buffersize)
 {
   int i;
 
-  ::buffersize = buffersize;
+  spu_buffersize = buffersize;
 
   // Make sure the old core is freed
   if (SNDCore)
@@ -149,7 +145,7 @@ int SPU_ChangeSoundCore(int coreid, int buffersize)
     return -1;
   }
 
-  SNDCore->SetVolume(volume);
+  SNDCore->SetVolume(spu_volume);
 
   SPU_SetSynchMode(synchmode,synchmethod);
 
@@ -163,7 +159,7 @@ SoundInterface_struct *SPU_SoundCore()
 
 void SPU_ReInit(bool fakeBoot)
 {
-  SPU_Init(SNDCoreId, buffersize);
+  SPU_Init(SNDCoreId, spu_buffersize);
 
   // Firmware set BIAS to 0x200
   if (fakeBoot)
@@ -211,7 +207,7 @@ void SPU_ClearOutputBuffer()
 
 void SPU_SetVolume(int volume)
 {
-  ::volume = volume;
+  spu_volume = volume;
   if (SNDCore)
     SNDCore->SetVolume(volume);
 }
@@ -229,7 +225,7 @@ void SPU_Reset(void)
   for (i = 0x400; i < 0x51D; i++)
     T1WriteByte(MMU.ARM7_REG, i, 0);
 
-  samples = 0;
+  spu_samples = 0;
 }
 
 //------------------------------------------
@@ -1035,8 +1031,22 @@ template<int CHANNELS> FORCEINLINE static void SPU_Mix(SPU_struct* SPU, channel_
   SPU->lastdata = data;
 }
 
+// the mixer runs one output sample at a time, so keep each channel's decoded sample
+// around instead of hashing its registers into spuSampleCache for every sample
+template<int FORMAT> static FORCEINLINE const SampleData& ChanSample(channel_struct *chan)
+{
+  if (!chan->sample || chan->sampleAddr != chan->addr || chan->sampleLoopStart != chan->loopstart || chan->sampleLength != chan->length)
+  {
+    chan->sample = &spuSampleCache.getSample(chan->addr, chan->loopstart, chan->length, SampleData::Format(FORMAT));
+    chan->sampleAddr = chan->addr;
+    chan->sampleLoopStart = chan->loopstart;
+    chan->sampleLength = chan->length;
+  }
+  return *chan->sample;
+}
+
 //WORK
-  template<int FORMAT, int CHANNELS>
+  template<int FORMAT, int CHANNELS, class INTERPOLATOR>
 FORCEINLINE static void ____SPU_ChanUpdate(SPU_struct* const SPU, channel_struct* const chan)
 {
   for (; SPU->bufpos < SPU->buflength; SPU->bufpos++)
@@ -1049,8 +1059,7 @@ FORCEINLINE static void ____SPU_ChanUpdate(SPU_struct* const SPU, channel_struct
       } else if (FORMAT == 3) {
         FetchPSGData(chan, &data);
       } else {
-        const SampleData& sample = spuSampleCache.getSample(chan->addr, chan->loopstart, chan->length, SampleData::Format(FORMAT));
-        data = sample.sampleAt(chan->sampcnt, IInterpolator::allInterpolators[CommonSettings.spuInterpolationMode]);
+        data = ChanSample<FORMAT>(chan).template sampleAt<INTERPOLATOR>(chan->sampcnt);
       }
       SPU_Mix<CHANNELS>(SPU, chan, data);
     }
@@ -1063,27 +1072,41 @@ FORCEINLINE static void ____SPU_ChanUpdate(SPU_struct* const SPU, channel_struct
   }
 }
 
-template<int FORMAT>
+template<int FORMAT, class INTERPOLATOR>
 FORCEINLINE static void ___SPU_ChanUpdate(const bool actuallyMix, SPU_struct* const SPU, channel_struct* const chan)
 {
   if(!actuallyMix)
-    ____SPU_ChanUpdate<FORMAT,-1>(SPU,chan);
+    ____SPU_ChanUpdate<FORMAT,-1,INTERPOLATOR>(SPU,chan);
   else if (chan->pan == 0)
-    ____SPU_ChanUpdate<FORMAT,0>(SPU,chan);
+    ____SPU_ChanUpdate<FORMAT,0,INTERPOLATOR>(SPU,chan);
   else if (chan->pan == 127)
-    ____SPU_ChanUpdate<FORMAT,2>(SPU,chan);
+    ____SPU_ChanUpdate<FORMAT,2,INTERPOLATOR>(SPU,chan);
   else
-    ____SPU_ChanUpdate<FORMAT,1>(SPU,chan);
+    ____SPU_ChanUpdate<FORMAT,1,INTERPOLATOR>(SPU,chan);
+}
+
+template<int FORMAT>
+FORCEINLINE static void __SPU_ChanUpdate(const bool actuallyMix, SPU_struct* const SPU, channel_struct* const chan)
+{
+  switch(CommonSettings.spuInterpolationMode)
+  {
+    case SPUInterpolation_None: ___SPU_ChanUpdate<FORMAT,NoInterpolator>(actuallyMix, SPU, chan); break;
+    case SPUInterpolation_Linear: ___SPU_ChanUpdate<FORMAT,LinearInterpolator>(actuallyMix, SPU, chan); break;
+    case SPUInterpolation_Cosine: ___SPU_ChanUpdate<FORMAT,CosineInterpolator>(actuallyMix, SPU, chan); break;
+    case SPUInterpolation_Sharp: ___SPU_ChanUpdate<FORMAT,SharpIInterpolator>(actuallyMix, SPU, chan); break;
+    default: assert(false);
+  }
 }
 
 FORCEINLINE static void _SPU_ChanUpdate(const bool actuallyMix, SPU_struct* const SPU, channel_struct* const chan)
 {
   switch(chan->format)
   {
-    case 0: ___SPU_ChanUpdate<0>(actuallyMix, SPU, chan); break;
-    case 1: ___SPU_ChanUpdate<1>(actuallyMix, SPU, chan); break;
-    case 2: ___SPU_ChanUpdate<2>(actuallyMix, SPU, chan); break;
-    case 3: ___SPU_ChanUpdate<3>(actuallyMix, SPU, chan); break;
+    case 0: __SPU_ChanUpdate<0>(actuallyMix, SPU, chan); break;
+    case 1: __SPU_ChanUpdate<1>(actuallyMix, SPU, chan); break;
+    case 2: __SPU_ChanUpdate<2>(actuallyMix, SPU, chan); break;
+    // psg channels don't interpolate
+    case 3: ___SPU_ChanUpdate<3,NoInterpolator>(actuallyMix, SPU, chan); break;
     default: assert(false);
   }
 }
@@ -1334,15 +1357,14 @@ static void SPU_MixAudio(bool actuallyMix, SPU_struct *SPU, int length)
 //emulates one hline of the cpu core.
 //this will produce a variable number of samples, calculated to keep a 44100hz output
 //in sync with the emulator framerate
-int spu_core_samples = 0;
 void SPU_Emulate_core()
 {
   bool needToMix = true;
   SoundInterface_struct *soundProcessor = SPU_SoundCore();
 
-  samples += samples_per_hline;
-  spu_core_samples = (int)(samples);
-  samples -= spu_core_samples;
+  spu_samples += samples_per_hline;
+  spu_core_samples = (int)(spu_samples);
+  spu_samples -= spu_core_samples;
 
   SPU_MixAudio(needToMix, SPU_core, spu_core_samples);
 
@@ -1363,8 +1385,8 @@ void SPU_Emulate_core()
 
 void SPU_Emulate_user(bool mix)
 {
-  static s16 *postProcessBuffer = NULL;
-  static size_t postProcessBufferSize = 0;
+  s16 *&postProcessBuffer = desmume_state->m_postProcessBuffer;
+  size_t &postProcessBufferSize = desmume_state->m_postProcessBufferSize;
   size_t freeSampleCount = 0;
   size_t processedSampleCount = 0;
   SoundInterface_struct *soundProcessor = SPU_SoundCore();
@@ -1382,9 +1404,9 @@ void SPU_Emulate_user(bool mix)
     return;
   }
 
-  if (freeSampleCount > buffersize)
+  if (freeSampleCount > spu_buffersize)
   {
-    freeSampleCount = buffersize;
+    freeSampleCount = spu_buffersize;
   }
 
   // If needed, resize the post-process buffer to guarantee that
@@ -73,7 +73,9 @@ struct SoundInterface_struct
 
 extern SoundInterface_struct SNDDummy;
 extern SoundInterface_struct SNDFile;
-extern int SPU_currentCoreNum;
+// the state lives in DesmumeState, see state.h
+inline int &desmume_SPU_currentCoreNum();
+#define SPU_currentCoreNum (desmume_SPU_currentCoreNum())
 
 struct channel_struct
 {
@@ -102,7 +104,11 @@ struct channel_struct
 						index(0),
 						loop_index(0),
 						x(0),
-						psgnoise_last(0)
+						psgnoise_last(0),
+						sample(nullptr),
+						sampleAddr(0),
+						sampleLoopStart(0),
+						sampleLength(0)
 	{}
 	u32 num;
    u8 vol;
@@ -130,6 +136,11 @@ struct channel_struct
    int loop_index;
    u16 x;
    s16 psgnoise_last;
+   // decoded sample last looked up in spuSampleCache, and the registers it was looked up for
+   const SampleData *sample;
+   u32 sampleAddr;
+   u16 sampleLoopStart;
+   u32 sampleLength;
 };
 
 class SPUFifo
@@ -221,8 +232,10 @@ public:
    void ShutUp();
 };
 
-extern SPU_struct *SPU_core;
-extern int spu_core_samples;
+inline SPU_struct *&desmume_SPU_core();
+inline int &desmume_spu_core_samples();
+#define SPU_core (desmume_SPU_core())
+#define spu_core_samples (desmume_spu_core_samples())
 
 int SPU_ChangeSoundCore(int coreid, int buffersize);
 SoundInterface_struct *SPU_SoundCore();
@@ -262,9 +275,11 @@ void SPU_Emulate_user(bool mix = true);
 void SPU_DefaultFetchSamples(s16 *sampleBuffer, size_t sampleCount, ESynchMode synchMode, ISynchronizingAudioBuffer *theSynchronizer);
 size_t SPU_DefaultPostProcessSamples(s16 *postProcessBuffer, size_t requestedSampleCount, ESynchMode synchMode, ISynchronizingAudioBuffer *theSynchronizer);
 
-extern double DESMUME_SAMPLE_RATE;
+inline double &desmume_DESMUME_SAMPLE_RATE();
+#define DESMUME_SAMPLE_RATE (desmume_DESMUME_SAMPLE_RATE())
 void SetDesmumeSampleRate(double rate);
 
-extern SampleCache spuSampleCache;
+inline SampleCache &desmume_spuSampleCache();
+#define spuSampleCache (desmume_spuSampleCache())
 
 #endif
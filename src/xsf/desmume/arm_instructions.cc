@@ -30,6 +30,7 @@
 #include "armcpu.h"
 #include "NDSSystem.h"
 #include "MMU_timing.h"
+#include "state.h"
 
 #define cpu (&ARMPROC)
 #define TEMPLATE template<int PROCNUM>
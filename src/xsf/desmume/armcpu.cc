@@ -26,6 +26,7 @@
 #include "bios.h"
 #include "NDSSystem.h"
 #include "MMU_timing.h"
+#include "state.h"
 #ifdef HAVE_LUA
 #include "lua-engine.h"
 #endif
@@ -40,9 +41,6 @@ static inline uint32_t armcpu_prefetch(armcpu_t *armcpu)
 		return armcpu_prefetch<1>();
 }
 
-armcpu_t NDS_ARM7;
-armcpu_t NDS_ARM9;
-
 int armcpu_new(armcpu_t *armcpu, uint32_t id)
 {
 	armcpu->proc_ID = id;
@@ -91,9 +89,22 @@ void armcpu_init(armcpu_t *armcpu, uint32_t adr)
 
 	armcpu->next_instruction = adr;
 
+	armcpu_flushDecodeCache(armcpu);
 	armcpu_prefetch(armcpu);
 }
 
+void armcpu_flushDecodeCache(armcpu_t *armcpu)
+{
+	// no counter ever matches this stamp, so every entry misses
+	static const uint32_t flushed_gen = 0;
+
+	for (auto &op : armcpu->decode_cache)
+	{
+		op.stamp = 1;
+		op.gen = &flushed_gen;
+	}
+}
+
 uint32_t armcpu_switchMode(armcpu_t *armcpu, uint8_t mode)
 {
 	uint32_t oldmode = armcpu->CPSR.bits.mode;
@@ -193,6 +204,62 @@ uint32_t armcpu_Wait4IRQ(armcpu_t *cpu)
 	return 1;
 }
 
+// returns where in emulated memory the code at adr lives, if it is memory whose writes are tracked for the decode cache.
+// this mirrors the MMU_AT_CODE paths of _MMU_read16/_MMU_read32
+template<uint32_t PROCNUM> static inline const uint8_t *armcpu_codePtr(uint32_t adr)
+{
+	if ((adr & 0x0F000000) == 0x02000000)
+		return &MMU.MAIN_MEM[adr & _MMU_MAIN_MEM_MASK];
+
+	if (PROCNUM == ARMCPU_ARM9)
+		return adr < 0x02000000 ? &MMU.ARM9_ITCM[adr & 0x7FFF] : nullptr;
+
+	if ((adr & 0x0F000000) == 0x03000000)
+	{
+		uint32_t block = (adr >> 20) & 0xFF;
+		return &MMU.MMU_MEM[ARMCPU_ARM7][block][adr & MMU.MMU_MASK[ARMCPU_ARM7][block]];
+	}
+
+	return nullptr;
+}
+
+// fetches the instruction at adr and resolves its handler, reusing the previous decode
+// as long as nothing has been written to its page since
+template<uint32_t PROCNUM, bool THUMB> static FORCEINLINE void armcpu_fetch(armcpu_t *armcpu, uint32_t adr)
+{
+	uint32_t tag = THUMB ? adr | 1 : adr;
+	armcpu_decoded_t &op = armcpu->decode_cache[(adr >> 1) & (ARMCPU_DECODE_CACHE_SIZE - 1)];
+
+	if (op.tag == tag && *op.gen == op.stamp)
+	{
+		armcpu->instruction = op.instruction;
+		armcpu->instruction_func = op.func;
+		return;
+	}
+
+	if (THUMB)
+	{
+		armcpu->instruction = _MMU_read16<PROCNUM, MMU_AT_CODE>(adr);
+		armcpu->instruction_func = thumb_instructions_set[PROCNUM][armcpu->instruction >> 6];
+	}
+	else
+	{
+		armcpu->instruction = _MMU_read32<PROCNUM, MMU_AT_CODE>(adr);
+		armcpu->instruction_func = arm_instructions_set[PROCNUM][INSTRUCTION_INDEX(armcpu->instruction)];
+	}
+
+	const uint8_t *code = armcpu_codePtr<PROCNUM>(adr);
+	const uint32_t *gen = code ? MMU_codeGen(code) : nullptr;
+	if (gen)
+	{
+		op.tag = tag;
+		op.stamp = *gen;
+		op.gen = gen;
+		op.instruction = armcpu->instruction;
+		op.func = armcpu->instruction_func;
+	}
+}
+
 template<uint32_t PROCNUM> static inline uint32_t armcpu_prefetch()
 {
 	armcpu_t *const armcpu = &ARMPROC;
@@ -206,7 +273,7 @@ template<uint32_t PROCNUM> static inline uint32_t armcpu_prefetch()
 		armcpu->instruct_adr = curInstruction;
 		armcpu->next_instruction = curInstruction + 4;
 		armcpu->R[15] = curInstruction + 8;
-		armcpu->instruction = _MMU_read32<PROCNUM, MMU_AT_CODE>(curInstruction);
+		armcpu_fetch<PROCNUM, false>(armcpu, curInstruction);
 
 		return MMU_codeFetchCycles<PROCNUM, 32>(curInstruction);
 	}
@@ -216,7 +283,7 @@ template<uint32_t PROCNUM> static inline uint32_t armcpu_prefetch()
 	armcpu->instruct_adr = curInstruction;
 	armcpu->next_instruction = curInstruction + 2;
 	armcpu->R[15] = curInstruction + 4;
-	armcpu->instruction = _MMU_read16<PROCNUM, MMU_AT_CODE>(curInstruction);
+	armcpu_fetch<PROCNUM, true>(armcpu, curInstruction);
 
 	if (!PROCNUM)
 	{
@@ -338,7 +405,7 @@ template<int PROCNUM> uint32_t armcpu_exec()
 #ifdef HAVE_LUA
 			CallRegisteredLuaMemHook(ARMPROC.instruct_adr, 4, ARMPROC.instruction, LUAMEMHOOK_EXEC); // should report even if condition=false?
 #endif
-			cExecute = arm_instructions_set[PROCNUM][INSTRUCTION_INDEX(ARMPROC.instruction)](ARMPROC.instruction);
+			cExecute = ARMPROC.instruction_func(ARMPROC.instruction);
 		}
 		else
 			cExecute = 1; // If condition=false: 1S cycle
@@ -349,7 +416,7 @@ template<int PROCNUM> uint32_t armcpu_exec()
 #ifdef HAVE_LUA
 	CallRegisteredLuaMemHook(ARMPROC.instruct_adr, 2, ARMPROC.instruction, LUAMEMHOOK_EXEC);
 #endif
-	cExecute = thumb_instructions_set[PROCNUM][ARMPROC.instruction>>6](ARMPROC.instruction);
+	cExecute = ARMPROC.instruction_func(ARMPROC.instruction);
 
 	cFetch = armcpu_prefetch<PROCNUM>();
 	return MMU_fetchExecuteCycles<PROCNUM>(cExecute, cFetch);
@@ -174,6 +174,19 @@ inline uint8_t TEST_COND(uint32_t cond, uint32_t inst, Status_Reg CPSR) { return
 
 typedef void *armcp_t;
 
+// number of entries in each cpu's cache of decoded instructions (a power of 2)
+#define ARMCPU_DECODE_CACHE_SIZE 4096
+
+// an instruction as fetched from memory, together with its resolved handler
+struct armcpu_decoded_t
+{
+	uint32_t tag; // address of the instruction, | 1 for thumb
+	uint32_t stamp; // write counter of its page when it was fetched
+	const uint32_t *gen; // the write counter itself
+	uint32_t instruction;
+	OpFunc func;
+};
+
 struct armcpu_t
 {
 	uint32_t proc_ID;
@@ -211,6 +224,10 @@ struct armcpu_t
 #if defined(_M_X64) || defined(__x86_64__)
 	uint8_t cond_table[16 * 16];
 #endif
+
+	// handler for the prefetched instruction
+	OpFunc instruction_func;
+	armcpu_decoded_t decode_cache[ARMCPU_DECODE_CACHE_SIZE];
 };
 
 int armcpu_new(armcpu_t *armcpu, uint32_t id);
@@ -221,8 +238,13 @@ bool armcpu_irqException(armcpu_t *armcpu);
 void armcpu_exception(armcpu_t *cpu, uint32_t number);
 uint32_t TRAPUNDEF(armcpu_t* cpu);
 uint32_t armcpu_Wait4IRQ(armcpu_t *cpu);
+void armcpu_flushDecodeCache(armcpu_t *armcpu);
 
-extern armcpu_t NDS_ARM7, NDS_ARM9;
+// the state lives in DesmumeState, see state.h
+inline armcpu_t &desmume_NDS_ARM7();
+inline armcpu_t &desmume_NDS_ARM9();
+#define NDS_ARM7 (desmume_NDS_ARM7())
+#define NDS_ARM9 (desmume_NDS_ARM9())
 
 template<int PROCNUM> uint32_t armcpu_exec();
 
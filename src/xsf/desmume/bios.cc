@@ -20,6 +20,7 @@
 #include "cp15.h"
 #include "MMU.h"
 #include "NDSSystem.h"
+#include "state.h"
 
 #define cpu (&ARMPROC)
 #define TEMPLATE template<int PROCNUM>
@@ -19,8 +19,7 @@
 #include <cstdlib>
 #include "cp15.h"
 #include "MMU.h"
-
-armcp15_t cp15;
+#include "state.h"
 
 bool armcp15_t::reset(armcpu_t *c)
 {
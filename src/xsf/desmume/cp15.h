@@ -107,5 +107,6 @@ public:
 	bool isAccessAllowed(uint32_t address,uint32_t access);
 };
 
-extern armcp15_t cp15;
+inline armcp15_t &desmume_cp15(); // see state.h
+#define cp15 (desmume_cp15())
 void maskPrecalc();
@@ -17,6 +17,7 @@
 
 #include "firmware.h"
 #include "NDSSystem.h"
+#include "state.h"
 
 #define WANT_AUD_BSWAP
 #include <libaudcore/audio.h>
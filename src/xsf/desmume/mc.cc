@@ -23,6 +23,7 @@
 #include "mc.h"
 #include "readwrite.h"
 #include "NDSSystem.h"
+#include "state.h"
 
 static const uint8_t FW_CMD_READ = 0x03;
 static const uint8_t FW_CMD_WRITEDISABLE = 0x04;
@@ -21,6 +21,7 @@
 #include "registers.h"
 #include "MMU.h"
 #include "NDSSystem.h"
+#include "state.h"
 
 static void info(char *info) { strcpy(info, "Slot1 Retail card emulation"); }
 static void config() {}
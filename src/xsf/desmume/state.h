@@ -0,0 +1,146 @@
+/*
+	Emulator state for the DeSmuME core
+
+	This file is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with the this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+#include "FIFO.h"
+#include "MMU.h"
+#include "MMU_timing.h"
+#include "NDSSystem.h"
+#include "SPU.h"
+#include "armcpu.h"
+#include "cp15.h"
+#include "firmware.h"
+#include "metaspu.h"
+#include "../spu/samplecache.h"
+
+struct Sequencer;
+struct DesmumeState;
+
+// every emulated memory and register access goes through this, so it uses the
+// initial-exec model: a constant-initialized __thread pointer is read straight from
+// the thread pointer, without __tls_get_addr or a C++ thread_local init wrapper
+extern __thread DesmumeState *desmume_state __attribute__((tls_model("initial-exec")));
+
+// Everything the emulated machine keeps between calls, which upstream keeps
+// in globals. Each thread that runs the emulator points desmume_state at its
+// own instance, so several songs can be emulated at once. Constructing one
+// points the calling thread at it, since some of the members' constructors
+// already look at the state (BackupDevice reads CommonSettings), and
+// destroying it clears the pointer again.
+struct DesmumeState
+{
+	DesmumeState();
+	~DesmumeState();
+
+private:
+	struct Bind
+	{
+		Bind(DesmumeState *state) { desmume_state = state; }
+		~Bind() { desmume_state = nullptr; }
+	} bind{this};
+
+public:
+	// NDSSystem.cc
+	TCommonSettings m_CommonSettings;
+	GameInfo m_gameInfo;
+	NDSSystem m_nds{};
+	std::unique_ptr<CFIRMWARE> m_firmware;
+	volatile bool m_execute = false;
+	uint64_t m_nds_timer = 0;
+	uint64_t m_nds_arm9_timer = 0, m_nds_arm7_timer = 0;
+	Sequencer *m_sequencer;
+
+	// FIFO.cc
+	IPC_FIFO m_ipc_fifo[2]{}; // 0 - ARM9, 1 - ARM7
+
+	// MMU.cc
+	MMU_struct m_MMU{};
+	MMU_struct_new m_MMU_new;
+	MMU_struct_timing m_MMU_timing{};
+	uint32_t m_partie = 1;
+	uint32_t m__MMU_MAIN_MEM_MASK = 0x3FFFFF;
+	uint32_t m__MMU_MAIN_MEM_MASK16 = 0x3FFFFF & ~1;
+	uint32_t m__MMU_MAIN_MEM_MASK32 = 0x3FFFFF & ~3;
+	uint8_t m_vram_lcdc_map[VRAM_LCDC_PAGES]{};
+	uint8_t m_vram_arm9_map[VRAM_ARM9_PAGES]{};
+	uint8_t m_vram_arm7_map[2]{};
+	VramConfiguration m_vramConfiguration{};
+
+	// SPU.cc
+	SPU_struct *m_SPU_core = nullptr;
+	int m_SPU_currentCoreNum = SNDCORE_DUMMY;
+	int m_spu_volume = 100;
+	SampleCache m_spuSampleCache;
+	size_t m_spu_buffersize = 0;
+	ESynchMode m_synchmode = ESynchMode_Synchronous;
+	ESynchMethod m_synchmethod = ESynchMethod_0;
+	ISynchronizingAudioBuffer *m_synchronizer;
+	int m_SNDCoreId = -1;
+	SoundInterface_struct *m_SNDCore = nullptr;
+	double m_DESMUME_SAMPLE_RATE = 48000;
+	double m_samples_per_hline = (48000 / 59.8261f) / 263.0f;
+	double m_spu_sample_length = 48000 / 32728.498;
+	double m_spu_samples = 0;
+	int m_spu_core_samples = 0;
+	s16 *m_postProcessBuffer = nullptr;
+	size_t m_postProcessBufferSize = 0;
+
+	// armcpu.cc, cp15.cc
+	armcpu_t m_NDS_ARM7{}, m_NDS_ARM9{};
+	armcp15_t m_cp15;
+
+	// sndif2sf.cc, the frontend's sound interface
+	struct
+	{
+		std::vector<uint8_t> buf;
+		unsigned filled, used;
+		uint32_t bufferbytes, cycles;
+		int xfs_load, sync_type;
+	} m_sndifwork = {std::vector<uint8_t>(), 0, 0, 0, 0, 0, 0};
+	std::list<std::vector<uint8_t>> m_buffer_rope;
+};
+
+// accessors for the names that upstream's headers declare extern
+inline IPC_FIFO (&desmume_ipc_fifo())[2] { return desmume_state->m_ipc_fifo; }
+inline MMU_struct &desmume_MMU() { return desmume_state->m_MMU; }
+inline MMU_struct_new &desmume_MMU_new() { return desmume_state->m_MMU_new; }
+inline MMU_struct_timing &desmume_MMU_timing() { return desmume_state->m_MMU_timing; }
+inline uint32_t &desmume_partie() { return desmume_state->m_partie; }
+inline uint32_t &desmume_MMU_MAIN_MEM_MASK() { return desmume_state->m__MMU_MAIN_MEM_MASK; }
+inline uint32_t &desmume_MMU_MAIN_MEM_MASK16() { return desmume_state->m__MMU_MAIN_MEM_MASK16; }
+inline uint32_t &desmume_MMU_MAIN_MEM_MASK32() { return desmume_state->m__MMU_MAIN_MEM_MASK32; }
+inline uint8_t (&desmume_vram_arm9_map())[VRAM_ARM9_PAGES] { return desmume_state->m_vram_arm9_map; }
+inline VramConfiguration &desmume_vramConfiguration() { return desmume_state->m_vramConfiguration; }
+inline TCommonSettings &desmume_CommonSettings() { return desmume_state->m_CommonSettings; }
+inline GameInfo &desmume_gameInfo() { return desmume_state->m_gameInfo; }
+inline NDSSystem &desmume_nds() { return desmume_state->m_nds; }
+inline volatile bool &desmume_execute() { return desmume_state->m_execute; }
+inline uint64_t &desmume_nds_timer() { return desmume_state->m_nds_timer; }
+inline SPU_struct *&desmume_SPU_core() { return desmume_state->m_SPU_core; }
+inline int &desmume_SPU_currentCoreNum() { return desmume_state->m_SPU_currentCoreNum; }
+inline SampleCache &desmume_spuSampleCache() { return desmume_state->m_spuSampleCache; }
+inline double &desmume_DESMUME_SAMPLE_RATE() { return desmume_state->m_DESMUME_SAMPLE_RATE; }
+inline int &desmume_spu_core_samples() { return desmume_state->m_spu_core_samples; }
+inline armcpu_t &desmume_NDS_ARM7() { return desmume_state->m_NDS_ARM7; }
+inline armcpu_t &desmume_NDS_ARM9() { return desmume_state->m_NDS_ARM9; }
+inline armcp15_t &desmume_cp15() { return desmume_state->m_cp15; }
+inline std::list<std::vector<uint8_t>> &desmume_buffer_rope() { return desmume_state->m_buffer_rope; }
@@ -23,6 +23,7 @@
 #include "MMU.h"
 #include "NDSSystem.h"
 #include "MMU_timing.h"
+#include "state.h"
 
 #define cpu (&ARMPROC)
 #define TEMPLATE template<int PROCNUM>
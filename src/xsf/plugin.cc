@@ -40,6 +40,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <atomic>
 #include <memory>
 #include <sstream>
 #include <iostream>
@@ -51,17 +52,11 @@
 #include <libaudcore/runtime.h>
 
 #include "desmume/NDSSystem.h"
+#include "desmume/state.h"
 #include "spu/samplecache.h"
 #include "sndif2sf.h"
 #include "XSFFile.h"
 
-#if _WIN32
-#include <windows.h>
-#define sleep Sleep
-#else
-#include <unistd.h>
-#endif
-
 class XSFPlugin : public InputPlugin
 {
 public:
@@ -159,10 +154,10 @@ public:
   ~vfsfile_istream() { delete rdbuf(nullptr); }
 };
 
-/* xsf_get_lib: called to load secondary files */
-static String dirpath;
-
-bool ignore_length;
+/* set from the preferences window, so play() copies them into each song's
+ * own state rather than sharing them between songs */
+static std::atomic<int> interp_mode(0);
+static std::atomic<bool> ignore_length_setting(false);
 
 #define CFG_ID "xsf"
 
@@ -178,15 +173,10 @@ const char* const XSFPlugin::defaults[] =
 bool XSFPlugin::init()
 {
 	aud_config_set_defaults(CFG_ID, defaults);
+	ignore_length_setting = aud_get_bool(CFG_ID, "ignore_length");
 	return true;
 }
 
-Index<char> xsf_get_lib(char *filename)
-{
-	VFSFile file(filename_build({dirpath, filename}), "r");
-	return file ? file.read_all() : Index<char>();
-}
-
 bool XSFPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Index<char> *image)
 {
   try {
@@ -251,7 +241,7 @@ bool map2SF(std::vector<uint8_t>& rom, XSFFile* xsf)
   return true;
 }
 
-bool recursiveLoad2SF(std::vector<uint8_t>& rom, XSFFile* xsf, int level)
+bool recursiveLoad2SF(std::vector<uint8_t>& rom, XSFFile* xsf, const char* dirpath, int level)
 {
   if (level <= 10 && xsf->GetTagExists("_lib"))
   {
@@ -259,7 +249,7 @@ bool recursiveLoad2SF(std::vector<uint8_t>& rom, XSFFile* xsf, int level)
     if (!vs)
       return false;
     XSFFile libxsf(vs, 4, 8);
-    if (!recursiveLoad2SF(rom, &libxsf, level + 1))
+    if (!recursiveLoad2SF(rom, &libxsf, dirpath, level + 1))
       return false;
   }
 
@@ -276,7 +266,7 @@ bool recursiveLoad2SF(std::vector<uint8_t>& rom, XSFFile* xsf, int level)
       if (!vs)
         return false;
       XSFFile libxsf(vs, 4, 8);
-      if (!recursiveLoad2SF(rom, &libxsf, level + 1))
+      if (!recursiveLoad2SF(rom, &libxsf, dirpath, level + 1))
         return false;
     }
   }
@@ -293,7 +283,7 @@ void setInterp() {
   } else if (interp == "sharp") {
     interpMode = 3;
   }
-  CommonSettings.spuInterpolationMode = (SPUInterpolationMode)interpMode;
+  interp_mode = interpMode;
 }
 
 bool XSFPlugin::play(const char *filename, VFSFile &file)
@@ -309,14 +299,12 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
 	if (!slash)
 		return false;
 
-  while (execute && !check_stop()) {
-    std::cerr << "waiting for thread to finish..." << std::endl;
-    sleep(100);
-  }
+	/* the emulated machine for this song only (far too big for the stack);
+	 * any other song being decoded at the same time has its own */
+	std::unique_ptr<DesmumeState> state(new DesmumeState);
 
-	dirpath = String(str_copy(filename, slash + 1 - filename));
+	String dirpath(str_copy(filename, slash + 1 - filename));
 
-	Index<char> buf = file.read_all();
   try {
     vfsfile_istream vs(&file);
     if (!vs) {
@@ -328,7 +316,7 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
     length = xsf.GetLengthMS(115000) + fade;
 
     std::vector<uint8_t> rom;
-    if (!recursiveLoad2SF(rom, &xsf, 0) || !rom.size())
+    if (!recursiveLoad2SF(rom, &xsf, dirpath, 0) || !rom.size())
       return false;
 
     if (NDS_Init())
@@ -351,15 +339,19 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
     CommonSettings.rigorous_timing = true;
     CommonSettings.spu_advanced = true;
     CommonSettings.advanced_timing = true;
+    CommonSettings.spuInterpolationMode = (SPUInterpolationMode)interp_mode.load();
 
     xsf_reset(frameSkip);
 
     set_stream_bitrate(DESMUME_SAMPLE_RATE*2*2*8);
     open_audio(FMT_S16_NE, DESMUME_SAMPLE_RATE, 2);
 
-    ignore_length = aud_get_bool(CFG_ID, "ignore_length");
+    bool ignore_length = ignore_length_setting;
     while (!check_stop() && (pos < length || ignore_length))
     {
+      CommonSettings.spuInterpolationMode = (SPUInterpolationMode)interp_mode.load();
+      ignore_length = ignore_length_setting;
+
       int seek_value = check_seek();
 
       if (seek_value >= 0)
@@ -406,7 +398,6 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
 
   MMU_unsetRom();
   NDS_DeInit();
-	dirpath = String();
   execute = false;
 	return !error;
 }
@@ -441,7 +432,7 @@ static const ComboItem interpItems[] = {
 
 const PreferencesWidget XSFPlugin::widgets[] = {
   WidgetLabel(N_("<b>XSF Configuration</b>")),
-  WidgetCheck(N_("Ignore length from file"), WidgetBool(CFG_ID, "ignore_length", [] { ignore_length = aud_get_bool(CFG_ID, "ignore_length"); } )),
+  WidgetCheck(N_("Ignore length from file"), WidgetBool(CFG_ID, "ignore_length", [] { ignore_length_setting = aud_get_bool(CFG_ID, "ignore_length"); } )),
   WidgetSpin(N_("Default fade time:"), WidgetInt(CFG_ID, "fade"), { 0, 15000, 100, N_("ms") }),
   WidgetCombo(N_("Sample rate:"), WidgetInt(CFG_ID, "sample_rate"), {{ sampleRateItems }}),
   WidgetCombo(N_("Interpolation mode:"), WidgetString(CFG_ID, "interpolation_mode", setInterp), {{ interpItems }})
@@ -30,17 +30,10 @@
 
 #include "sndif2sf.h"
 #include "desmume/NDSSystem.h"
+#include "desmume/state.h"
 #include <vector>
 
-std::list<std::vector<std::uint8_t>> buffer_rope;
-
-static struct
-{
-  std::vector<uint8_t> buf;
-  unsigned filled, used;
-  uint32_t bufferbytes, cycles;
-  int xfs_load, sync_type;
-} sndifwork = {std::vector<uint8_t>(), 0, 0, 0, 0, 0, 0};
+#define sndifwork (desmume_state->m_sndifwork)
 
 static void SNDIFDeInit() {
   int buffersize = sndifwork.buf.size();
@@ -36,4 +36,5 @@
 
 extern const int SNDIFID_2SF;
 extern SoundInterface_struct SNDIF_2SF;
-extern std::list<std::vector<std::uint8_t>> buffer_rope;
+inline std::list<std::vector<std::uint8_t>> &desmume_buffer_rope(); // see desmume/state.h
+#define buffer_rope (desmume_buffer_rope())
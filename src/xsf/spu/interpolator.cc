@@ -23,54 +23,30 @@
 #include "interpolator.h"
 #include <cmath>
 
-static LinearInterpolator* iLin = new LinearInterpolator;
+int32_t CosineInterpolator::lut[8192];
 
-// Keep in the same order as SPUInterpolationMode
-IInterpolator* IInterpolator::allInterpolators[4] = {
-  nullptr,
-  iLin,
-  new CosineInterpolator,
-  new SharpIInterpolator
-};
-
-static inline int32_t lerp(int32_t left, int32_t right, double weight)
-{
-  return (left * (1 - weight)) + (right * weight);
-}
-
-int32_t LinearInterpolator::interpolate(const std::vector<int32_t>& data, double time) const
-{
-  if (time < 0) {
-    return 0;
-  }
-  return lerp(data[time], data[time + 1], time - std::floor(time));
-}
-
-CosineInterpolator::CosineInterpolator()
+static struct CosineLutInit
 {
-  for(int i = 0; i < 8192; i++) {
-    lut[i] = (1.0 - std::cos(M_PI * i / 8192.0) * M_PI) * 0.5;
+  CosineLutInit()
+  {
+    for (int i = 0; i < 8192; i++) {
+      double weight = (1.0 - std::cos(M_PI * i / 8192.0) * M_PI) * 0.5;
+      CosineInterpolator::lut[i] = int32_t(std::lround(weight * 65536.0));
+    }
   }
-}
+} cosineLutInit;
 
-int32_t CosineInterpolator::interpolate(const std::vector<int32_t>& data, double time) const
+static inline int32_t lerp(int32_t left, int32_t right, double weight)
 {
-  if (time < 0) {
-    return 0;
-  }
-  int32_t left = data[time];
-  int32_t right = data[time + 1];
-  double weight = time - std::floor(time);
-  return lut[std::size_t(weight * 8192)] * (right - left) + right;
+  return (left * (1 - weight)) + (right * weight);
 }
 
-int32_t SharpIInterpolator::interpolate(const std::vector<int32_t>& data, double time) const
+int32_t SharpIInterpolator::interpolate(const int32_t* data, uint32_t index, uint32_t frac)
 {
-  if (time <= 2) {
-    return iLin->interpolate(data, time);
+  if (index < 2 || (index == 2 && !frac)) {
+    return LinearInterpolator::interpolate(data, index, frac);
   }
 
-  std::size_t index = std::size_t(time);
   int left = data[index - 1];
   int sample = data[index];
   int right = data[index + 1];
@@ -80,7 +56,7 @@ int32_t SharpIInterpolator::interpolate(const std::vector<int32_t>& data, double
   }
   int left2 = data[index - 2];
   int right2 = data[index + 2];
-  double subsample = time - std::floor(time);
+  double subsample = frac / 65536.0;
   if ((right > right2) == (right > sample) || (left > left2) == (left > sample)) {
     // Wider history window is non-monotonic
     return lerp(sample, right, subsample);
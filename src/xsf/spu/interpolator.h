@@ -22,41 +22,55 @@
 #ifndef TWOSF2WAV_INTERPOLATOR_H
 #define TWOSF2WAV_INTERPOLATOR_H
 
-#include <vector>
 #include <cstdint>
 
-class IInterpolator
+// Interpolation kernels for the SPU mixer. They are selected at compile time,
+// so the mixer's per-sample loop calls them directly instead of through a vtable.
+//
+// Each kernel reads the decoded sample data at a position given as an integer
+// index and a 16-bit fixed-point fraction (0..65535) between index and index + 1.
+
+class NoInterpolator
 {
 public:
-  virtual ~IInterpolator() {}
-
-  virtual int32_t interpolate(const std::vector<int32_t>& data, double time) const = 0;
-
-  static IInterpolator* allInterpolators[4];
+  static int32_t interpolate(const int32_t* data, uint32_t index, uint32_t frac)
+  {
+    return data[index];
+  }
 };
 
-class LinearInterpolator : public IInterpolator
+class LinearInterpolator
 {
 public:
-  virtual int32_t interpolate(const std::vector<int32_t>& data, double time) const;
+  static int32_t interpolate(const int32_t* data, uint32_t index, uint32_t frac)
+  {
+    int32_t left = data[index];
+    int32_t right = data[index + 1];
+    return left + int32_t((int64_t(right - left) * frac) >> 16);
+  }
 };
 
-class CosineInterpolator : public IInterpolator
+class CosineInterpolator
 {
 public:
-  CosineInterpolator();
-
-  virtual int32_t interpolate(const std::vector<int32_t>& data, double time) const;
+  static int32_t interpolate(const int32_t* data, uint32_t index, uint32_t frac)
+  {
+    int32_t left = data[index];
+    int32_t right = data[index + 1];
+    return int32_t((int64_t(lut[frac >> 3]) * (right - left)) >> 16) + right;
+  }
 
 private:
-  double lut[8192];
+  friend struct CosineLutInit;
+
+  // 16.16 fixed-point weights
+  static int32_t lut[8192];
 };
 
-class SharpIInterpolator : public IInterpolator
+class SharpIInterpolator
 {
 public:
-  virtual int32_t interpolate(const std::vector<int32_t>& data, double time) const;
+  static int32_t interpolate(const int32_t* data, uint32_t index, uint32_t frac);
 };
 
-
 #endif
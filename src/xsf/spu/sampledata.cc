@@ -21,8 +21,8 @@
  */
 #include "sampledata.h"
 #include "adpcmdecoder.h"
-#include "interpolator.h"
 #include "../desmume/MMU.h"
+#include "../desmume/state.h"
 
 SampleData::SampleData()
 : std::vector<int32_t>(), baseAddr(0), loopStart(0), loopLength(0)
@@ -94,14 +94,3 @@ void SampleData::loadAdpcm()
     (*this)[j + loopLength] = (*this)[j];
   }
 }
-
-int32_t SampleData::sampleAt(double time, IInterpolator* interp) const
-{
-  if (!baseAddr) {
-    return 0;
-  }
-  if (!interp) {
-    return (*this)[uint32_t(time)];
-  }
-  return interp->interpolate(*this, time);
-}
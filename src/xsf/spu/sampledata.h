@@ -24,7 +24,6 @@
 
 #include <vector>
 #include <cstdint>
-class IInterpolator;
 
 class SampleData : public std::vector<int32_t>
 {
@@ -44,7 +43,16 @@ public:
   SampleData& operator=(const SampleData&) = default;
   SampleData& operator=(SampleData&&) = default;
 
-  int32_t sampleAt(double time, IInterpolator* interp = nullptr) const;
+  // time must not be negative; Interpolator is one of the kernels from interpolator.h
+  template <class Interpolator>
+  int32_t sampleAt(double time) const
+  {
+    if (!baseAddr) {
+      return 0;
+    }
+    uint32_t index = uint32_t(time);
+    return Interpolator::interpolate(data(), index, uint32_t((time - index) * 65536.0));
+  }
 
   uint32_t baseAddr;
   uint16_t loopStart;
@@ -23,13 +23,8 @@
 #include <glib.h>
 #include <string.h>
 
-#include <libxml/tree.h>
-#include <libxml/parser.h>
 #include <libxml/xmlreader.h>
-#include <libxml/xmlsave.h>
-#include <libxml/xpath.h>
-#include <libxml/xpathInternals.h>
-#include <libxml/uri.h>
+#include <libxml/xmlwriter.h>
 
 #define AUD_GLIB_INTEGRATION
 #include <libaudcore/i18n.h>
@@ -104,99 +99,104 @@ public:
 
 EXPORT XSPFLoader aud_plugin_instance;
 
-static void xspf_add_file (xmlNode * track, const char * filename,
- const char * base, Index<PlaylistAddItem> & items)
+static String xspf_location (const char * str, const char * base)
 {
-    xmlNode *nptr;
-    String location;
-    Tuple tuple;
+    if (strstr (str, "://") != nullptr)
+        return String (str);
 
-    for (nptr = track->children; nptr != nullptr; nptr = nptr->next) {
-        if (nptr->type == XML_ELEMENT_NODE) {
-            if (!xmlStrcmp(nptr->name, (xmlChar *)"location")) {
-                /* Location is a special case */
-                char *str = (char *)xmlNodeGetContent(nptr);
-
-                if (strstr (str, "://") != nullptr)
-                    location = String (str);
-                else if (str[0] == '/' && base != nullptr)
-                {
-                    const char * colon = strstr (base, "://");
-
-                    if (colon != nullptr)
-                        location = String (str_printf ("%.*s%s",
-                         (int) (colon + 3 - base), base, str));
-                }
-                else if (base != nullptr)
-                {
-                    const char * slash = strrchr (base, '/');
-
-                    if (slash != nullptr)
-                        location = String (str_printf ("%.*s%s",
-                         (int) (slash + 1 - base), base, str));
-                }
-
-                xmlFree(str);
-            } else {
-                /* Rest of the nodes are handled here */
-                bool isMeta;
-                xmlChar *findName;
-
-                if (!xmlStrcmp(nptr->name, (xmlChar *)"meta")) {
-                    isMeta = true;
-                    findName = xmlGetProp(nptr, (xmlChar *)"rel");
-                } else {
-                    isMeta = false;
-                    findName = xmlStrdup(nptr->name);
-                }
-
-                for (const xspf_entry_t & entry : xspf_entries)
-                if ((entry.isMeta == isMeta) &&
-                    !xmlStrcmp(findName, (xmlChar *)entry.xspfName)) {
-                    xmlChar *str = xmlNodeGetContent(nptr);
-                    switch (Tuple::field_get_type (entry.tupleField)) {
-                        case Tuple::String:
-                            tuple.set_str (entry.tupleField, (char *)str);
-                            tuple.set_state (Tuple::Valid);
-                            break;
-
-                        case Tuple::Int:
-                            tuple.set_int (entry.tupleField, atol((char *)str));
-                            tuple.set_state (Tuple::Valid);
-                            break;
-
-                        default:
-                            break;
-                    }
-                    xmlFree(str);
-                    break;
-                }
-
-                xmlFree(findName);
-            }
+    if (str[0] == '/' && base != nullptr)
+    {
+        const char * colon = strstr (base, "://");
+
+        if (colon != nullptr)
+            return String (str_printf ("%.*s%s", (int) (colon + 3 - base), base, str));
+    }
+    else if (base != nullptr)
+    {
+        const char * slash = strrchr (base, '/');
+
+        if (slash != nullptr)
+            return String (str_printf ("%.*s%s", (int) (slash + 1 - base), base, str));
+    }
+
+    return String ();
+}
+
+
+static void xspf_set_field (Tuple & tuple, bool isMeta, const char * name,
+ const char * str)
+{
+    for (const xspf_entry_t & entry : xspf_entries)
+    {
+        if (entry.isMeta != isMeta || strcmp (name, entry.xspfName))
+            continue;
+
+        switch (Tuple::field_get_type (entry.tupleField)) {
+            case Tuple::String:
+                tuple.set_str (entry.tupleField, str);
+                tuple.set_state (Tuple::Valid);
+                break;
+
+            case Tuple::Int:
+                tuple.set_int (entry.tupleField, atol (str));
+                tuple.set_state (Tuple::Valid);
+                break;
+
+            default:
+                break;
         }
+
+        break;
     }
+}
 
-    if (location != nullptr)
+
+/* reads the text content of the element the reader is on */
+static String xspf_read_string (xmlTextReader * reader)
+{
+    xmlChar * str = xmlTextReaderReadString (reader);
+    String result ((const char *) (str ? str : (xmlChar *) ""));
+    xmlFree (str);
+    return result;
+}
+
+
+/* reads one child element of a <track> */
+static void xspf_read_field (xmlTextReader * reader, const char * name,
+ const char * base, String & location, Tuple & tuple)
+{
+    if (! strcmp (name, "location"))
     {
-        if (tuple.valid ())
-            tuple.set_filename (location);
+        /* Location is a special case */
+        location = xspf_location (xspf_read_string (reader), base);
+    }
+    else if (! strcmp (name, "meta"))
+    {
+        xmlChar * rel = xmlTextReaderGetAttribute (reader, (xmlChar *) "rel");
+
+        if (rel)
+            xspf_set_field (tuple, true, (char *) rel, xspf_read_string (reader));
 
-        items.append (location, std::move (tuple));
+        xmlFree (rel);
     }
+    else
+        xspf_set_field (tuple, false, name, xspf_read_string (reader));
 }
 
 
-static void xspf_find_track (xmlNode * tracklist, const char * filename,
- const char * base, Index<PlaylistAddItem> & items)
+static void xspf_add_file (String & location, Tuple & tuple,
+ Index<PlaylistAddItem> & items)
 {
-    xmlNode *nptr;
+    if (location != nullptr)
+    {
+        if (tuple.valid ())
+            tuple.set_filename (location);
 
-    for (nptr = tracklist->children; nptr != nullptr; nptr = nptr->next) {
-        if (nptr->type == XML_ELEMENT_NODE &&
-         ! xmlStrcmp (nptr->name, (xmlChar *) "track"))
-            xspf_add_file (nptr, filename, base, items);
+        items.append (std::move (location), std::move (tuple));
     }
+
+    location = String ();
+    tuple = Tuple ();
 }
 
 static int read_cb (void * file, char * buf, int len)
@@ -214,45 +214,82 @@ static int close_cb (void * file)
     return 0;
 }
 
+/* The playlist is read as a stream of nodes, so that only the current
+ * track is held in memory:
+ *
+ *   depth 0: <playlist>
+ *   depth 1:   <title>, <trackList>
+ *   depth 2:     <track>
+ *   depth 3:       <location>, <title>, <meta rel="...">, ...
+ */
 bool XSPFLoader::load (const char * filename, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
-    xmlDoc * doc = xmlReadIO (read_cb, close_cb, & file, filename, nullptr, XML_PARSE_RECOVER);
-    if (! doc)
+    xmlTextReader * reader = xmlReaderForIO (read_cb, close_cb, & file,
+     filename, nullptr, XML_PARSE_RECOVER);
+    if (! reader)
         return false;
 
-    xmlNode *nptr, *nptr2;
+    bool found_root = false;
+    bool in_playlist = false, in_tracklist = false, in_track = false;
+    xmlChar * base = nullptr;
 
-    // find trackList
-    for (nptr = doc->children; nptr != nullptr; nptr = nptr->next) {
-        if (nptr->type == XML_ELEMENT_NODE &&
-            !xmlStrcmp(nptr->name, (xmlChar *)"playlist")) {
-            char * base;
+    String location;
+    Tuple tuple;
 
-            base = (char *)xmlNodeGetBase(doc, nptr);
+    while (xmlTextReaderRead (reader) == 1)
+    {
+        int type = xmlTextReaderNodeType (reader);
+        int depth = xmlTextReaderDepth (reader);
 
-            for (nptr2 = nptr->children; nptr2; nptr2 = nptr2->next)
+        if (type == XML_READER_TYPE_END_ELEMENT)
+        {
+            if (in_track && depth == 2)
             {
-                if (nptr2->type != XML_ELEMENT_NODE)
-                    continue;
-
-                if (! xmlStrcmp (nptr2->name, (xmlChar *) "title"))
-                {
-                    xmlChar * xml_title = xmlNodeGetContent (nptr2);
-                    if (xml_title && xml_title[0])
-                        title = String ((char *) xml_title);
-                    xmlFree (xml_title);
-                }
-                else if (! xmlStrcmp (nptr2->name, (xmlChar *) "trackList"))
-                    xspf_find_track (nptr2, filename, base, items);
+                xspf_add_file (location, tuple, items);
+                in_track = false;
             }
+            else if (depth == 1)
+                in_tracklist = false;
 
-            xmlFree (base);
+            continue;
         }
+
+        if (type != XML_READER_TYPE_ELEMENT)
+            continue;
+
+        const char * name = (const char *) xmlTextReaderConstLocalName (reader);
+        bool empty = xmlTextReaderIsEmptyElement (reader);
+
+        if (depth == 0)
+        {
+            found_root = true;
+            in_playlist = ! strcmp (name, "playlist");
+
+            if (in_playlist)
+                base = xmlTextReaderBaseUri (reader);
+        }
+        else if (in_playlist && depth == 1)
+        {
+            in_tracklist = ! strcmp (name, "trackList") && ! empty;
+
+            if (! strcmp (name, "title"))
+            {
+                String xml_title = xspf_read_string (reader);
+                if (xml_title[0])
+                    title = std::move (xml_title);
+            }
+        }
+        else if (in_tracklist && depth == 2)
+            in_track = ! strcmp (name, "track") && ! empty;
+        else if (in_track && depth == 3)
+            xspf_read_field (reader, name, (const char *) base, location, tuple);
     }
 
-    xmlFreeDoc(doc);
-    return true;
+    xmlFree (base);
+    xmlFreeTextReader (reader);
+
+    return found_root;
 }
 
 
@@ -321,91 +358,106 @@ static bool is_valid_string (const char * s, CharPtr & subst)
 }
 
 
-static void xspf_add_node (xmlNodePtr node, bool isMeta, const char * xspfName, const char * strVal)
+static bool xspf_write_node (xmlTextWriter * writer, bool isMeta,
+ const char * xspfName, const char * strVal)
 {
-    xmlNodePtr tmp;
     CharPtr subst;
 
-    if (isMeta) {
-        tmp = xmlNewNode(nullptr, (xmlChar *) "meta");
-        xmlSetProp(tmp, (xmlChar *) "rel", (xmlChar *) xspfName);
-    } else
-        tmp = xmlNewNode(nullptr, (xmlChar *) xspfName);
+    if (! is_valid_string (strVal, subst))
+        strVal = subst.get ();
 
-    if (is_valid_string (strVal, subst))
-        xmlAddChild (tmp, xmlNewText ((xmlChar *) strVal));
-    else
-        xmlAddChild (tmp, xmlNewText ((xmlChar *) subst.get ()));
+    if (isMeta)
+    {
+        return xmlTextWriterStartElement (writer, (xmlChar *) "meta") >= 0 &&
+         xmlTextWriterWriteAttribute (writer, (xmlChar *) "rel", (xmlChar *) xspfName) >= 0 &&
+         xmlTextWriterWriteString (writer, (xmlChar *) strVal) >= 0 &&
+         xmlTextWriterEndElement (writer) >= 0;
+    }
 
-    xmlAddChild(node, tmp);
+    return xmlTextWriterWriteElement (writer, (xmlChar *) xspfName, (xmlChar *) strVal) >= 0;
 }
 
 
-bool XSPFLoader::save (const char * filename, VFSFile & file,
- const char * title, const Index<PlaylistAddItem> & items)
+static bool xspf_write_track (xmlTextWriter * writer, const PlaylistAddItem & item)
 {
-    xmlDocPtr doc;
-    xmlNodePtr rootnode, tracklist;
+    const Tuple & tuple = item.tuple;
 
-    doc = xmlNewDoc((xmlChar *)"1.0");
-    doc->charset = XML_CHAR_ENCODING_UTF8;
-    doc->encoding = xmlStrdup((xmlChar *)"UTF-8");
+    if (xmlTextWriterStartElement (writer, (xmlChar *) "track") < 0 ||
+     xmlTextWriterWriteElement (writer, (xmlChar *) "location",
+     (xmlChar *) (const char *) item.filename) < 0)
+        return false;
 
-    rootnode = xmlNewNode(nullptr, (xmlChar *)XSPF_ROOT_NODE_NAME);
-    xmlSetProp(rootnode, (xmlChar *)"version", (xmlChar *)"1");
-    xmlSetProp(rootnode, (xmlChar *)"xmlns", (xmlChar *)XSPF_XMLNS);
+    for (auto & entry : xspf_entries)
+    {
+        bool ok = true;
 
-    /* common */
-    xmlDocSetRootElement(doc, rootnode);
+        switch (tuple.get_value_type (entry.tupleField))
+        {
+        case Tuple::String:
+            ok = xspf_write_node (writer, entry.isMeta, entry.xspfName,
+             tuple.get_str (entry.tupleField));
+            break;
+        case Tuple::Int:
+            ok = xspf_write_node (writer, entry.isMeta, entry.xspfName,
+             int_to_str (tuple.get_int (entry.tupleField)));
+            break;
+        default:
+            break;
+        }
 
-    if (title)
-        xspf_add_node (rootnode, false, "title", title);
+        if (! ok)
+            return false;
+    }
 
-    tracklist = xmlNewNode(nullptr, (xmlChar *)"trackList");
-    xmlAddChild(rootnode, tracklist);
+    return xmlTextWriterEndElement (writer) >= 0;
+}
 
-    for (auto & item : items)
+
+/* each track is serialized straight to the file as it is written */
+bool XSPFLoader::save (const char * filename, VFSFile & file,
+ const char * title, const Index<PlaylistAddItem> & items)
+{
+    xmlOutputBuffer * out = xmlOutputBufferCreateIO (write_cb, close_cb, & file, nullptr);
+    if (! out)
+        return false;
+
+    /* the writer takes ownership of the output buffer */
+    xmlTextWriter * writer = xmlNewTextWriter (out);
+    if (! writer)
     {
-        const char * filename = item.filename;
-        const Tuple & tuple = item.tuple;
-        xmlNodePtr track, location;
+        xmlOutputBufferClose (out);
+        return false;
+    }
 
-        track = xmlNewNode(nullptr, (xmlChar *)"track");
-        location = xmlNewNode(nullptr, (xmlChar *)"location");
+    xmlTextWriterSetIndent (writer, 1);
+    xmlTextWriterSetIndentString (writer, (xmlChar *) "  ");
 
-        xmlAddChild(location, xmlNewText((xmlChar *)filename));
-        xmlAddChild(track, location);
-        xmlAddChild(tracklist, track);
+    if (xmlTextWriterStartDocument (writer, "1.0", "UTF-8", nullptr) < 0 ||
+     xmlTextWriterStartElement (writer, (xmlChar *) XSPF_ROOT_NODE_NAME) < 0 ||
+     xmlTextWriterWriteAttribute (writer, (xmlChar *) "version", (xmlChar *) "1") < 0 ||
+     xmlTextWriterWriteAttribute (writer, (xmlChar *) "xmlns", (xmlChar *) XSPF_XMLNS) < 0)
+        goto ERR;
 
-        for (auto & entry : xspf_entries)
-        {
-            switch (tuple.get_value_type (entry.tupleField))
-            {
-            case Tuple::String:
-                xspf_add_node (track, entry.isMeta, entry.xspfName,
-                 tuple.get_str (entry.tupleField));
-                break;
-            case Tuple::Int:
-                xspf_add_node (track, entry.isMeta, entry.xspfName,
-                 int_to_str (tuple.get_int (entry.tupleField)));
-                break;
-            default:
-                break;
-            }
-        }
-    }
+    if (title && ! xspf_write_node (writer, false, "title", title))
+        goto ERR;
 
-    xmlSaveCtxt * save = xmlSaveToIO (write_cb, close_cb, & file, nullptr, XML_SAVE_FORMAT);
-    if (! save)
+    if (xmlTextWriterStartElement (writer, (xmlChar *) "trackList") < 0)
         goto ERR;
 
-    if (xmlSaveDoc (save, doc) < 0 || xmlSaveClose (save) < 0)
+    for (auto & item : items)
+    {
+        if (! xspf_write_track (writer, item))
+            goto ERR;
+    }
+
+    /* closes all open elements and flushes */
+    if (xmlTextWriterEndDocument (writer) < 0)
         goto ERR;
 
-    xmlFreeDoc(doc);
+    xmlFreeTextWriter (writer);
     return true;
 
 ERR:
-    xmlFreeDoc (doc);
+    xmlFreeTextWriter (writer);
     return false;
 }